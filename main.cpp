@@ -1,6 +1,9 @@
 ﻿// Comment this out to run full program instead of tests
 #define RUN_TESTS
 
+// With RUN_TESTS commented out, define this to run the benchmarks instead of the program
+// #define RUN_BENCHMARKS
+
 #ifdef RUN_TESTS
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN //only works while in debug
 #include "doctest.h"
@@ -21,6 +24,58 @@
 #include <sstream>
 #include <stdexcept>
 #include <limits>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <unordered_map>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <iterator>
+#include <numeric>
+#include <cstring>
+#include <string_view>
+#include <cstdlib>
+#include <new>
+#include <charconv>
+#include <cmath>
+#include <functional>
+#include <cctype>
+#include <deque>
+#include <condition_variable>
+#include <queue>
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_ranges
+#include <ranges>
+#endif
+
+#include "json.hpp"
+
+// x86 SIMD intrinsics for the column kernels; other targets use the scalar kernels only
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRACKER_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Sockets and epoll for the loopback HTTP server, which only runs on Linux
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 
 using namespace std;
 // DN: short alias so the JSON code stays readable in one file project code.
@@ -123,30 +178,205 @@ Difficulty recommendDifficultyByStats(int level, double hours) {
     return TACTICIAN;
 }
 
+// ================= MEMORY ACCOUNTING =================
+// Live bytes, allocation counts and peak bytes per subsystem, for sizing hosts and
+// catching growth regressions. Session objects are counted by PlaySession's class
+// operator new/delete, location strings by the PlaySession constructors, and list nodes
+// by SessionLinkedList, which charges each list to the subsystem that owns it. Counters
+// are relaxed atomics so background loads and shard workers can update them.
+
+// Keeps GCC from inlining PlaySession::operator new, which otherwise makes it warn that
+// the matching class operator delete frees memory from the global operator new
+#if defined(__GNUC__)
+#define TRACKER_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define TRACKER_NOINLINE __declspec(noinline)
+#else
+#define TRACKER_NOINLINE
+#endif
+
+enum MemorySubsystem {
+    MEM_LIST_NODES,     // SessionContainer nodes
+    MEM_SESSIONS,       // session objects, wherever they are held
+    MEM_LOCATIONS,      // location string buffers too long for the inline buffer
+    MEM_STACK,          // SessionStack nodes
+    MEM_QUEUE,          // SessionQueue nodes
+    MEM_SUBSYSTEM_COUNT
+};
+
+const char* memorySubsystemName(MemorySubsystem m) {
+    static const char* names[MEM_SUBSYSTEM_COUNT] = { "list_nodes", "sessions", "location_strings", "stack", "queue" };
+    return names[m];
+}
+
+struct MemoryStats {
+    long long liveBytes = 0;
+    long long liveBlocks = 0;
+    long long allocations = 0;      // since startup
+    long long peakBytes = 0;
+};
+
+class MemoryAccount {
+    atomic<long long> liveBytes{ 0 };
+    atomic<long long> liveBlocks{ 0 };
+    atomic<long long> allocations{ 0 };
+    atomic<long long> peakBytes{ 0 };
+
+public:
+    void allocated(size_t bytes) {
+        long long now = liveBytes.fetch_add(static_cast<long long>(bytes), memory_order_relaxed) + static_cast<long long>(bytes);
+        liveBlocks.fetch_add(1, memory_order_relaxed);
+        allocations.fetch_add(1, memory_order_relaxed);
+        long long peak = peakBytes.load(memory_order_relaxed);
+        while (now > peak && !peakBytes.compare_exchange_weak(peak, now, memory_order_relaxed)) {}
+    }
+
+    void released(size_t bytes) {
+        liveBytes.fetch_sub(static_cast<long long>(bytes), memory_order_relaxed);
+        liveBlocks.fetch_sub(1, memory_order_relaxed);
+    }
+
+    MemoryStats stats() const {
+        MemoryStats s;
+        s.liveBytes = liveBytes.load(memory_order_relaxed);
+        s.liveBlocks = liveBlocks.load(memory_order_relaxed);
+        s.allocations = allocations.load(memory_order_relaxed);
+        s.peakBytes = peakBytes.load(memory_order_relaxed);
+        return s;
+    }
+
+    // Starts a new peak measurement from the current live bytes
+    void resetPeak() { peakBytes.store(liveBytes.load(memory_order_relaxed), memory_order_relaxed); }
+};
+
+MemoryAccount& memoryAccount(MemorySubsystem m) {
+    static MemoryAccount accounts[MEM_SUBSYSTEM_COUNT];
+    return accounts[m];
+}
+
+// Heap bytes a string holds beyond its own object, 0 while it fits the inline buffer
+inline size_t stringHeapBytes(const string& s) {
+    static const size_t inlineCapacity = string().capacity();
+    return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+json memoryStatsToJson(const MemoryStats& s) {
+    return json{ {"liveBytes", s.liveBytes}, {"liveBlocks", s.liveBlocks},
+        {"allocations", s.allocations}, {"peakBytes", s.peakBytes} };
+}
+
+// Machine-readable dump: one object per subsystem plus live totals. Peaks are per
+// subsystem and are not summed, since they may have happened at different times.
+json memoryReportJson() {
+    json report;
+    json subsystems = json::object();
+    MemoryStats total;
+    for (int m = 0; m < MEM_SUBSYSTEM_COUNT; m++) {
+        MemoryStats s = memoryAccount(static_cast<MemorySubsystem>(m)).stats();
+        subsystems[memorySubsystemName(static_cast<MemorySubsystem>(m))] = memoryStatsToJson(s);
+        total.liveBytes += s.liveBytes;
+        total.liveBlocks += s.liveBlocks;
+        total.allocations += s.allocations;
+    }
+    report["subsystems"] = subsystems;
+    report["total"] = { {"liveBytes", total.liveBytes}, {"liveBlocks", total.liveBlocks},
+        {"allocations", total.allocations} };
+    return report;
+}
+
+void printMemoryReport(ostream& os = cout) {
+    os << left << setw(18) << "Subsystem" << right << setw(14) << "Live bytes" << setw(12) << "Live blocks"
+        << setw(14) << "Allocations" << setw(14) << "Peak bytes" << "\n";
+    long long liveBytes = 0;
+    for (int m = 0; m < MEM_SUBSYSTEM_COUNT; m++) {
+        MemoryStats s = memoryAccount(static_cast<MemorySubsystem>(m)).stats();
+        os << left << setw(18) << memorySubsystemName(static_cast<MemorySubsystem>(m)) << right
+            << setw(14) << s.liveBytes << setw(12) << s.liveBlocks << setw(14) << s.allocations
+            << setw(14) << s.peakBytes << "\n";
+        liveBytes += s.liveBytes;
+    }
+    os << left << setw(18) << "total" << right << setw(14) << liveBytes << "\n";
+}
+
+void saveMemoryReport(const string& fileName) {
+    ofstream outFile(fileName);
+    if (!outFile) throw runtime_error("Could not write " + fileName);
+    outFile << memoryReportJson().dump(2) << "\n";
+}
+
+// Session type ids used by the registry and the packed storage formats
+enum SessionType {
+    COMBAT_SESSION = 0,
+    EXPLORATION_SESSION = 1
+};
+
 // Class for play sessions BASE CLASS
 class PlaySession {
 protected:
     string location;
     int durationMinutes;
     Difficulty difficulty;
+    SessionType type;       // set by each derived class from its TYPE_ID
 
 public:
-    PlaySession() : location("Unknown"), durationMinutes(0), difficulty(EXPLORER) {}
+    PlaySession() : location("Unknown"), durationMinutes(0), difficulty(EXPLORER), type(COMBAT_SESSION) {}
 
     PlaySession(const string& loc, int duration, Difficulty diff)
-        : location(loc), durationMinutes(duration), difficulty(diff) {}
+        : location(loc), durationMinutes(duration), difficulty(diff), type(COMBAT_SESSION) {
+        chargeLocation();
+    }
+
+    PlaySession(const PlaySession& o)
+        : location(o.location), durationMinutes(o.durationMinutes), difficulty(o.difficulty), type(o.type) {
+        chargeLocation();
+    }
+
+    PlaySession& operator=(const PlaySession& o) {
+        releaseLocation();
+        location = o.location;
+        durationMinutes = o.durationMinutes;
+        difficulty = o.difficulty;
+        type = o.type;
+        chargeLocation();
+        return *this;
+    }
 
-    string getLocation() const { return location; }
+    // Session objects are charged to MEM_SESSIONS. The virtual destructor makes delete
+    // pass the derived object's size.
+    TRACKER_NOINLINE static void* operator new(size_t size) {
+        void* p = ::operator new(size);
+        memoryAccount(MEM_SESSIONS).allocated(size);
+        return p;
+    }
+
+    static void operator delete(void* p, size_t size) {
+        memoryAccount(MEM_SESSIONS).released(size);
+        ::operator delete(p, size);
+    }
+
+    const string& getLocation() const { return location; }
     int getDuration() const { return durationMinutes; }
+    Difficulty getDifficulty() const { return difficulty; }
+    SessionType getType() const { return type; }
 
     virtual double calculateValue() const = 0;
 
-    virtual void print() const {
-        cout << "Location: " << location << endl;
-        cout << "Duration: " << durationMinutes << endl;
+    virtual void print(ostream& os = cout) const {
+        os << "Location: " << location << endl;
+        os << "Duration: " << durationMinutes << endl;
     }
 
-    virtual ~PlaySession() {}
+    virtual ~PlaySession() { releaseLocation(); }
+
+private:
+    // Location strings are never changed in place, so their buffer is charged once
+    void chargeLocation() {
+        if (size_t bytes = stringHeapBytes(location)) memoryAccount(MEM_LOCATIONS).allocated(bytes);
+    }
+
+    void releaseLocation() {
+        if (size_t bytes = stringHeapBytes(location)) memoryAccount(MEM_LOCATIONS).released(bytes);
+    }
 };
 
 // Class for loot info COMPOSITION CLASS
@@ -156,6 +386,14 @@ class LootInfo {
 
 public:
     LootInfo(int g = 0, bool r = false) : goldEarned(g), rareItemFound(r) {}
+
+    int getGoldEarned() const { return goldEarned; }
+    bool isRareItemFound() const { return rareItemFound; }
+
+    bool operator==(const LootInfo& o) const {
+        return goldEarned == o.goldEarned && rareItemFound == o.rareItemFound;
+    }
+    bool operator!=(const LootInfo& o) const { return !(*this == o); }
 };
 
 // DERIVED CLASS Combat Session
@@ -164,16 +402,24 @@ class CombatSession : public PlaySession {
     LootInfo loot;
 
 public:
-    CombatSession() : enemiesDefeated(0) {}
+    // Registry entry, see SESSION REGISTRY
+    static constexpr SessionType TYPE_ID = COMBAT_SESSION;
+    static constexpr const char* JSON_TAG = "combat";
+    static constexpr const char* COUNT_FIELD = "enemiesDefeated";
+    static constexpr double VALUE_PER_COUNT = 10.0;
+
+    CombatSession() : enemiesDefeated(0) { type = TYPE_ID; }
 
     CombatSession(const string& loc, int dur, Difficulty diff,
         int enemies, const LootInfo& l)
-        : PlaySession(loc, dur, diff), enemiesDefeated(enemies), loot(l) {}
+        : PlaySession(loc, dur, diff), enemiesDefeated(enemies), loot(l) { type = TYPE_ID; }
 
     int getEnemiesDefeated() const { return enemiesDefeated; }
+    int getCount() const { return enemiesDefeated; }
+    const LootInfo& getLoot() const { return loot; }
 
     double calculateValue() const override {
-        return enemiesDefeated * 10.0;
+        return enemiesDefeated * VALUE_PER_COUNT;
     }
 
     bool operator==(const CombatSession& o) const {
@@ -196,16 +442,24 @@ class ExplorationSession : public PlaySession {
     LootInfo loot;    // composition
 
 public:
-    ExplorationSession() : areasDiscovered(0) {}
+    // Registry entry, see SESSION REGISTRY
+    static constexpr SessionType TYPE_ID = EXPLORATION_SESSION;
+    static constexpr const char* JSON_TAG = "exploration";
+    static constexpr const char* COUNT_FIELD = "areasDiscovered";
+    static constexpr double VALUE_PER_COUNT = 5.0;
+
+    ExplorationSession() : areasDiscovered(0) { type = TYPE_ID; }
 
     ExplorationSession(const string& loc, int dur, Difficulty diff,
         int areas, const LootInfo& l)
-        : PlaySession(loc, dur, diff), areasDiscovered(areas), loot(l) {}
+        : PlaySession(loc, dur, diff), areasDiscovered(areas), loot(l) { type = TYPE_ID; }
 
     int getAreasDiscovered() const { return areasDiscovered; }
+    int getCount() const { return areasDiscovered; }
+    const LootInfo& getLoot() const { return loot; }
 
     double calculateValue() const override {
-        return areasDiscovered * 5.0;
+        return areasDiscovered * VALUE_PER_COUNT;
     }
 };
 
@@ -215,6 +469,108 @@ public:
     ContainerException(const string& msg) : runtime_error(msg) {}
 };
 
+// ================= SESSION REGISTRY =================
+// Every session type is listed once in RegisteredSessions. Each type declares its
+// TYPE_ID, JSON_TAG, COUNT_FIELD and VALUE_PER_COUNT, and provides getCount(), getLoot()
+// and a (location, duration, difficulty, count, loot) constructor. The JSON reader and
+// writer, the storage formats and the value functions below are generated from that
+// list and dispatch on the stored type id, so the hot paths never use RTTI.
+//
+// To add a session type: give it the members above, add an id to SessionType and add
+// the class to RegisteredSessions.
+
+template <typename... Types>
+struct SessionRegistry;
+
+template <typename T, typename... Rest>
+struct SessionRegistry<T, Rest...> {
+    static constexpr size_t COUNT = 1 + sizeof...(Rest);
+
+    // Calls fn(const Derived&) with the session's concrete type
+    template <typename Fn>
+    static auto visit(const PlaySession& s, Fn&& fn) -> decltype(fn(declval<const T&>())) {
+        if (s.getType() == T::TYPE_ID) return fn(static_cast<const T&>(s));
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::visit(s, fn);
+        else throw ContainerException("Unregistered session type");
+    }
+
+    // Caller owns the result
+    static PlaySession* create(SessionType id, const string& loc, int dur, Difficulty diff,
+        int count, const LootInfo& loot) {
+        if (id == T::TYPE_ID) return new T(loc, dur, diff, count, loot);
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::create(id, loc, dur, diff, count, loot);
+        else throw ContainerException("Unregistered session type");
+    }
+
+    // Returns false if no registered type uses the tag
+    static bool findTag(const string& tag, SessionType& id) {
+        if (tag == T::JSON_TAG) { id = T::TYPE_ID; return true; }
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::findTag(tag, id);
+        else return false;
+    }
+
+    static const char* tagOf(SessionType id) {
+        if (id == T::TYPE_ID) return T::JSON_TAG;
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::tagOf(id);
+        else throw ContainerException("Unregistered session type");
+    }
+
+    static const char* countFieldOf(SessionType id) {
+        if (id == T::TYPE_ID) return T::COUNT_FIELD;
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::countFieldOf(id);
+        else throw ContainerException("Unregistered session type");
+    }
+
+    static constexpr double valuePerCount(SessionType id) {
+        if (id == T::TYPE_ID) return T::VALUE_PER_COUNT;
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::valuePerCount(id);
+        else return 0.0;
+    }
+
+    static size_t objectSize(SessionType id) {
+        if (id == T::TYPE_ID) return sizeof(T);
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::objectSize(id);
+        else return 0;
+    }
+
+    // Ids must be 0..COUNT-1 in list order so they can index tables and packed tags
+    static constexpr bool idsAreDense(int first = 0) {
+        if (T::TYPE_ID != first) return false;
+        if constexpr (sizeof...(Rest) > 0) return SessionRegistry<Rest...>::idsAreDense(first + 1);
+        else return true;
+    }
+};
+
+using RegisteredSessions = SessionRegistry<CombatSession, ExplorationSession>;
+
+static_assert(RegisteredSessions::idsAreDense(), "Session TYPE_IDs must be 0, 1, 2... in registry order");
+static_assert(RegisteredSessions::COUNT <= 4, "Packed session formats store the type in 2 bits");
+
+SessionType sessionTypeOf(const PlaySession& s) { return s.getType(); }
+
+// Enemies defeated for combat, areas discovered for exploration
+int sessionCount(const PlaySession& s) {
+    return RegisteredSessions::visit(s, [](const auto& typed) { return typed.getCount(); });
+}
+
+LootInfo sessionLoot(const PlaySession& s) {
+    return RegisteredSessions::visit(s, [](const auto& typed) { return typed.getLoot(); });
+}
+
+// Same result as calculateValue() without the virtual call
+double sessionValue(const PlaySession& s) {
+    return RegisteredSessions::visit(s, [](const auto& typed) {
+        using T = typename decay<decltype(typed)>::type;
+        return typed.T::calculateValue();
+    });
+}
+
+// Caller owns the result
+PlaySession* makeSession(SessionType type, const string& loc, int dur, Difficulty diff,
+    int count, const LootInfo& loot) {
+    return RegisteredSessions::create(type, loc, dur, diff, count, loot);
+}
+
 // ================= LINKED LIST =================
 class SessionLinkedList {
 public:
@@ -224,17 +580,106 @@ public:
         Node(PlaySession* d) : data(d), next(nullptr) {}
     };
 
+    // Forward iterator over the sessions, head to tail. Dereferences to the session, so
+    // range-for, <algorithm> and C++20 ranges all see a sequence of PlaySession&. Stays
+    // valid until the node it points at is unlinked.
+    template <typename Session>
+    class Iterator {
+        template <typename> friend class Iterator;
+        Node* node = nullptr;
+
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = PlaySession;
+        using difference_type = ptrdiff_t;
+        using pointer = Session*;
+        using reference = Session&;
+
+        Iterator() = default;
+        explicit Iterator(Node* n) : node(n) {}
+
+        // iterator converts to const_iterator
+        template <typename Other, typename = enable_if_t<is_convertible<Other*, Session*>::value>>
+        Iterator(const Iterator<Other>& other) : node(other.node) {}
+
+        reference operator*() const { return *node->data; }
+        pointer operator->() const { return node->data; }
+
+        Iterator& operator++() {
+            node = node->next;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator before = *this;
+            node = node->next;
+            return before;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) { return a.node == b.node; }
+        friend bool operator!=(const Iterator& a, const Iterator& b) { return a.node != b.node; }
+    };
+
+    using iterator = Iterator<PlaySession>;
+    using const_iterator = Iterator<const PlaySession>;
+
     Node* head = nullptr;
+    Node* tail = nullptr;
+    MemorySubsystem account;    // where this list's nodes are charged
+
+    explicit SessionLinkedList(MemorySubsystem m = MEM_LIST_NODES) : account(m) {}
+    SessionLinkedList(const SessionLinkedList&) = delete;
+    SessionLinkedList& operator=(const SessionLinkedList&) = delete;
+
+    // The list owns its nodes and the sessions they point at
+    ~SessionLinkedList() {
+        while (head) {
+            Node* n = head;
+            head = head->next;
+            freeNode(n);
+        }
+    }
 
-    void insertBack(PlaySession* s) {
+    // Nodes must come from newNode and go back through freeNode to stay accounted
+    Node* newNode(PlaySession* s) {
         Node* n = new Node(s);
-        if (!head) { head = n; return; }
+        memoryAccount(account).allocated(sizeof(Node));
+        return n;
+    }
 
-        Node* t = head;
-        while (t->next) t = t->next;
-        t->next = n;
+    // Deletes an unlinked node and the session it owns
+    void freeNode(Node* n) {
+        delete n->data;
+        delete n;
+        memoryAccount(account).released(sizeof(Node));
+    }
+
+    // Links n in after before, or at the front if before is nullptr. O(1).
+    void linkAfter(Node* before, Node* n) {
+        Node*& slot = before ? before->next : head;
+        n->next = slot;
+        slot = n;
+        if (tail == before) tail = n;
+    }
+
+    // Unlinks and returns the node after before, or the head if before is nullptr. O(1).
+    Node* unlinkAfter(Node* before) {
+        Node*& slot = before ? before->next : head;
+        Node* n = slot;
+        slot = n->next;
+        if (tail == n) tail = before;
+        n->next = nullptr;
+        return n;
     }
 
+    void insertFront(PlaySession* s) { linkAfter(nullptr, newNode(s)); }
+    void insertBack(PlaySession* s) { linkAfter(tail, newNode(s)); }
+
+    iterator begin() { return iterator(head); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(); }
+
     int size() {
         int c = 0;
         for (Node* t = head; t; t = t->next) c++;
@@ -250,23 +695,66 @@ public:
 };
 
 
-class ListIterator {
-    SessionLinkedList::Node* current;
-public:
-    ListIterator(SessionLinkedList::Node* start) : current(start) {}
-    bool hasNext() { return current != nullptr; }
-    void next() { current = current->next; }
-    PlaySession* getData() { return current->data; }
-};
-
-
 // Session Container replaces old template class
 class SessionContainer {
     SessionLinkedList list;
+    int count = 0;
+
+    // Change tracking for incremental writers such as ReportWriter
+    int changedFrom = 0;    // every index from here on may have moved or changed
+    vector<int> edited;     // indices below changedFrom whose session was edited
+    long long revision = 0; // bumped by every change except add, never cleared
+
+    // O(1) node-level changes for SessionHistory; index is where the node is or will be
+    friend class SessionHistory;
+
+    SessionLinkedList::Node* nodeBefore(int index) {
+        SessionLinkedList::Node* before = nullptr;
+        for (int i = 0; i < index; i++) before = before ? before->next : list.head;
+        return before;
+    }
+
+    void linkAfter(SessionLinkedList::Node* before, SessionLinkedList::Node* n, int index) {
+        list.linkAfter(before, n);
+        count++;
+        revision++;
+        changedFrom = min(changedFrom, index);
+    }
+
+    SessionLinkedList::Node* unlinkAfter(SessionLinkedList::Node* before, int index) {
+        SessionLinkedList::Node* n = list.unlinkAfter(before);
+        count--;
+        revision++;
+        changedFrom = min(changedFrom, index);
+        return n;
+    }
+
+    PlaySession* swapSession(SessionLinkedList::Node* n, PlaySession* s, int index) {
+        PlaySession* old = n->data;
+        n->data = s;
+        markChanged(index);
+        return old;
+    }
 
 public:
-    void add(PlaySession* s) { list.insertBack(s); }
-    int size() { return list.size(); }
+    using iterator = SessionLinkedList::iterator;
+    using const_iterator = SessionLinkedList::const_iterator;
+
+    void add(PlaySession* s) {
+        list.insertBack(s);
+        changedFrom = min(changedFrom, count);
+        count++;
+    }
+
+    int size() const { return count; }
+
+    // Walks the list once; prefer these to at(i) in a loop, which is O(n) per call
+    iterator begin() { return list.begin(); }
+    iterator end() { return list.end(); }
+    const_iterator begin() const { return list.begin(); }
+    const_iterator end() const { return list.end(); }
+    const_iterator cbegin() const { return list.begin(); }
+    const_iterator cend() const { return list.end(); }
 
     PlaySession* at(int index) {
         PlaySession* r = list.at(index);
@@ -277,9 +765,12 @@ public:
     SessionLinkedList::Node* getHead() { return list.head; }
 
     // -------- LINEAR SEARCH --------
-    int linearSearch(const string& loc) {
-        for (int i = 0; i < size(); i++)
-            if (at(i)->getLocation() == loc) return i;
+    int linearSearch(const string& loc) const {
+        int index = 0;
+        for (const PlaySession& s : *this) {
+            if (s.getLocation() == loc) return index;
+            index++;
+        }
         return -1;
     }
 
@@ -287,201 +778,6151 @@ public:
         if (index < 0 || index >= size())
             throw ContainerException("Invalid index");
 
-        auto* curr = list.head;
-        SessionLinkedList::Node* prev = nullptr;
+        list.freeNode(unlinkAfter(nodeBefore(index), index));
+    }
 
-        for (int i = 0; i < index; i++) {
-            prev = curr;
-            curr = curr->next;
+    // Removes and frees every session pred(const PlaySession&) accepts, in one pass in
+    // list order. Returns how many were removed.
+    template <typename Pred>
+    int removeIf(Pred pred) {
+        int removed = 0;
+        int index = 0;
+        SessionLinkedList::Node* before = nullptr;
+        while (SessionLinkedList::Node* n = before ? before->next : list.head) {
+            if (pred(static_cast<const PlaySession&>(*n->data))) {
+                list.freeNode(unlinkAfter(before, index));
+                removed++;
+            }
+            else {
+                before = n;
+                index++;
+            }
         }
+        return removed;
+    }
+
+    // Puts s at index and returns the session it replaces, which the caller now owns
+    PlaySession* replace(int index, PlaySession* s) {
+        if (index < 0 || index >= size())
+            throw ContainerException("Invalid index");
+        SessionLinkedList::Node* before = nodeBefore(index);
+        return swapSession(before ? before->next : list.head, s, index);
+    }
+
+    // Call after changing the session at index in place
+    void markChanged(int index) {
+        revision++;
+        if (index < changedFrom) edited.push_back(index);
+    }
+
+    // Unchanged while sessions are only appended with add, so a caller can tell whether
+    // the sessions it saw earlier are all still there and unedited
+    long long changeCount() const { return revision; }
 
-        if (prev) prev->next = curr->next;
-        else list.head = curr->next;
+    int firstChangedIndex() const { return changedFrom; }
+    const vector<int>& editedIndices() const { return edited; }
 
-        delete curr->data;
-        delete curr;
+    // Called by the writer that consumed the changes
+    void clearChanges() {
+        changedFrom = count;
+        edited.clear();
     }
 };
 
 // ================= STACK =================
+// The top is the head of the list, so push, pop and top are O(1)
 class SessionStack {
-    SessionLinkedList list;
+    SessionLinkedList list{ MEM_STACK };
 
 public:
-    void push(PlaySession* s) { list.insertBack(s); }
+    using iterator = SessionLinkedList::iterator;
+    using const_iterator = SessionLinkedList::const_iterator;
+
+    void push(PlaySession* s) { list.insertFront(s); }
 
     void pop() {
-        if (list.size() == 0) throw ContainerException("Stack empty");
+        if (!list.head) throw ContainerException("Stack empty");
+        list.freeNode(list.unlinkAfter(nullptr));
+    }
 
-        auto* curr = list.head;
-        SessionLinkedList::Node* prev = nullptr;
+    PlaySession* top() { return list.head ? list.head->data : nullptr; }
+    bool isEmpty() const { return list.head == nullptr; }
 
-        while (curr->next) {
-            prev = curr;
-            curr = curr->next;
-        }
+    // Top to bottom, the order pop would return them
+    iterator begin() { return list.begin(); }
+    iterator end() { return list.end(); }
+    const_iterator begin() const { return list.begin(); }
+    const_iterator end() const { return list.end(); }
+};
+
+// Fixed-capacity stack over a ring buffer, allocated once. Pushing onto a full stack
+// drops the oldest entry and hands it back so the caller can release what it owns.
+// Every operation is O(1).
+template <typename T>
+class RingStack {
+    vector<T> slots;
+    size_t first = 0;       // oldest entry
+    size_t count = 0;
+
+    size_t slot(size_t i) const { return (first + i) % slots.size(); }
+
+public:
+    explicit RingStack(size_t capacity) : slots(capacity) {
+        if (capacity == 0) throw ContainerException("RingStack capacity must be positive");
+    }
 
-        if (prev) prev->next = nullptr;
-        else list.head = nullptr;
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+    bool isEmpty() const { return count == 0; }
+
+    // Returns true if the oldest entry was moved into evicted to make room
+    bool push(T item, T& evicted) {
+        if (count < slots.size()) {
+            slots[slot(count++)] = move(item);
+            return false;
+        }
+        evicted = move(slots[first]);
+        slots[first] = move(item);
+        first = slot(1);
+        return true;
+    }
 
-        delete curr->data;
-        delete curr;
+    T pop() {
+        if (count == 0) throw ContainerException("Stack empty");
+        return move(slots[slot(--count)]);
     }
 
-    PlaySession* top() { return list.at(list.size() - 1); }
-    bool isEmpty() { return list.size() == 0; }
+    T& top() {
+        if (count == 0) throw ContainerException("Stack empty");
+        return slots[slot(count - 1)];
+    }
 };
 
 // ================= QUEUE =================
 class SessionQueue {
-    SessionLinkedList list;
+    SessionLinkedList list{ MEM_QUEUE };
 
 public:
+    using iterator = SessionLinkedList::iterator;
+    using const_iterator = SessionLinkedList::const_iterator;
+
     void enqueue(PlaySession* s) { list.insertBack(s); }
 
     void dequeue() {
-        if (list.size() == 0) throw ContainerException("Queue empty");
-
-        auto* temp = list.head;
-        list.head = list.head->next;
-
-        delete temp->data;
-        delete temp;
+        if (!list.head) throw ContainerException("Queue empty");
+        list.freeNode(list.unlinkAfter(nullptr));
     }
 
-    PlaySession* front() { return list.at(0); }
-    bool isEmpty() { return list.size() == 0; }
-};
-
+    PlaySession* front() { return list.head ? list.head->data : nullptr; }
+    bool isEmpty() const { return list.head == nullptr; }
 
+    // Front to back, the order dequeue would return them
+    iterator begin() { return list.begin(); }
+    iterator end() { return list.end(); }
+    const_iterator begin() const { return list.begin(); }
+    const_iterator end() const { return list.end(); }
+};
 
-// Banner Function
-void displayBanner() {
-    cout << "\n=== Baldur's Gate 3 - Adventure Tracker ===\n";
-}
-
-// Menu Display Function
-void displayMenu() {
-    cout << "\n=== Main Menu ===\n1. Add Session\n2. View Session Summary\n3. Remove Session\n4. Recommend Difficulty\n5. Save Report to File\n6. Quit\n7. Search by Location\n8. Push to stack\n9. Pop from stack\n10. Enqueue to queue\n11. Dequeue from queue\n";
-}
+// ================= PRIORITY QUEUE =================
+// Sessions leave highest key first. The key is calculateValue() (priorityByValue),
+// gold earned (priorityByGold) or any function, and the Before comparator orders the
+// keys (greater<Key>, the default, puts the largest first). Equal keys leave in the
+// order they went in.
+//
+// The heap is 4-ary and keeps each entry's key inline, so a sift compares keys that
+// sit in one or two cache lines without touching the sessions, and the tree is half as
+// deep as a binary heap. push, dequeue, update and remove are O(log n); pushBatch
+// heapifies in O(n). push returns a handle that stays valid until that session leaves
+// the queue; after anything that changes a queued session's key, call update(handle)
+// to move it up or down (decrease-key and increase-key).
+
+double priorityByValue(const PlaySession& s) { return sessionValue(s); }
+double priorityByGold(const PlaySession& s) { return sessionLoot(s).getGoldEarned(); }
+
+template <typename Key = double, typename Before = greater<Key>>
+class SessionPriorityQueue {
+public:
+    using Handle = uint32_t;
+    using KeyFn = function<Key(const PlaySession&)>;
 
-#ifndef RUN_TESTS
-int main() {
+private:
+    static const size_t ARITY = 4;
+    static const uint32_t NOT_QUEUED = UINT32_MAX;
 
-    Character player;
-    SessionContainer manager;
-    SessionStack stack;
-    SessionQueue queue;
-    int choice;
+    struct Entry {
+        Key key;
+        uint64_t order;     // arrival number, so ties leave first in, first out
+        Handle handle;
+    };
 
-    displayBanner();
-    createCharacter(player);
-    displayCharacterSummary(player);
+    struct Slot {
+        PlaySession* session = nullptr;
+        uint32_t position = NOT_QUEUED;     // index in heap
+    };
 
-    do {
-        displayMenu();
-        choice = getValidInt("Choice: ", 1, 11);
+    KeyFn keyFn;
+    Before before;
+    vector<Entry> heap;
+    vector<Slot> slots;             // by handle
+    vector<Handle> freeHandles;
+    uint64_t arrivals = 0;
+
+    bool precedes(const Entry& a, const Entry& b) const {
+        if (before(a.key, b.key)) return true;
+        if (before(b.key, a.key)) return false;
+        return a.order < b.order;
+    }
 
-        switch (choice) {
+    void place(size_t i, Entry&& e) {
+        slots[e.handle].position = static_cast<uint32_t>(i);
+        heap[i] = move(e);
+    }
 
-        case 1:   // Add Session
-        {
-            int type = getValidInt("1 Combat, 2 Explore: ", 1, 2);
-            string loc = getValidString("Location: ");
-            int dur = getValidInt("Duration: ", 1, 600);
+    void siftUp(size_t i) {
+        Entry e = move(heap[i]);
+        while (i > 0) {
+            size_t parent = (i - 1) / ARITY;
+            if (!precedes(e, heap[parent])) break;
+            place(i, move(heap[parent]));
+            i = parent;
+        }
+        place(i, move(e));
+    }
 
-            LootInfo loot(0, false);
+    void siftDown(size_t i) {
+        Entry e = move(heap[i]);
+        size_t n = heap.size();
+        while (true) {
+            size_t first = i * ARITY + 1;
+            if (first >= n) break;
+            size_t best = first;
+            size_t end = min(first + ARITY, n);
+            for (size_t c = first + 1; c < end; c++)
+                if (precedes(heap[c], heap[best])) best = c;
+            if (!precedes(heap[best], e)) break;
+            place(i, move(heap[best]));
+            i = best;
+        }
+        place(i, move(e));
+    }
 
-            if (type == 1)
-                manager.add(new CombatSession(loc, dur, BALANCED, 5, loot));
-            else
-                manager.add(new ExplorationSession(loc, dur, EXPLORER, 3, loot));
+    // Moves the entry at i up or down to where it belongs
+    void restore(size_t i) {
+        if (i > 0 && precedes(heap[i], heap[(i - 1) / ARITY])) siftUp(i);
+        else siftDown(i);
+    }
 
-            cout << "Added\n";
-            break;
+    // Appends an entry without ordering it. The key is computed by the caller, so a
+    // throwing key function never leaves a slot claimed; if an allocation here throws,
+    // the queue is unchanged.
+    Handle append(PlaySession* s, Key key) {
+        bool reuse = !freeHandles.empty();
+        Handle h = reuse ? freeHandles.back() : static_cast<Handle>(slots.size());
+        if (!reuse) slots.emplace_back();
+        try {
+            heap.push_back(Entry{ move(key), arrivals, h });
         }
-
-        case 2:   // View Sessions
-        {
-            ListIterator it(manager.getHead());
-            while (it.hasNext()) {
-                it.getData()->print();
-                cout << "---\n";
-                it.next();
-            }
-            break;
+        catch (...) {
+            if (!reuse) slots.pop_back();
+            throw;
         }
 
-        case 3:   // Remove Session
-        {
-            if (manager.size() == 0) {
-                cout << "No sessions to remove.\n";
-                break;
-            }
-
-            int index = getValidInt(
-                "Enter session index to remove: ",
-                0,
-                manager.size() - 1
-            );
+        if (reuse) freeHandles.pop_back();
+        arrivals++;
+        slots[h].session = s;
+        slots[h].position = static_cast<uint32_t>(heap.size() - 1);
+        return h;
+    }
 
-            try {
-                manager.remove(index);       // Remove session by index
-                cout << "Session removed.\n";
-            }
-            catch (const ContainerException& e) {
-                cout << "Error: " << e.what() << endl;
-            }
-            break;
+    // Takes the entry at position i out of the heap and hands its session to the caller
+    unique_ptr<PlaySession> extract(size_t i) {
+        Handle h = heap[i].handle;
+        unique_ptr<PlaySession> s(slots[h].session);
+        slots[h] = Slot();
+        freeHandles.push_back(h);
+
+        Entry last = move(heap.back());
+        heap.pop_back();
+        if (i < heap.size()) {
+            place(i, move(last));
+            restore(i);
         }
+        return s;
+    }
 
-        case 4:   // Recommend Difficulty
-        {
-            if (manager.size() == 0) {
-                cout << "No sessions available.\n";
-                break;
-            }
+    const Slot& slotFor(Handle h) const {
+        if (!contains(h)) throw ContainerException("Session is not in the priority queue");
+        return slots[h];
+    }
 
-            int totalMinutes = 0;
-            for (int i = 0; i < manager.size(); i++) {
-                totalMinutes += manager.at(i)->getDuration();
-            }
+public:
+    explicit SessionPriorityQueue(KeyFn key = priorityByValue, Before order = Before())
+        : keyFn(move(key)), before(move(order)) {}
 
-            double avgHours =
-                (totalMinutes / 60.0) / manager.size();
+    SessionPriorityQueue(const SessionPriorityQueue&) = delete;
+    SessionPriorityQueue& operator=(const SessionPriorityQueue&) = delete;
 
-            Difficulty rec =
-                recommendDifficultyByStats(player.level, avgHours);
+    // The queue owns the sessions still in it
+    ~SessionPriorityQueue() {
+        for (const Entry& e : heap) delete slots[e.handle].session;
+    }
 
-            cout << "\n=== Difficulty Recommendation ===\n";
+    size_t size() const { return heap.size(); }
+    bool isEmpty() const { return heap.empty(); }
+    bool contains(Handle h) const { return h < slots.size() && slots[h].position != NOT_QUEUED; }
+
+    // Takes ownership of the session. If this throws (the key function, say), the queue
+    // is unchanged and the caller still owns s.
+    Handle push(PlaySession* s) {
+        Key key = keyFn(*s);
+        Handle h = append(s, move(key));
+        siftUp(heap.size() - 1);
+        return h;
+    }
 
-            switch (rec) {
-            case EXPLORER:  cout << "Explorer\n"; break;
-            case BALANCED:  cout << "Balanced\n"; break;
-            case TACTICIAN: cout << "Tactician\n"; break;
-            }
+    // Takes ownership of every session. Rebuilds the heap bottom-up, O(size() + batch),
+    // which beats one push at a time once the batch is a sizable part of the queue.
+    // Every key is computed and the room reserved first, so on a throw the queue is
+    // unchanged and the caller still owns the whole batch.
+    vector<Handle> pushBatch(const vector<PlaySession*>& batch) {
+        vector<Key> keys;
+        keys.reserve(batch.size());
+        for (PlaySession* s : batch) keys.push_back(keyFn(*s));
+
+        vector<Handle> handles;
+        handles.reserve(batch.size());
+        heap.reserve(heap.size() + batch.size());
+        slots.reserve(slots.size() + batch.size());
+        for (size_t i = 0; i < batch.size(); i++) handles.push_back(append(batch[i], move(keys[i])));
+        if (heap.size() > 1)
+            for (size_t i = (heap.size() - 2) / ARITY + 1; i-- > 0;) siftDown(i);
+        return handles;
+    }
 
-            break;
-        }
+    // The session that leaves next, or nullptr if the queue is empty
+    PlaySession* front() { return heap.empty() ? nullptr : slots[heap[0].handle].session; }
 
-        case 5:   // Save Report
-        {
-            ofstream outFile("report.txt");
+    const Key& frontKey() const {
+        if (heap.empty()) throw ContainerException("Priority queue empty");
+        return heap[0].key;
+    }
 
-            outFile << "Adventure Report\n\n";
-            outFile << "Character: " << player.name << endl;
-            outFile << "Level: " << player.level << endl;
-            outFile << fixed << setprecision(2);
-            outFile << "Gold: " << player.gold << "\n\n";
+    // Deletes the front session
+    void dequeue() {
+        if (heap.empty()) throw ContainerException("Priority queue empty");
+        extract(0);
+    }
 
-            for (int i = 0; i < manager.size(); i++) {
-                outFile << "Session #" << i << ":\n";
-                manager.at(i)->print();
-                outFile << "\n";
-            }
+    // Hands the front session to the caller
+    unique_ptr<PlaySession> take() {
+        if (heap.empty()) throw ContainerException("Priority queue empty");
+        return extract(0);
+    }
 
-            outFile.close();
-            cout << "Report saved to report.txt\n";
+    PlaySession* session(Handle h) { return slotFor(h).session; }
+    const Key& key(Handle h) const { return heap[slotFor(h).position].key; }
+
+    // Re-reads the session's key after it changed and moves it to its new place
+    void update(Handle h) {
+        size_t i = slotFor(h).position;
+        heap[i].key = keyFn(*slots[h].session);
+        restore(i);
+    }
+
+    // Takes a session out of the middle of the queue and hands it to the caller
+    unique_ptr<PlaySession> remove(Handle h) { return extract(slotFor(h).position); }
+};
+
+// ================= UNDO HISTORY =================
+// Bounded undo/redo for a SessionContainer's add, remove and replace. A change is
+// recorded as the list node it touched and the node before it. Undo and redo run in
+// strict reverse order, so the list is always back in the state the record was made
+// in and relinking or unlinking that node is O(1); sessions are never copied. A
+// removed or replaced session stays owned by its record until the record falls off
+// the end of the history or a new change discards the redo stack, so memory is
+// bounded by the capacity, not by how long the session runs.
+//
+// While a history is attached every change to the container must go through it;
+// call clear() after changing the container directly (a bulk load, say).
+
+class SessionHistory {
+    enum Kind { ADDED, REMOVED, REPLACED };
+
+    struct Change {
+        Kind kind = ADDED;
+        SessionLinkedList::Node* node = nullptr;
+        SessionLinkedList::Node* before = nullptr;
+        int index = 0;
+        PlaySession* other = nullptr;   // REPLACED: the version not currently in the node
+        bool detached = false;          // ADDED/REMOVED: node is out of the list and owned here
+    };
+
+    SessionContainer& sessions;
+    RingStack<Change> undoStack;
+    RingStack<Change> redoStack;
+
+    void release(Change& c) {
+        if (c.kind == REPLACED) delete c.other;
+        else if (c.detached) sessions.list.freeNode(c.node);
+    }
+
+    void discardRedo() {
+        while (!redoStack.isEmpty()) {
+            Change c = redoStack.pop();
+            release(c);
+        }
+    }
+
+    void record(const Change& c) {
+        discardRedo();
+        Change dropped;
+        if (undoStack.push(c, dropped)) release(dropped);
+    }
+
+    // Undoes a change or redoes an undone one; the two are the same operation
+    void flip(Change& c) {
+        if (c.kind == REPLACED) c.other = sessions.swapSession(c.node, c.other, c.index);
+        else if (c.detached) sessions.linkAfter(c.before, c.node, c.index);
+        else sessions.unlinkAfter(c.before, c.index);
+        if (c.kind != REPLACED) c.detached = !c.detached;
+    }
+
+    // Moves the newest change from one stack to the other, flipping it on the way.
+    // The stacks share one capacity's worth of changes, so this push never evicts.
+    bool transfer(RingStack<Change>& from, RingStack<Change>& to) {
+        if (from.isEmpty()) return false;
+        Change c = from.pop();
+        flip(c);
+        Change unused;
+        to.push(c, unused);
+        return true;
+    }
+
+public:
+    explicit SessionHistory(SessionContainer& container, size_t capacity = 100)
+        : sessions(container), undoStack(capacity), redoStack(capacity) {}
+
+    SessionHistory(const SessionHistory&) = delete;
+    SessionHistory& operator=(const SessionHistory&) = delete;
+
+    ~SessionHistory() { clear(); }
+
+    size_t capacity() const { return undoStack.capacity(); }
+    size_t undoDepth() const { return undoStack.size(); }
+    size_t redoDepth() const { return redoStack.size(); }
+
+    // Takes ownership of the session
+    void add(PlaySession* s) {
+        Change c;
+        c.before = sessions.list.tail;
+        c.index = sessions.size();
+        sessions.add(s);
+        c.node = sessions.list.tail;
+        record(c);
+    }
+
+    void remove(int index) {
+        if (index < 0 || index >= sessions.size()) throw ContainerException("Invalid index");
+        Change c;
+        c.kind = REMOVED;
+        c.before = sessions.nodeBefore(index);
+        c.index = index;
+        c.node = sessions.unlinkAfter(c.before, index);
+        c.detached = true;
+        record(c);
+    }
+
+    // Takes ownership of the new session; the old one is kept for undo
+    void replace(int index, PlaySession* s) {
+        if (index < 0 || index >= sessions.size()) throw ContainerException("Invalid index");
+        Change c;
+        c.kind = REPLACED;
+        c.before = sessions.nodeBefore(index);
+        c.node = c.before ? c.before->next : sessions.list.head;
+        c.index = index;
+        c.other = sessions.swapSession(c.node, s, index);
+        record(c);
+    }
+
+    // Each returns false if there was nothing to undo or redo
+    bool undo() { return transfer(undoStack, redoStack); }
+    bool redo() { return transfer(redoStack, undoStack); }
+
+    // Forgets every change, freeing the sessions only the history still held
+    void clear() {
+        discardRedo();
+        while (!undoStack.isEmpty()) {
+            Change c = undoStack.pop();
+            release(c);
+        }
+    }
+};
+
+
+
+// ================= TASK SCHEDULER =================
+// One shared work-stealing pool for the parallel parts of the program: loading,
+// saving, aggregation, sorting, report rendering and data generation.
+//
+// Every worker owns a deque. Tasks spawned on a worker go to the back of its own
+// deque and it pops from the back, so nested work stays in its cache; an idle worker
+// steals from the front of another deque, taking the oldest and usually biggest piece.
+// Tasks started from outside the pool go to a shared queue. A thread waiting on a
+// TaskGroup runs queued tasks until the group is done, so nested parallelFor calls
+// never park a worker, and a pool with no workers still finishes everything on the
+// waiting thread. For the same reason a task must not wait on a group while it holds
+// a lock that another queued task takes.
+//
+// Every task and every WorkSpan is charged to a WorkSubsystem, and the time it runs is
+// added to that subsystem's span statistics (printTaskReport, taskReportJson). A task
+// that waits on a nested group is charged for the tasks it runs meanwhile as well.
+
+enum WorkSubsystem {
+    WORK_LOADING,       // JSON, CSV and roster loads
+    WORK_SAVING,        // roster saves
+    WORK_AGGREGATION,   // totals and recommendations
+    WORK_SORTING,       // parallelSort
+    WORK_REPORTING,     // report rendering
+    WORK_GENERATION,    // synthetic workloads
+    WORK_SUBSYSTEM_COUNT
+};
+
+const char* workSubsystemName(WorkSubsystem w) {
+    static const char* names[WORK_SUBSYSTEM_COUNT] = { "loading", "saving", "aggregation", "sorting", "reporting", "generation" };
+    return names[w];
+}
+
+struct SpanStats {
+    long long spans = 0;
+    long long busyNanos = 0;
+};
+
+class SpanAccount {
+    atomic<long long> spans{ 0 };
+    atomic<long long> busyNanos{ 0 };
+
+public:
+    void record(long long nanos) {
+        spans.fetch_add(1, memory_order_relaxed);
+        busyNanos.fetch_add(nanos, memory_order_relaxed);
+    }
+
+    SpanStats stats() const {
+        SpanStats s;
+        s.spans = spans.load(memory_order_relaxed);
+        s.busyNanos = busyNanos.load(memory_order_relaxed);
+        return s;
+    }
+};
+
+SpanAccount& spanAccount(WorkSubsystem w) {
+    static SpanAccount accounts[WORK_SUBSYSTEM_COUNT];
+    return accounts[w];
+}
+
+// Times a stretch of work, on the pool or off it, and charges it to a subsystem
+class WorkSpan {
+    WorkSubsystem area;
+    chrono::steady_clock::time_point start;
+
+public:
+    explicit WorkSpan(WorkSubsystem w) : area(w), start(chrono::steady_clock::now()) {}
+    WorkSpan(const WorkSpan&) = delete;
+    WorkSpan& operator=(const WorkSpan&) = delete;
+
+    ~WorkSpan() {
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        spanAccount(area).record(static_cast<long long>(nanos));
+    }
+};
+
+class TaskScheduler;
+
+// Tasks that are waited for together. wait() rethrows the first exception a task threw,
+// after every task in the group has finished.
+class TaskGroup {
+    friend class TaskScheduler;
+
+    TaskScheduler& scheduler;
+    atomic<size_t> pending{ 0 };
+    mutex errorLock;
+    exception_ptr error;
+
+    void finished(exception_ptr failure);
+
+public:
+    explicit TaskGroup(TaskScheduler& s) : scheduler(s) {}
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+    ~TaskGroup();
+
+    void run(WorkSubsystem area, function<void()> fn);
+    void wait();
+};
+
+class TaskScheduler {
+    friend class TaskGroup;
+
+    struct Task {
+        function<void()> fn;
+        TaskGroup* group = nullptr;
+        WorkSubsystem area = WORK_AGGREGATION;
+    };
+
+    struct alignas(64) WorkQueue {      // own cache line so deques do not false-share
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<WorkQueue>> queues;   // one per worker
+    WorkQueue injected;                     // tasks from threads outside the pool
+    vector<thread> workers;
+    atomic<long long> queued{ 0 };
+    atomic<long long> steals{ 0 };
+    mutex sleepLock;
+    condition_variable wake;                // idle workers and waiting groups
+    bool stopping = false;
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+
+    // Which pool and deque the current thread works for, if any
+    static inline thread_local TaskScheduler* currentPool = nullptr;
+    static inline thread_local size_t currentQueue = 0;
+
+    void push(Task task) {
+        WorkQueue& q = currentPool == this ? *queues[currentQueue] : injected;
+        {
+            lock_guard<mutex> guard(q.lock);
+            q.tasks.push_back(move(task));
+        }
+        queued.fetch_add(1);
+        { lock_guard<mutex> guard(sleepLock); }     // a sleeper is either waiting or will see queued
+        wake.notify_one();
+    }
+
+    bool popBack(WorkQueue& q, Task& out) {
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) return false;
+        out = move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool popFront(WorkQueue& q, Task& out) {
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) return false;
+        out = move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+    }
+
+    // Own deque newest first, then the shared queue, then the oldest task of another worker
+    bool findTask(Task& out) {
+        bool isWorker = currentPool == this;
+        if (isWorker && popBack(*queues[currentQueue], out)) return true;
+        if (popFront(injected, out)) return true;
+        size_t n = queues.size();
+        size_t start = isWorker ? currentQueue + 1 : 0;
+        for (size_t i = 0; i < n; i++) {
+            size_t victim = (start + i) % n;
+            if (isWorker && victim == currentQueue) continue;
+            if (popFront(*queues[victim], out)) {
+                steals.fetch_add(1, memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool runOne() {
+        Task task;
+        if (!findTask(task)) return false;
+        queued.fetch_sub(1);
+
+        exception_ptr failure;
+        {
+            WorkSpan span(task.area);
+            try { task.fn(); }
+            catch (...) { failure = current_exception(); }
+        }
+        task.fn = nullptr;      // captured state goes before the waiter can return
+        task.group->finished(failure);
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        currentPool = this;
+        currentQueue = index;
+        while (true) {
+            if (runOne()) continue;
+            unique_lock<mutex> guard(sleepLock);
+            wake.wait(guard, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+
+    // Runs queued tasks until the group has none left outstanding
+    void waitFor(TaskGroup& group) {
+        while (group.pending.load() > 0) {
+            if (runOne()) continue;
+            unique_lock<mutex> guard(sleepLock);
+            wake.wait(guard, [&] { return group.pending.load() == 0 || queued.load() > 0; });
+        }
+    }
+
+public:
+    // workerCount threads besides the ones that wait on groups; 0 runs every task on
+    // the waiting thread
+    explicit TaskScheduler(int workerCount) {
+        for (int i = 0; i < workerCount; i++) queues.emplace_back(new WorkQueue());
+        for (int i = 0; i < workerCount; i++) workers.emplace_back(&TaskScheduler::workerLoop, this, static_cast<size_t>(i));
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Workers finish what is queued before they exit
+    ~TaskScheduler() {
+        {
+            lock_guard<mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& t : workers) t.join();
+    }
+
+    int workerCount() const { return static_cast<int>(workers.size()); }
+    long long stealCount() const { return steals.load(memory_order_relaxed); }
+    double uptimeSeconds() const { return chrono::duration<double>(chrono::steady_clock::now() - started).count(); }
+
+    // Piece size parallelFor uses: about four pieces per thread, never under grain
+    size_t pieceSize(size_t n, size_t grain) const {
+        size_t threads = workers.size() + 1;
+        return max(max<size_t>(1, grain), (n + threads * 4 - 1) / (threads * 4));
+    }
+
+    // Runs fn(begin, end) over pieces covering [0, n). A range that fits in one piece
+    // runs on the calling thread.
+    template <typename Fn>
+    void parallelFor(WorkSubsystem area, size_t n, size_t grain, Fn fn) {
+        if (n == 0) return;
+        size_t piece = pieceSize(n, grain);
+        if (piece >= n) {
+            WorkSpan span(area);
+            fn(size_t(0), n);
+            return;
+        }
+
+        TaskGroup group(*this);
+        for (size_t begin = 0; begin < n; begin += piece) {
+            size_t end = min(n, begin + piece);
+            group.run(area, [&fn, begin, end] { fn(begin, end); });
+        }
+        group.wait();
+    }
+
+    // Folds map(begin, end) over pieces of exactly grain items with combine, in order.
+    // The pieces depend only on n and grain, so floating-point results do not change
+    // with the number of workers.
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(WorkSubsystem area, size_t n, size_t grain, T identity, Map map, Combine combine) {
+        grain = max<size_t>(1, grain);
+        size_t pieces = (n + grain - 1) / grain;
+        vector<T> partial(pieces, identity);
+        parallelFor(area, pieces, 1, [&](size_t first, size_t last) {
+            for (size_t p = first; p < last; p++) partial[p] = map(p * grain, min(n, (p + 1) * grain));
+        });
+
+        T result = move(identity);
+        for (T& part : partial) result = combine(move(result), move(part));
+        return result;
+    }
+};
+
+inline void TaskGroup::run(WorkSubsystem area, function<void()> fn) {
+    pending.fetch_add(1);
+    TaskScheduler::Task task;
+    task.fn = move(fn);
+    task.group = this;
+    task.area = area;
+    scheduler.push(move(task));
+}
+
+// The last decrement can let the waiter return and destroy the group, so nothing of
+// the group is touched after it; the decrement happens under sleepLock so a waiter
+// cannot miss the wake-up.
+inline void TaskGroup::finished(exception_ptr failure) {
+    if (failure) {
+        lock_guard<mutex> guard(errorLock);
+        if (!error) error = failure;
+    }
+    TaskScheduler& s = scheduler;
+    lock_guard<mutex> guard(s.sleepLock);
+    if (pending.fetch_sub(1) == 1) s.wake.notify_all();
+}
+
+inline void TaskGroup::wait() {
+    scheduler.waitFor(*this);
+    if (error) {
+        exception_ptr failure = error;
+        error = nullptr;
+        rethrow_exception(failure);
+    }
+}
+
+inline TaskGroup::~TaskGroup() { scheduler.waitFor(*this); }
+
+// Worker count for the shared scheduler: one fewer than the hardware threads, since
+// the thread that waits on a group works too
+int defaultTaskWorkers() {
+    return max(0, static_cast<int>(thread::hardware_concurrency()) - 1);
+}
+
+mutex sharedSchedulerLock;
+unique_ptr<TaskScheduler> sharedSchedulerInstance;
+
+TaskScheduler& sharedScheduler() {
+    lock_guard<mutex> guard(sharedSchedulerLock);
+    if (!sharedSchedulerInstance) sharedSchedulerInstance.reset(new TaskScheduler(defaultTaskWorkers()));
+    return *sharedSchedulerInstance;
+}
+
+// Replaces the shared scheduler. Only call while no parallel work is running.
+void setTaskWorkers(int workerCount) {
+    lock_guard<mutex> guard(sharedSchedulerLock);
+    sharedSchedulerInstance.reset();
+    sharedSchedulerInstance.reset(new TaskScheduler(max(0, workerCount)));
+}
+
+// Sorts pieces in parallel, then merges neighbouring runs pairwise, a level at a time
+template <typename It, typename Less = less<>>
+void parallelSort(WorkSubsystem area, It first, It last, Less before = Less()) {
+    const size_t SORT_GRAIN = 1 << 15;
+    TaskScheduler& pool = sharedScheduler();
+    size_t n = static_cast<size_t>(last - first);
+    size_t piece = pool.pieceSize(n, SORT_GRAIN);
+    if (piece >= n) {
+        WorkSpan span(area);
+        sort(first, last, before);
+        return;
+    }
+
+    size_t runs = (n + piece - 1) / piece;
+    pool.parallelFor(area, runs, 1, [&](size_t b, size_t e) {
+        for (size_t r = b; r < e; r++) sort(first + r * piece, first + min(n, (r + 1) * piece), before);
+    });
+    for (size_t width = piece; width < n; width *= 2) {
+        size_t pairs = (n + 2 * width - 1) / (2 * width);
+        pool.parallelFor(area, pairs, 1, [&](size_t b, size_t e) {
+            for (size_t p = b; p < e; p++) {
+                size_t lo = p * 2 * width;
+                size_t mid = min(n, lo + width);
+                size_t hi = min(n, lo + 2 * width);
+                if (mid < hi) inplace_merge(first + lo, first + mid, first + hi, before);
+            }
+        });
+    }
+}
+
+// Busy time per subsystem since startup. Utilization is busy time over the pool's
+// capacity (workers plus the main thread) since the shared scheduler started.
+json taskReportJson() {
+    TaskScheduler& pool = sharedScheduler();
+    double capacity = pool.uptimeSeconds() * (pool.workerCount() + 1);
+    json subsystems = json::object();
+    for (int w = 0; w < WORK_SUBSYSTEM_COUNT; w++) {
+        SpanStats s = spanAccount(static_cast<WorkSubsystem>(w)).stats();
+        double busy = s.busyNanos / 1e9;
+        subsystems[workSubsystemName(static_cast<WorkSubsystem>(w))] = {
+            { "spans", s.spans }, { "busySeconds", busy }, { "utilization", capacity > 0 ? busy / capacity : 0.0 } };
+    }
+    return json{ { "workers", pool.workerCount() }, { "uptimeSeconds", pool.uptimeSeconds() },
+        { "steals", pool.stealCount() }, { "subsystems", subsystems } };
+}
+
+void printTaskReport(ostream& os = cout) {
+    json report = taskReportJson();
+    os << "Workers: " << report["workers"].get<int>() << " (plus the waiting thread), steals: "
+        << report["steals"].get<long long>() << "\n";
+    os << left << setw(14) << "Subsystem" << right << setw(10) << "Spans" << setw(12) << "Busy s" << setw(14) << "Utilization" << "\n";
+    for (int w = 0; w < WORK_SUBSYSTEM_COUNT; w++) {
+        const json& s = report["subsystems"][workSubsystemName(static_cast<WorkSubsystem>(w))];
+        os << left << setw(14) << workSubsystemName(static_cast<WorkSubsystem>(w)) << right << setw(10)
+            << s["spans"].get<long long>() << fixed << setprecision(3) << setw(12) << s["busySeconds"].get<double>()
+            << setprecision(1) << setw(13) << s["utilization"].get<double>() * 100 << "%\n" << defaultfloat;
+    }
+}
+
+// ================= JSON LOADING =================
+// Session files are a JSON array of objects shaped like sessions.json
+
+Difficulty difficultyFromString(const string& text) {
+    if (text == "Explorer") return EXPLORER;
+    if (text == "Balanced") return BALANCED;
+    if (text == "Tactician") return TACTICIAN;
+    throw runtime_error("Unknown difficulty: " + text);
+}
+
+// Same names as difficultyToString, without building a string
+const char* difficultyName(Difficulty d) {
+    switch (d) {
+    case EXPLORER:  return "Explorer";
+    case BALANCED:  return "Balanced";
+    case TACTICIAN: return "Tactician";
+    }
+    return "Explorer";
+}
+
+string difficultyToString(Difficulty d) { return difficultyName(d); }
+
+// Builds one session object from a JSON record. Caller owns the result.
+PlaySession* sessionFromJson(const json& j) {
+    string type = j.at("type").get<string>();
+    string loc = j.at("location").get<string>();
+    int dur = j.at("durationMinutes").get<int>();
+    Difficulty diff = difficultyFromString(j.at("difficulty").get<string>());
+    LootInfo loot(j.value("goldEarned", 0), j.value("rareItemFound", false));
+
+    SessionType id;
+    if (!RegisteredSessions::findTag(type, id)) throw runtime_error("Unknown session type: " + type);
+
+    return makeSession(id, loc, dur, diff, j.value(RegisteredSessions::countFieldOf(id), 0), loot);
+}
+
+json sessionToJson(const PlaySession& s) {
+    SessionType type = sessionTypeOf(s);
+    LootInfo loot = sessionLoot(s);
+
+    json j;
+    j["type"] = RegisteredSessions::tagOf(type);
+    j["location"] = s.getLocation();
+    j["durationMinutes"] = s.getDuration();
+    j["difficulty"] = difficultyToString(s.getDifficulty());
+    j["goldEarned"] = loot.getGoldEarned();
+    j["rareItemFound"] = loot.isRareItemFound();
+    j[RegisteredSessions::countFieldOf(type)] = sessionCount(s);
+    return j;
+}
+
+const size_t JSON_LOAD_GRAIN = 4096;
+
+// Loads every session in the file into the container and returns how many were added.
+// Nothing is added if any record is bad, so a failed load leaves the container untouched.
+// Records are converted to sessions in parallel and added in file order.
+int loadSessionsFromJson(const string& fileName, SessionContainer& manager) {
+    ifstream inFile(fileName);
+    if (!inFile) throw runtime_error("Could not open " + fileName);
+
+    vector<PlaySession*> loaded;
+    try {
+        const json data = json::parse(inFile);
+        if (!data.is_array()) throw runtime_error(fileName + " must contain a JSON array");
+
+        loaded.assign(data.size(), nullptr);
+        sharedScheduler().parallelFor(WORK_LOADING, data.size(), JSON_LOAD_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) loaded[i] = sessionFromJson(data[i]);
+        });
+    }
+    catch (const json::exception& e) {
+        for (PlaySession* s : loaded) delete s;
+        throw runtime_error("Bad session file " + fileName + ": " + e.what());
+    }
+    catch (...) {
+        for (PlaySession* s : loaded) delete s;
+        throw;
+    }
+
+    for (PlaySession* s : loaded) manager.add(s);
+    return static_cast<int>(loaded.size());
+}
+
+void saveSessionsToJson(const string& fileName, SessionContainer& manager) {
+    json data = json::array();
+    for (const PlaySession& s : manager)
+        data.push_back(sessionToJson(s));
+
+    ofstream outFile(fileName);
+    if (!outFile) throw runtime_error("Could not write " + fileName);
+    outFile << data.dump(2) << "\n";
+}
+
+// Reads the elements of a top-level JSON array one at a time, so a file can be
+// consumed while it is still being parsed instead of after the whole document is built.
+class JsonArrayReader {
+    istream& in;
+    vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    long long consumed = 0;
+    bool started = false;
+    bool finished = false;
+
+    bool refill() {
+        in.read(buffer.data(), static_cast<streamsize>(buffer.size()));
+        end = static_cast<size_t>(in.gcount());
+        pos = 0;
+        return end > 0;
+    }
+
+    int peekChar() {
+        if (pos == end && !refill()) return EOF;
+        return static_cast<unsigned char>(buffer[pos]);
+    }
+
+    int getChar() {
+        int c = peekChar();
+        if (c != EOF) { pos++; consumed++; }
+        return c;
+    }
+
+    int skipSpace() {
+        int c;
+        while ((c = peekChar()) == ' ' || c == '\n' || c == '\r' || c == '\t') getChar();
+        return c;
+    }
+
+    static void fail(const string& what) { throw runtime_error("Malformed JSON array: " + what); }
+
+public:
+    explicit JsonArrayReader(istream& input) : in(input), buffer(1 << 16) {}
+
+    long long bytesRead() const { return consumed; }
+
+    // Parses the next element into out. Returns false once the closing bracket is reached.
+    bool next(json& out) {
+        if (finished) return false;
+
+        if (!started) {
+            if (skipSpace() != '[') fail("expected '['");
+            getChar();
+            started = true;
+            if (skipSpace() == ']') {
+                getChar();
+                skipSpace();
+                finished = true;
+                return false;
+            }
+        }
+
+        // Collect the element's text up to the ',' or ']' that ends it at depth 0
+        string text;
+        int depth = 0;
+        bool inString = false;
+        bool escaped = false;
+
+        while (true) {
+            int c = getChar();
+            if (c == EOF) fail("unexpected end of input");
+
+            if (inString) {
+                if (escaped) escaped = false;
+                else if (c == '\\') escaped = true;
+                else if (c == '"') inString = false;
+            }
+            else if (depth == 0 && (c == ',' || c == ']')) {
+                finished = c == ']';
+                break;
+            }
+            else if (c == '"') inString = true;
+            else if (c == '{' || c == '[') depth++;
+            else if (c == '}' || c == ']') depth--;
+
+            text += static_cast<char>(c);
+        }
+
+        if (finished) skipSpace();     // so bytesRead reaches the end of the file
+
+        try { out = json::parse(text); }
+        catch (const json::exception& e) { fail(e.what()); }
+        return true;
+    }
+};
+
+// ================= WIRE FORMAT =================
+// Compact binary session file that can be read in place. Every integer is
+// little-endian regardless of the host, and every record is 8-byte aligned.
+//
+//   offset  size  header
+//        0     4  magic "BGSW"
+//        4     2  version (WIRE_VERSION)
+//        6     2  header size (40)
+//        8     8  record count
+//       16     8  strings offset from the start of the file
+//       24     8  strings size
+//       32     4  checksum of everything after the header
+//       36     4  record size (24)
+//
+//   offset  size  record
+//        0     4  location offset into the strings section
+//        4     4  location length
+//        8     4  duration minutes (signed)
+//       12     4  count: enemies defeated / areas discovered (signed)
+//       16     4  gold earned (signed)
+//       20     1  session type id
+//       21     1  difficulty
+//       22     1  flags: bit 0 rare item found
+//       23     1  reserved, 0
+//
+// The strings section holds each distinct location once, without terminators.
+// Readers never allocate: locations come back as string_views into the buffer.
+
+const uint16_t WIRE_VERSION = 1;
+const size_t WIRE_HEADER_SIZE = 40;
+const size_t WIRE_RECORD_SIZE = 24;
+const uint8_t WIRE_FLAG_RARE = 1;
+
+inline uint16_t loadLE16(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>(b[0] | (b[1] << 8));
+}
+
+inline uint32_t loadLE32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24);
+}
+
+inline uint64_t loadLE64(const char* p) {
+    return uint64_t(loadLE32(p)) | (uint64_t(loadLE32(p + 4)) << 32);
+}
+
+inline void storeLE16(char* p, uint16_t v) {
+    p[0] = static_cast<char>(v);
+    p[1] = static_cast<char>(v >> 8);
+}
+
+inline void storeLE32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<char>(v >> (8 * i));
+}
+
+inline void storeLE64(char* p, uint64_t v) {
+    storeLE32(p, static_cast<uint32_t>(v));
+    storeLE32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+inline uint64_t fnv1a64(const char* data, size_t n, uint64_t h = 14695981039346656037ull) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// FNV-1a over the payload taken 8 little-endian bytes at a time (the last word
+// zero-padded), folded to 32 bits. Feed it in pieces with update(); only the final
+// piece may have a length that is not a multiple of 8.
+class WireChecksum {
+    uint64_t h = 14695981039346656037ull;
+
+public:
+    void update(const char* data, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            h ^= loadLE64(data + i);
+            h *= 1099511628211ull;
+        }
+        if (i < n) {
+            char tail[8] = {};
+            memcpy(tail, data + i, n - i);
+            h ^= loadLE64(tail);
+            h *= 1099511628211ull;
+        }
+    }
+
+    uint32_t value() const { return static_cast<uint32_t>(h ^ (h >> 32)); }
+};
+
+inline void packWireRecord(char* out, uint32_t locationOffset, uint32_t locationLength, SessionType type,
+    Difficulty diff, int duration, int count, const LootInfo& loot) {
+    storeLE32(out, locationOffset);
+    storeLE32(out + 4, locationLength);
+    storeLE32(out + 8, static_cast<uint32_t>(duration));
+    storeLE32(out + 12, static_cast<uint32_t>(count));
+    storeLE32(out + 16, static_cast<uint32_t>(loot.getGoldEarned()));
+    out[20] = static_cast<char>(type);
+    out[21] = static_cast<char>(diff);
+    out[22] = static_cast<char>(loot.isRareItemFound() ? WIRE_FLAG_RARE : 0);
+    out[23] = 0;
+}
+
+inline void packWireHeader(char* out, uint64_t recordCount, uint64_t stringsSize, uint32_t checksum) {
+    memcpy(out, "BGSW", 4);
+    storeLE16(out + 4, WIRE_VERSION);
+    storeLE16(out + 6, static_cast<uint16_t>(WIRE_HEADER_SIZE));
+    storeLE64(out + 8, recordCount);
+    storeLE64(out + 16, WIRE_HEADER_SIZE + recordCount * WIRE_RECORD_SIZE);
+    storeLE64(out + 24, stringsSize);
+    storeLE32(out + 32, checksum);
+    storeLE32(out + 36, static_cast<uint32_t>(WIRE_RECORD_SIZE));
+}
+
+// Checks the record count and strings section in a header against the size of the
+// file, before either is used to size a read or an allocation
+inline void checkWireSections(const char* header, uint64_t fileSize) {
+    uint64_t count = loadLE64(header + 8);
+    uint64_t stringsOffset = loadLE64(header + 16);
+    uint64_t stringsSize = loadLE64(header + 24);
+    if (fileSize < WIRE_HEADER_SIZE || count > (fileSize - WIRE_HEADER_SIZE) / WIRE_RECORD_SIZE ||
+        stringsOffset != WIRE_HEADER_SIZE + count * WIRE_RECORD_SIZE || stringsSize != fileSize - stringsOffset)
+        throw runtime_error("Session wire file is truncated");
+}
+
+// Whether a record's location lies in the strings section and its type and difficulty
+// bytes name real values. WireRecordView does not check, so readers run this first.
+inline bool wireRecordValid(const char* rec, uint64_t stringsSize) {
+    unsigned char diff = static_cast<unsigned char>(rec[21]);
+    return uint64_t(loadLE32(rec)) + loadLE32(rec + 4) <= stringsSize &&
+        static_cast<unsigned char>(rec[20]) < RegisteredSessions::COUNT && diff >= EXPLORER && diff <= TACTICIAN;
+}
+
+// Read-only view of one record inside a wire buffer
+class WireRecordView {
+    const char* rec;
+    const char* strings;
+
+public:
+    WireRecordView(const char* r, const char* s) : rec(r), strings(s) {}
+
+    string_view getLocation() const { return string_view(strings + loadLE32(rec), loadLE32(rec + 4)); }
+    int getDuration() const { return static_cast<int32_t>(loadLE32(rec + 8)); }
+    int getCount() const { return static_cast<int32_t>(loadLE32(rec + 12)); }
+    int getGoldEarned() const { return static_cast<int32_t>(loadLE32(rec + 16)); }
+    SessionType getType() const { return static_cast<SessionType>(static_cast<unsigned char>(rec[20])); }
+    Difficulty getDifficulty() const { return static_cast<Difficulty>(static_cast<unsigned char>(rec[21])); }
+    bool isRareItemFound() const { return (rec[22] & WIRE_FLAG_RARE) != 0; }
+
+    double calculateValue() const { return getCount() * RegisteredSessions::valuePerCount(getType()); }
+
+    // Builds a full session object. Caller owns the result.
+    PlaySession* toSession() const {
+        string_view loc = getLocation();
+        return makeSession(getType(), string(loc.data(), loc.size()), getDuration(), getDifficulty(),
+            getCount(), LootInfo(getGoldEarned(), isRareItemFound()));
+    }
+};
+
+// Validates a wire buffer once, then gives allocation-free access to its records.
+// The buffer must outlive the view.
+class SessionWireView {
+    const char* data;
+    uint64_t count;
+    const char* strings;
+
+public:
+    // Throws runtime_error if the buffer is not a valid wire file of this version
+    SessionWireView(const char* buffer, size_t size, bool verifyChecksum = true) : data(buffer) {
+        if (size < WIRE_HEADER_SIZE || memcmp(buffer, "BGSW", 4) != 0)
+            throw runtime_error("Not a session wire file");
+        if (loadLE16(buffer + 4) != WIRE_VERSION)
+            throw runtime_error("Unsupported session wire version " + to_string(loadLE16(buffer + 4)));
+        if (loadLE16(buffer + 6) != WIRE_HEADER_SIZE || loadLE32(buffer + 36) != WIRE_RECORD_SIZE)
+            throw runtime_error("Unexpected session wire layout");
+
+        checkWireSections(buffer, size);
+        count = loadLE64(buffer + 8);
+        uint64_t stringsSize = loadLE64(buffer + 24);
+        strings = buffer + loadLE64(buffer + 16);
+
+        if (verifyChecksum) {
+            WireChecksum sum;
+            sum.update(buffer + WIRE_HEADER_SIZE, size - WIRE_HEADER_SIZE);
+            if (sum.value() != loadLE32(buffer + 32)) throw runtime_error("Session wire checksum mismatch");
+        }
+
+        // Records are checked up front so record accessors can stay unchecked
+        for (uint64_t i = 0; i < count; i++) {
+            if (!wireRecordValid(data + WIRE_HEADER_SIZE + i * WIRE_RECORD_SIZE, stringsSize))
+                throw runtime_error("Session wire record " + to_string(i) + " is corrupt");
+        }
+    }
+
+    size_t size() const { return static_cast<size_t>(count); }
+
+    WireRecordView record(size_t i) const {
+        return WireRecordView(data + WIRE_HEADER_SIZE + i * WIRE_RECORD_SIZE, strings);
+    }
+};
+
+// Offset the next location gets in a strings section of stringsSize bytes. Record
+// fields are 32-bit, so throws once the location would end past UINT32_MAX.
+inline uint32_t nextWireStringOffset(uint64_t stringsSize, size_t locSize) {
+    if (stringsSize + locSize > UINT32_MAX)
+        throw runtime_error("Too many location bytes for a session wire file");
+    return static_cast<uint32_t>(stringsSize);
+}
+
+// Builds a wire buffer in memory. Distinct locations are stored once.
+class SessionWireWriter {
+    string records;
+    string strings;
+    unordered_map<string, uint32_t> stringOffsets;
+    uint64_t count = 0;
+
+public:
+    void add(SessionType type, const string& loc, int dur, Difficulty diff, int cnt, const LootInfo& loot) {
+        auto it = stringOffsets.find(loc);
+        if (it == stringOffsets.end()) {
+            it = stringOffsets.emplace(loc, nextWireStringOffset(strings.size(), loc.size())).first;
+            strings += loc;
+        }
+
+        char rec[WIRE_RECORD_SIZE];
+        packWireRecord(rec, it->second, static_cast<uint32_t>(loc.size()), type, diff, dur, cnt, loot);
+        records.append(rec, WIRE_RECORD_SIZE);
+        count++;
+    }
+
+    void add(const PlaySession& s) {
+        add(s.getType(), s.getLocation(), s.getDuration(), s.getDifficulty(), sessionCount(s), sessionLoot(s));
+    }
+
+    string finish() const {
+        WireChecksum sum;
+        sum.update(records.data(), records.size());
+        sum.update(strings.data(), strings.size());
+
+        string out(WIRE_HEADER_SIZE, '\0');
+        packWireHeader(&out[0], count, strings.size(), sum.value());
+        return out + records + strings;
+    }
+};
+
+void saveSessionsToWire(const string& fileName, SessionContainer& manager) {
+    SessionWireWriter writer;
+    for (const PlaySession& s : manager) writer.add(s);
+
+    ofstream outFile(fileName, ios::binary);
+    if (!outFile) throw runtime_error("Could not write " + fileName);
+    string bytes = writer.finish();
+    outFile.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+}
+
+// Like loadSessionsFromJson: all or nothing, returns how many sessions were added
+int loadSessionsFromWire(const string& fileName, SessionContainer& manager) {
+    ifstream inFile(fileName, ios::binary);
+    if (!inFile) throw runtime_error("Could not open " + fileName);
+
+    vector<char> bytes((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+    SessionWireView view(bytes.data(), bytes.size());
+    for (size_t i = 0; i < view.size(); i++) manager.add(view.record(i).toSession());
+    return static_cast<int>(view.size());
+}
+
+// Writes a wire file as the records arrive: a zeroed header first, then the records,
+// then the strings section, and finally the real header over the zeroed one. Holds
+// each distinct location and one block of records in memory, never the whole file.
+class WireFileWriter {
+    ofstream outFile;
+    string fileName;
+    string block;
+    string strings;
+    unordered_map<string, uint32_t> stringOffsets;
+    WireChecksum sum;
+    uint64_t count = 0;
+
+    void flushBlock() {
+        sum.update(block.data(), block.size());
+        outFile.write(block.data(), static_cast<streamsize>(block.size()));
+        block.clear();
+    }
+
+public:
+    explicit WireFileWriter(const string& name) : outFile(name, ios::binary), fileName(name) {
+        if (!outFile) throw runtime_error("Could not write " + fileName);
+        outFile.write(string(WIRE_HEADER_SIZE, '\0').data(), WIRE_HEADER_SIZE);
+        block.reserve(WIRE_RECORD_SIZE * 4096);
+    }
+
+    // Offset of loc in the strings section, adding it the first time it is seen
+    uint32_t location(const string& loc) {
+        auto it = stringOffsets.find(loc);
+        if (it == stringOffsets.end()) {
+            it = stringOffsets.emplace(loc, nextWireStringOffset(strings.size(), loc.size())).first;
+            strings += loc;
+        }
+        return it->second;
+    }
+
+    void add(const PlaySession& s) {
+        const string& loc = s.getLocation();
+        char rec[WIRE_RECORD_SIZE];
+        packWireRecord(rec, location(loc), static_cast<uint32_t>(loc.size()), s.getType(), s.getDifficulty(),
+            s.getDuration(), sessionCount(s), sessionLoot(s));
+        block.append(rec, WIRE_RECORD_SIZE);
+        count++;
+        if (block.size() == block.capacity()) flushBlock();
+    }
+
+    // n records already packed, with locations from location()
+    void addRecords(const char* records, size_t n) {
+        flushBlock();
+        sum.update(records, n * WIRE_RECORD_SIZE);
+        outFile.write(records, static_cast<streamsize>(n * WIRE_RECORD_SIZE));
+        count += n;
+    }
+
+    // Writes the strings section and the header; returns the size of the file
+    uint64_t finish() {
+        flushBlock();
+        sum.update(strings.data(), strings.size());
+        outFile.write(strings.data(), static_cast<streamsize>(strings.size()));
+
+        char header[WIRE_HEADER_SIZE];
+        packWireHeader(header, count, strings.size(), sum.value());
+        outFile.seekp(0);
+        outFile.write(header, WIRE_HEADER_SIZE);
+        outFile.seekp(0, ios::end);
+
+        uint64_t bytes = static_cast<uint64_t>(outFile.tellp());
+        if (!outFile) throw runtime_error("Failed writing " + fileName);
+        return bytes;
+    }
+};
+
+// ================= SESSION SOURCES =================
+// Lazy session generators. A source yields one session per next() call and never holds
+// more than the record it is on, so files larger than memory can be streamed through
+// aggregation or rewritten. SessionContainer is just one possible sink.
+
+class SessionSource {
+    long long position = 0;
+    long long key = -1;
+    bool stamped = false;
+
+public:
+    // Returns the next session, or nullptr once the input is exhausted
+    virtual unique_ptr<PlaySession> next() = 0;
+    virtual ~SessionSource() {}
+
+    // Order of the session next() returned last: the record's "timestamp" field if it
+    // has one, otherwise its position in the source, counting from 0
+    long long lastKey() const { return key; }
+    bool lastTimestamped() const { return stamped; }
+
+protected:
+    // Sources call one of these for every session they return
+    void keyByPosition() { keyAs(position, false); }
+    void keyAs(long long k, bool timestamp) {
+        key = k;
+        stamped = timestamp;
+        position++;
+    }
+    void keyFrom(const json& record) {
+        auto ts = record.find("timestamp");
+        if (ts == record.end()) keyByPosition();
+        else keyAs(ts->get<long long>(), true);
+    }
+};
+
+// A JSON array file shaped like sessions.json
+class JsonArraySource : public SessionSource {
+    ifstream inFile;
+    JsonArrayReader reader;
+    json record;
+
+public:
+    explicit JsonArraySource(const string& fileName) : inFile(fileName, ios::binary), reader(inFile) {
+        if (!inFile) throw runtime_error("Could not open " + fileName);
+    }
+
+    unique_ptr<PlaySession> next() override {
+        if (!reader.next(record)) return nullptr;
+        try {
+            unique_ptr<PlaySession> s(sessionFromJson(record));
+            keyFrom(record);
+            return s;
+        }
+        catch (const json::exception& e) { throw runtime_error(string("Bad session record: ") + e.what()); }
+    }
+};
+
+// One JSON session object per line; blank lines are skipped
+class JsonLinesSource : public SessionSource {
+    ifstream inFile;
+    string line;
+    long long lineNumber = 0;
+
+public:
+    explicit JsonLinesSource(const string& fileName) : inFile(fileName) {
+        if (!inFile) throw runtime_error("Could not open " + fileName);
+    }
+
+    unique_ptr<PlaySession> next() override {
+        while (getline(inFile, line)) {
+            lineNumber++;
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+
+            try {
+                json record = json::parse(line);
+                unique_ptr<PlaySession> s(sessionFromJson(record));
+                keyFrom(record);
+                return s;
+            }
+            catch (const json::exception& e) {
+                throw runtime_error("Bad session on line " + to_string(lineNumber) + ": " + e.what());
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Reads the header of a wire file and checks that it can be read record by record.
+// Leaves the stream at the first record.
+void readWireFileHeader(istream& in, char (&header)[WIRE_HEADER_SIZE]) {
+    if (!in.read(header, WIRE_HEADER_SIZE) || memcmp(header, "BGSW", 4) != 0)
+        throw runtime_error("Not a session wire file");
+    if (loadLE16(header + 4) != WIRE_VERSION || loadLE32(header + 36) != WIRE_RECORD_SIZE)
+        throw runtime_error("Unsupported session wire file");
+
+    in.seekg(0, ios::end);
+    streamoff fileSize = in.tellg();
+    in.seekg(static_cast<streamoff>(WIRE_HEADER_SIZE));
+    if (fileSize < 0 || !in) throw runtime_error("Could not read session wire file");
+    checkWireSections(header, static_cast<uint64_t>(fileSize));
+}
+
+// A wire file, streamed in blocks of records. Only the strings section is held in
+// memory. The checksum is checked once the last record has been read.
+class WireFileSource : public SessionSource {
+    ifstream inFile;
+    uint64_t remaining;
+    uint32_t expectedChecksum;
+    string strings;
+    WireChecksum sum;
+    vector<char> block;
+    size_t blockPos = 0;
+    size_t blockEnd = 0;
+
+public:
+    explicit WireFileSource(const string& fileName) : inFile(fileName, ios::binary) {
+        if (!inFile) throw runtime_error("Could not open " + fileName);
+
+        // Check the header, then fetch the strings section before streaming the records
+        char header[WIRE_HEADER_SIZE];
+        readWireFileHeader(inFile, header);
+
+        remaining = loadLE64(header + 8);
+        expectedChecksum = loadLE32(header + 32);
+        strings.resize(static_cast<size_t>(loadLE64(header + 24)));
+
+        inFile.seekg(static_cast<streamoff>(loadLE64(header + 16)));
+        if (!inFile.read(&strings[0], static_cast<streamsize>(strings.size())))
+            throw runtime_error("Session wire file is truncated");
+        inFile.seekg(static_cast<streamoff>(WIRE_HEADER_SIZE));
+
+        block.resize(WIRE_RECORD_SIZE * 4096);
+    }
+
+    unique_ptr<PlaySession> next() override {
+        if (blockPos == blockEnd) {
+            if (remaining == 0) return nullptr;
+
+            size_t records = static_cast<size_t>(min<uint64_t>(remaining, block.size() / WIRE_RECORD_SIZE));
+            if (!inFile.read(block.data(), static_cast<streamsize>(records * WIRE_RECORD_SIZE)))
+                throw runtime_error("Session wire file is truncated");
+            sum.update(block.data(), records * WIRE_RECORD_SIZE);
+
+            remaining -= records;
+            blockPos = 0;
+            blockEnd = records * WIRE_RECORD_SIZE;
+            if (remaining == 0) {
+                sum.update(strings.data(), strings.size());
+                if (sum.value() != expectedChecksum) throw runtime_error("Session wire checksum mismatch");
+            }
+        }
+
+        const char* rec = block.data() + blockPos;
+        blockPos += WIRE_RECORD_SIZE;
+        if (!wireRecordValid(rec, strings.size())) throw runtime_error("Session wire record is corrupt");
+
+        keyByPosition();
+        return unique_ptr<PlaySession>(WireRecordView(rec, strings.data()).toSession());
+    }
+};
+
+// Picks a source from the file extension: .jsonl / .ndjson for JSON lines, .bgsw for
+// the binary wire format, anything else is read as a JSON array
+unique_ptr<SessionSource> openSessionSource(const string& fileName) {
+    string ext = filesystem::path(fileName).extension().string();
+    if (ext == ".bgsw") return unique_ptr<SessionSource>(new WireFileSource(fileName));
+    if (ext == ".jsonl" || ext == ".ndjson") return unique_ptr<SessionSource>(new JsonLinesSource(fileName));
+    return unique_ptr<SessionSource>(new JsonArraySource(fileName));
+}
+
+// generator<PlaySession>-style wrapper so a source can be used in a range-for:
+//     for (auto& s : SessionGenerator(openSessionSource(file))) ...
+// Each element is a unique_ptr the loop body may move out of.
+class SessionGenerator {
+    unique_ptr<SessionSource> source;
+    unique_ptr<PlaySession> current;
+
+public:
+    explicit SessionGenerator(unique_ptr<SessionSource> src) : source(move(src)) {}
+
+    class iterator {
+        SessionGenerator* gen;
+
+    public:
+        using iterator_category = input_iterator_tag;
+        using value_type = unique_ptr<PlaySession>;
+        using difference_type = ptrdiff_t;
+        using pointer = unique_ptr<PlaySession>*;
+        using reference = unique_ptr<PlaySession>&;
+
+        explicit iterator(SessionGenerator* g = nullptr) : gen(g) {}
+
+        reference operator*() const { return gen->current; }
+        pointer operator->() const { return &gen->current; }
+
+        iterator& operator++() {
+            gen->current = gen->source->next();
+            if (!gen->current) gen = nullptr;
+            return *this;
+        }
+
+        bool operator==(const iterator& o) const { return gen == o.gen; }
+        bool operator!=(const iterator& o) const { return gen != o.gen; }
+    };
+
+    // Pulls the first session; a generator can only be walked once
+    iterator begin() { return ++iterator(this); }
+    iterator end() { return iterator(); }
+};
+
+// Sink: appends every remaining session to the container and returns how many
+int drainInto(SessionSource& source, SessionContainer& manager) {
+    int added = 0;
+    while (unique_ptr<PlaySession> s = source.next()) {
+        manager.add(s.release());
+        added++;
+    }
+    return added;
+}
+
+// Running totals that can be fed one session at a time
+struct SessionTotals {
+    long long sessions = 0;
+    long long minutes = 0;
+    long long gold = 0;
+    long long rareItems = 0;
+    double value = 0;
+
+    void add(const PlaySession& s) {
+        LootInfo loot = sessionLoot(s);
+        sessions++;
+        minutes += s.getDuration();
+        gold += loot.getGoldEarned();
+        rareItems += loot.isRareItemFound() ? 1 : 0;
+        value += s.calculateValue();
+    }
+};
+
+// Sink: aggregates a source without keeping any session past its own step
+SessionTotals accumulate(SessionSource& source) {
+    SessionTotals totals;
+    while (unique_ptr<PlaySession> s = source.next()) totals.add(*s);
+    return totals;
+}
+
+// Sink: writes sessions as JSON lines as they are produced
+class JsonLinesWriter {
+    ofstream outFile;
+
+public:
+    explicit JsonLinesWriter(const string& fileName) : outFile(fileName) {
+        if (!outFile) throw runtime_error("Could not write " + fileName);
+    }
+
+    void write(const PlaySession& s) { outFile << sessionToJson(s).dump() << '\n'; }
+};
+
+void saveSessionsToJsonLines(const string& fileName, SessionContainer& manager) {
+    JsonLinesWriter writer(fileName);
+    for (const PlaySession& s : manager)
+        writer.write(s);
+}
+
+// ================= DEDUPLICATION =================
+// Finds repeated sessions in linear time, for re-imports of overlapping exports.
+//
+// contentHash is a canonical 64-bit hash of everything a session records: type,
+// location, duration, difficulty, count and loot. It is FNV-1a over a fixed
+// little-endian layout, so it is the same on every platform and build and can be
+// stored. Two sessions are duplicates when sameContent says so. This is stricter than
+// CombatSession::operator==, which ignores difficulty and loot. SessionSet keys
+// sessions by hash and compares content only on a hash match, so a collision never
+// merges two different sessions.
+
+inline uint64_t hashUint32(uint32_t v, uint64_t h) {
+    char bytes[4];
+    storeLE32(bytes, v);
+    return fnv1a64(bytes, sizeof(bytes), h);
+}
+
+uint64_t contentHash(const LootInfo& loot, uint64_t h = 14695981039346656037ull) {
+    h = hashUint32(static_cast<uint32_t>(loot.getGoldEarned()), h);
+    return hashUint32(loot.isRareItemFound() ? 1u : 0u, h);
+}
+
+// Covers every registered session type through the registry's count and loot
+uint64_t contentHash(const PlaySession& s) {
+    const string& loc = s.getLocation();
+    uint64_t h = hashUint32(static_cast<uint32_t>(sessionTypeOf(s)), 14695981039346656037ull);
+    h = hashUint32(static_cast<uint32_t>(loc.size()), h);
+    h = fnv1a64(loc.data(), loc.size(), h);
+    h = hashUint32(static_cast<uint32_t>(s.getDuration()), h);
+    h = hashUint32(static_cast<uint32_t>(s.getDifficulty()), h);
+    h = hashUint32(static_cast<uint32_t>(sessionCount(s)), h);
+    return contentHash(sessionLoot(s), h);
+}
+
+bool sameContent(const PlaySession& a, const PlaySession& b) {
+    return sessionTypeOf(a) == sessionTypeOf(b) && a.getDuration() == b.getDuration() &&
+        a.getDifficulty() == b.getDifficulty() && sessionCount(a) == sessionCount(b) &&
+        sessionLoot(a) == sessionLoot(b) && a.getLocation() == b.getLocation();
+}
+
+// Sessions with distinct content. Holds pointers, so every session inserted must
+// outlive the set.
+class SessionSet {
+    unordered_multimap<uint64_t, const PlaySession*> byHash;
+
+public:
+    explicit SessionSet(size_t expected = 0) { byHash.reserve(expected); }
+
+    bool contains(const PlaySession& s) const { return find(s, contentHash(s)); }
+
+    // Adds s unless a session with the same content is in already; returns whether it was added
+    bool insert(const PlaySession& s) {
+        uint64_t h = contentHash(s);
+        if (find(s, h)) return false;
+        byHash.emplace(h, &s);
+        return true;
+    }
+
+    size_t size() const { return byHash.size(); }
+
+private:
+    bool find(const PlaySession& s, uint64_t h) const {
+        auto range = byHash.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it)
+            if (sameContent(*it->second, s)) return true;
+        return false;
+    }
+};
+
+// What a load does with a session whose content is already in the container
+enum IngestMode {
+    INGEST_ALL,         // add it anyway
+    INGEST_UNIQUE       // drop it
+};
+
+SessionSet sessionSetOf(const SessionContainer& manager) {
+    SessionSet set(static_cast<size_t>(manager.size()));
+    for (const PlaySession& s : manager) set.insert(s);
+    return set;
+}
+
+// Sink: like drainInto, but skips sessions already in the container or earlier in the
+// source. Returns how many were added.
+int drainUniqueInto(SessionSource& source, SessionContainer& manager) {
+    SessionSet seen = sessionSetOf(manager);
+    int added = 0;
+    while (unique_ptr<PlaySession> s = source.next()) {
+        if (!seen.insert(*s)) continue;
+        manager.add(s.release());
+        added++;
+    }
+    return added;
+}
+
+// Keeps the first of every group of sessions with the same content and removes the
+// rest. Returns how many were removed.
+int removeDuplicateSessions(SessionContainer& manager) {
+    SessionSet seen(static_cast<size_t>(manager.size()));
+    return manager.removeIf([&](const PlaySession& s) { return !seen.insert(s); });
+}
+
+// ================= BACKGROUND LOADING =================
+// Parses a session file on a background thread. Parsed sessions wait in a hand-off
+// buffer until the owner of a SessionContainer drains them in, so the container itself
+// is still only touched from one thread while the menu stays responsive.
+//
+// Unlike loadSessionsFromJson this is progressive: sessions before a bad record stay
+// available and the failure is reported through progress() and wait().
+
+struct LoadProgress {
+    long long bytesRead = 0;
+    long long totalBytes = 0;
+    int sessionsParsed = 0;
+    bool done = false;
+    string error;           // empty unless the load failed
+};
+
+class AsyncSessionLoad {
+    ifstream inFile;
+    long long totalBytes;
+    IngestMode mode;
+
+    // INGEST_UNIQUE: content of the container drained into, built on the first drain and
+    // extended as sessions are added. Rebuilt if the container changed another way.
+    SessionSet seen;
+    const SessionContainer* seenFor = nullptr;
+    int seenSize = 0;
+    long long seenChanges = 0;
+
+    mutable mutex lock;
+    vector<PlaySession*> ready;     // parsed, not yet drained
+    string error;
+
+    atomic<long long> bytesRead{ 0 };
+    atomic<int> parsed{ 0 };
+    atomic<bool> finished{ false };
+    atomic<bool> stopRequested{ false };
+    thread worker;
+
+    void run() {
+        try {
+            JsonArrayReader reader(inFile);
+            json record;
+
+            while (!stopRequested && reader.next(record)) {
+                PlaySession* s = sessionFromJson(record);
+                {
+                    lock_guard<mutex> guard(lock);
+                    ready.push_back(s);
+                }
+                parsed++;
+                bytesRead = reader.bytesRead();
+            }
+            bytesRead = reader.bytesRead();
+        }
+        catch (const exception& e) {
+            lock_guard<mutex> guard(lock);
+            error = e.what();
+        }
+        finished = true;
+    }
+
+public:
+    // Throws runtime_error straight away if the file cannot be opened
+    explicit AsyncSessionLoad(const string& fileName, IngestMode ingest = INGEST_ALL)
+        : inFile(fileName, ios::binary), mode(ingest) {
+        if (!inFile) throw runtime_error("Could not open " + fileName);
+        totalBytes = static_cast<long long>(filesystem::file_size(fileName));
+        worker = thread(&AsyncSessionLoad::run, this);
+    }
+
+    AsyncSessionLoad(const AsyncSessionLoad&) = delete;
+    AsyncSessionLoad& operator=(const AsyncSessionLoad&) = delete;
+
+    // Stops the parse early and frees anything that was never drained
+    ~AsyncSessionLoad() {
+        stopRequested = true;
+        if (worker.joinable()) worker.join();
+        for (PlaySession* s : ready) delete s;
+    }
+
+    bool isDone() const { return finished; }
+
+    LoadProgress progress() const {
+        LoadProgress p;
+        p.done = finished;
+        p.bytesRead = bytesRead;
+        p.totalBytes = totalBytes;
+        p.sessionsParsed = parsed;
+
+        lock_guard<mutex> guard(lock);
+        p.error = error;
+        return p;
+    }
+
+    // Moves the sessions parsed so far into the container, in file order, up to limit of
+    // them; the rest wait for the next drain. With INGEST_UNIQUE, sessions whose content
+    // is already in the container are freed instead; the container is hashed once, not
+    // on every drain. Returns how many were added.
+    int drainInto(SessionContainer& manager, size_t limit = SIZE_MAX) {
+        vector<PlaySession*> batch;
+        {
+            lock_guard<mutex> guard(lock);
+            if (ready.size() <= limit) batch.swap(ready);
+            else {
+                batch.assign(ready.begin(), ready.begin() + limit);
+                ready.erase(ready.begin(), ready.begin() + limit);
+            }
+        }
+        if (batch.empty()) return 0;
+
+        if (mode == INGEST_UNIQUE && (seenFor != &manager || seenSize != manager.size() ||
+            seenChanges != manager.changeCount())) {
+            seen = sessionSetOf(manager);
+            seenFor = &manager;
+        }
+        int added = 0;
+        for (PlaySession* s : batch) {
+            if (mode == INGEST_UNIQUE && !seen.insert(*s)) {
+                delete s;
+                continue;
+            }
+            manager.add(s);
+            added++;
+        }
+        seenSize = manager.size();
+        seenChanges = manager.changeCount();
+        return added;
+    }
+
+    // Blocks until the parse ends. Throws runtime_error if it failed.
+    void wait() {
+        if (worker.joinable()) worker.join();
+
+        lock_guard<mutex> guard(lock);
+        if (!error.empty()) throw runtime_error(error);
+    }
+};
+
+
+// ================= BATCH RECOMMENDATIONS =================
+// Re-scores difficulty for many characters at once. The kernel is a branch-free form of
+// recommendDifficultyByStats that gives the same answer for every input, NaN included,
+// so the loop vectorizes and is split into tasks on the shared scheduler.
+
+// Same rules as recommendDifficultyByStats, written as arithmetic on the comparisons
+inline Difficulty recommendDifficultyBranchFree(int level, double hours) {
+    int ready = (level >= 4) & !(hours < 1.5);
+    int veteran = ready & (level >= 8);
+    return static_cast<Difficulty>(EXPLORER + ready + veteran);
+}
+
+const size_t BATCH_CHUNK = 1 << 16;
+
+// out[i] = recommendDifficultyByStats(levels[i], avgHours[i])
+void recommendDifficultyBatch(const int* levels, const double* avgHours, Difficulty* out, size_t n) {
+    sharedScheduler().parallelFor(WORK_AGGREGATION, n, BATCH_CHUNK, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            out[i] = recommendDifficultyBranchFree(levels[i], avgHours[i]);
+    });
+}
+
+// Uses average hours per session like menu case 4. A character with no sessions
+// counts as 0 hours and gets EXPLORER.
+void recommendDifficultyBatch(const int* levels, const int* totalMinutes, const int* sessionCounts,
+    Difficulty* out, size_t n) {
+    sharedScheduler().parallelFor(WORK_AGGREGATION, n, BATCH_CHUNK, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            double hours = sessionCounts[i] > 0 ? (totalMinutes[i] / 60.0) / sessionCounts[i] : 0.0;
+            out[i] = recommendDifficultyBranchFree(levels[i], hours);
+        }
+    });
+}
+
+// ================= ROSTER =================
+// Many characters, each with its own session store. Characters are spread over
+// shards by id so lookups lock one shard and whole-roster work runs shard by shard in parallel.
+
+struct RosterEntry {
+    int id;
+    Character character;
+    SessionContainer sessions;
+};
+
+// Aggregate numbers across the whole roster
+struct RosterTotals {
+    int characters = 0;
+    int sessions = 0;
+    long long minutes = 0;
+    double gold = 0;
+    double sessionValue = 0;
+};
+
+json characterToJson(int id, const Character& c) {
+    return json{ {"id", id}, {"name", c.name}, {"level", c.level},
+                 {"gold", c.gold}, {"difficulty", difficultyToString(c.difficulty)} };
+}
+
+Character characterFromJson(const json& j) {
+    Character c;
+    c.name = j.at("name").get<string>();
+    c.level = j.at("level").get<int>();
+    c.gold = j.at("gold").get<double>();
+    c.difficulty = difficultyFromString(j.value("difficulty", string("Balanced")));
+    return c;
+}
+
+class CharacterRoster {
+    struct Shard {
+        mutable mutex lock;
+        unordered_map<int, unique_ptr<RosterEntry>> entries;
+    };
+
+    int shardCount;
+    unique_ptr<Shard[]> shards;
+
+    Shard& shardFor(int id) const { return shards[static_cast<unsigned>(id) % shardCount]; }
+
+    // Runs fn(shardIndex) for every shard as tasks on the shared scheduler. Rethrows the
+    // first error once every shard is done.
+    template <typename Fn>
+    void forEachShardParallel(WorkSubsystem area, Fn fn) const {
+        sharedScheduler().parallelFor(area, static_cast<size_t>(shardCount), 1, [&](size_t first, size_t last) {
+            for (size_t s = first; s < last; s++) fn(static_cast<int>(s));
+        });
+    }
+
+    static string sessionFileName(const string& directory, int id) {
+        return (filesystem::path(directory) / ("character_" + to_string(id) + ".json")).string();
+    }
+
+public:
+    explicit CharacterRoster(int shards = 16)
+        : shardCount(max(1, shards)), shards(new Shard[max(1, shards)]) {}
+
+    void addCharacter(int id, const Character& c) {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+
+        auto& slot = shard.entries[id];
+        if (slot) throw ContainerException("Character id already in roster: " + to_string(id));
+
+        slot.reset(new RosterEntry{ id, c, {} });
+    }
+
+    bool removeCharacter(int id) {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        return shard.entries.erase(id) > 0;
+    }
+
+    bool contains(int id) const {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        return shard.entries.count(id) > 0;
+    }
+
+    int size() const {
+        int total = 0;
+        for (int s = 0; s < shardCount; s++) {
+            lock_guard<mutex> guard(shards[s].lock);
+            total += static_cast<int>(shards[s].entries.size());
+        }
+        return total;
+    }
+
+    // Runs fn(RosterEntry&) while holding the character's shard lock.
+    // Returns false if the id is not in the roster.
+    template <typename Fn>
+    bool withCharacter(int id, Fn fn) {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+
+        auto it = shard.entries.find(id);
+        if (it == shard.entries.end()) return false;
+
+        fn(*it->second);
+        return true;
+    }
+
+    RosterTotals totals() const {
+        vector<RosterTotals> perShard(shardCount);
+
+        forEachShardParallel(WORK_AGGREGATION, [&](int s) {
+            lock_guard<mutex> guard(shards[s].lock);
+            RosterTotals& t = perShard[s];
+
+            for (auto& kv : shards[s].entries) {
+                RosterEntry& e = *kv.second;
+                t.characters++;
+                t.gold += e.character.gold;
+
+                for (const PlaySession& s : e.sessions) {
+                    t.sessions++;
+                    t.minutes += s.getDuration();
+                    t.sessionValue += s.calculateValue();
+                }
+            }
+        });
+
+        RosterTotals all;
+        for (const RosterTotals& t : perShard) {
+            all.characters += t.characters;
+            all.sessions += t.sessions;
+            all.minutes += t.minutes;
+            all.gold += t.gold;
+            all.sessionValue += t.sessionValue;
+        }
+        return all;
+    }
+
+    // Re-scores every character that has sessions and stores the result in its
+    // Character::difficulty. Returns how many characters were scored.
+    int updateRecommendedDifficulties() {
+        vector<int> scoredPerShard(shardCount, 0);
+
+        // Each shard task scores its characters inline: recommendDifficultyBatch would wait
+        // on a TaskGroup while holding the shard lock, and the waiting thread may run
+        // another roster task that takes that same lock
+        forEachShardParallel(WORK_AGGREGATION, [&](int s) {
+            lock_guard<mutex> guard(shards[s].lock);
+
+            int scored = 0;
+            for (auto& kv : shards[s].entries) {
+                RosterEntry& e = *kv.second;
+                int total = 0, count = 0;
+                for (const PlaySession& s : e.sessions) {
+                    total += s.getDuration();
+                    count++;
+                }
+                if (count == 0) continue;
+
+                e.character.difficulty = recommendDifficultyBranchFree(e.character.level, (total / 60.0) / count);
+                scored++;
+            }
+            scoredPerShard[s] = scored;
+        });
+
+        int scored = 0;
+        for (int n : scoredPerShard) scored += n;
+        return scored;
+    }
+
+    // Writes roster.json plus one character_<id>.json session file per character
+    void saveAll(const string& directory) const {
+        filesystem::create_directories(directory);
+
+        json index = json::array();
+        for (int s = 0; s < shardCount; s++) {
+            lock_guard<mutex> guard(shards[s].lock);
+            for (auto& kv : shards[s].entries)
+                index.push_back(characterToJson(kv.first, kv.second->character));
+        }
+
+        ofstream outFile((filesystem::path(directory) / "roster.json").string());
+        if (!outFile) throw runtime_error("Could not write roster in " + directory);
+        outFile << index.dump(2) << "\n";
+        outFile.close();
+
+        forEachShardParallel(WORK_SAVING, [&](int s) {
+            lock_guard<mutex> guard(shards[s].lock);
+            for (auto& kv : shards[s].entries)
+                saveSessionsToJson(sessionFileName(directory, kv.first), kv.second->sessions);
+        });
+    }
+
+    // Reads a directory written by saveAll and returns the number of sessions loaded.
+    // Characters without a session file start with no sessions. All or nothing: the
+    // characters are loaded aside and added only once every file has been read, so a
+    // bad file leaves the roster as it was. The error names the file.
+    int loadAll(const string& directory) {
+        ifstream inFile((filesystem::path(directory) / "roster.json").string());
+        if (!inFile) throw runtime_error("Could not open roster in " + directory);
+
+        vector<unique_ptr<RosterEntry>> pending;
+        try {
+            json index = json::parse(inFile);
+            for (const json& j : index)
+                pending.emplace_back(new RosterEntry{ j.at("id").get<int>(), characterFromJson(j), {} });
+        }
+        catch (const json::exception& e) {
+            throw runtime_error("Bad roster file in " + directory + ": " + e.what());
+        }
+
+        vector<int> ids;
+        for (auto& e : pending) ids.push_back(e->id);
+        sort(ids.begin(), ids.end());
+        auto repeated = adjacent_find(ids.begin(), ids.end());
+        if (repeated != ids.end()) throw ContainerException("Character id already in roster: " + to_string(*repeated));
+
+        vector<int> loadedPerEntry(pending.size(), 0);
+        sharedScheduler().parallelFor(WORK_LOADING, pending.size(), 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                string fileName = sessionFileName(directory, pending[i]->id);
+                if (!filesystem::exists(fileName)) continue;
+                try {
+                    loadedPerEntry[i] = loadSessionsFromJson(fileName, pending[i]->sessions);
+                }
+                catch (const exception& e) {
+                    throw runtime_error("Could not load " + fileName + ": " + e.what());
+                }
+            }
+        });
+
+        // Every shard is locked, in order, so the characters appear together or not at all
+        vector<unique_lock<mutex>> guards;
+        for (int s = 0; s < shardCount; s++) guards.emplace_back(shards[s].lock);
+        for (auto& e : pending) {
+            if (shardFor(e->id).entries.count(e->id) > 0)
+                throw ContainerException("Character id already in roster: " + to_string(e->id));
+        }
+        for (auto& e : pending) {
+            int id = e->id;
+            shardFor(id).entries[id] = move(e);
+        }
+
+        int loaded = 0;
+        for (int n : loadedPerEntry) loaded += n;
+        return loaded;
+    }
+};
+
+
+// ================= COMPACT SESSIONS =================
+// A packed 12-byte session record for holding very large histories in memory.
+//
+// Budget: 12 bytes per session, plus one copy of each distinct location in the
+// LocationPool. For comparison a CombatSession behind a list Node costs about
+// 80 bytes on x64 before allocator overhead (vtable pointer, std::string, padded
+// LootInfo, 16-byte Node) and a second heap block for locations over 15 chars.
+
+// Interns location strings so each distinct name is stored once
+class LocationPool {
+    vector<string> names;
+    unordered_map<string, uint32_t> ids;
+
+public:
+    uint32_t intern(const string& loc) {
+        auto it = ids.find(loc);
+        if (it != ids.end()) return it->second;
+
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.push_back(loc);
+        ids.emplace(loc, id);
+        return id;
+    }
+
+    // Returns -1 if the location was never interned
+    long long find(const string& loc) const {
+        auto it = ids.find(loc);
+        return it == ids.end() ? -1 : static_cast<long long>(it->second);
+    }
+
+    const string& name(uint32_t id) const { return names.at(id); }
+    size_t size() const { return names.size(); }
+
+    size_t memoryBytes() const {
+        size_t bytes = names.capacity() * sizeof(string);
+        bytes += ids.bucket_count() * sizeof(void*);
+        bytes += ids.size() * (sizeof(string) + sizeof(uint32_t) + 2 * sizeof(void*));
+
+        // Characters are held twice: once in names and once as the map key
+        for (const string& n : names) bytes += 2 * (n.capacity() + 1);
+        return bytes;
+    }
+};
+
+struct CompactSession {
+    // header: bits 0-23 location id, 24-25 session type, 26-27 difficulty
+    uint32_t header;
+    // loot: bits 0-30 gold earned, bit 31 rare item found
+    uint32_t loot;
+    uint16_t durationMinutes;
+    uint16_t count;
+
+    static const uint32_t MAX_LOCATION_ID = (1u << 24) - 1;
+    static const uint32_t MAX_GOLD = (1u << 31) - 1;
+
+    uint32_t getLocationId() const { return header & MAX_LOCATION_ID; }
+    SessionType getType() const { return static_cast<SessionType>((header >> 24) & 3u); }
+    Difficulty getDifficulty() const { return static_cast<Difficulty>((header >> 26) & 3u); }
+    int getDuration() const { return durationMinutes; }
+    int getCount() const { return count; }
+    int getGoldEarned() const { return static_cast<int>(loot & MAX_GOLD); }
+    bool isRareItemFound() const { return (loot >> 31) != 0; }
+
+    double calculateValue() const {
+        return count * RegisteredSessions::valuePerCount(getType());
+    }
+
+    // Throws ContainerException if a field does not fit its packed width
+    static CompactSession pack(uint32_t locationId, SessionType type, Difficulty diff,
+        int duration, int count, const LootInfo& loot) {
+        if (locationId > MAX_LOCATION_ID)
+            throw ContainerException("Too many distinct locations for compact sessions");
+        if (duration < 0 || duration > 0xFFFF)
+            throw ContainerException("Duration does not fit a compact session");
+        if (count < 0 || count > 0xFFFF)
+            throw ContainerException("Count does not fit a compact session");
+        if (loot.getGoldEarned() < 0)
+            throw ContainerException("Gold does not fit a compact session");
+
+        CompactSession c;
+        c.header = locationId | (static_cast<uint32_t>(type) << 24) | (static_cast<uint32_t>(diff) << 26);
+        c.loot = static_cast<uint32_t>(loot.getGoldEarned()) | (loot.isRareItemFound() ? 1u << 31 : 0u);
+        c.durationMinutes = static_cast<uint16_t>(duration);
+        c.count = static_cast<uint16_t>(count);
+        return c;
+    }
+};
+
+static_assert(sizeof(CompactSession) == 12, "CompactSession must stay within its 12-byte budget");
+
+class CompactSessionStore {
+    vector<CompactSession> records;
+    LocationPool locations;
+
+public:
+    void reserve(size_t n) { records.reserve(n); }
+
+    void add(const PlaySession& s) {
+        add(s.getLocation(), sessionTypeOf(s), s.getDifficulty(), s.getDuration(), sessionCount(s), sessionLoot(s));
+    }
+
+    // Packs with the id the location would get before interning it, so a record that
+    // does not fit leaves the pool unchanged
+    void add(const string& loc, SessionType type, Difficulty diff, int dur, int count, const LootInfo& loot) {
+        long long known = locations.find(loc);
+        uint32_t id = static_cast<uint32_t>(known >= 0 ? static_cast<size_t>(known) : locations.size());
+        CompactSession c = CompactSession::pack(id, type, diff, dur, count, loot);
+        locations.intern(loc);
+        records.push_back(c);
+    }
+
+    void addAll(SessionContainer& manager) {
+        for (const PlaySession& s : manager)
+            add(s);
+    }
+
+    size_t size() const { return records.size(); }
+    const CompactSession& at(size_t i) const { return records.at(i); }
+    const string& locationOf(size_t i) const { return locations.name(records.at(i).getLocationId()); }
+    const LocationPool& getLocations() const { return locations; }
+
+    // Rebuilds a full session object. Caller owns the result.
+    PlaySession* expand(size_t i) const {
+        const CompactSession& c = records.at(i);
+        return makeSession(c.getType(), locations.name(c.getLocationId()), c.getDuration(),
+            c.getDifficulty(), c.getCount(), LootInfo(c.getGoldEarned(), c.isRareItemFound()));
+    }
+
+    size_t memoryBytes() const {
+        return records.capacity() * sizeof(CompactSession) + locations.memoryBytes();
+    }
+};
+
+// Heap bytes one linked-list session costs today: the node, the session object and
+// the location's heap buffer when it is too long for the small-string buffer.
+size_t legacySessionBytes(const PlaySession& s) {
+    size_t bytes = sizeof(SessionLinkedList::Node);
+    bytes += RegisteredSessions::objectSize(s.getType());
+    return bytes + stringHeapBytes(s.getLocation());
+}
+
+
+// ================= SESSION COLUMNS =================
+// Sessions split into one contiguous array per field, so aggregates become tight loops
+// over plain integers instead of virtual calls on linked nodes.
+
+struct SessionColumns {
+    vector<uint8_t> type;           // SessionType
+    vector<uint8_t> difficulty;     // Difficulty
+    vector<uint8_t> rare;           // 1 if a rare item was found
+    vector<int32_t> duration;
+    vector<int32_t> count;          // enemies defeated or areas discovered
+    vector<int32_t> gold;
+    vector<uint32_t> locationId;    // index into locations
+    LocationPool locations;
+
+    size_t size() const { return duration.size(); }
+
+    void reserve(size_t n) {
+        type.reserve(n); difficulty.reserve(n); rare.reserve(n);
+        duration.reserve(n); count.reserve(n); gold.reserve(n); locationId.reserve(n);
+    }
+
+    // Empties the columns but keeps their capacity and the location pool
+    void clear() {
+        type.clear(); difficulty.clear(); rare.clear();
+        duration.clear(); count.clear(); gold.clear(); locationId.clear();
+    }
+
+    void add(SessionType t, const string& loc, int dur, Difficulty diff, int cnt, const LootInfo& loot) {
+        type.push_back(static_cast<uint8_t>(t));
+        difficulty.push_back(static_cast<uint8_t>(diff));
+        rare.push_back(loot.isRareItemFound() ? 1 : 0);
+        duration.push_back(dur);
+        count.push_back(cnt);
+        gold.push_back(loot.getGoldEarned());
+        locationId.push_back(locations.intern(loc));
+    }
+
+    void add(const PlaySession& s) {
+        add(sessionTypeOf(s), s.getLocation(), s.getDuration(), s.getDifficulty(), sessionCount(s), sessionLoot(s));
+    }
+
+    // Appends every row of other, re-interning its locations into this pool
+    void append(const SessionColumns& other) {
+        vector<uint32_t> remap(other.locations.size());
+        for (uint32_t id = 0; id < other.locations.size(); id++) remap[id] = locations.intern(other.locations.name(id));
+
+        type.insert(type.end(), other.type.begin(), other.type.end());
+        difficulty.insert(difficulty.end(), other.difficulty.begin(), other.difficulty.end());
+        rare.insert(rare.end(), other.rare.begin(), other.rare.end());
+        duration.insert(duration.end(), other.duration.begin(), other.duration.end());
+        count.insert(count.end(), other.count.begin(), other.count.end());
+        gold.insert(gold.end(), other.gold.begin(), other.gold.end());
+        for (uint32_t id : other.locationId) locationId.push_back(remap[id]);
+    }
+
+    static SessionColumns from(SessionContainer& manager) {
+        SessionColumns c;
+        for (const PlaySession& s : manager) c.add(s);
+        return c;
+    }
+
+    static SessionColumns from(const CompactSessionStore& store) {
+        SessionColumns c;
+        c.reserve(store.size());
+        for (size_t i = 0; i < store.size(); i++) {
+            const CompactSession& s = store.at(i);
+            c.add(s.getType(), store.locationOf(i), s.getDuration(), s.getDifficulty(), s.getCount(),
+                LootInfo(s.getGoldEarned(), s.isRareItemFound()));
+        }
+        return c;
+    }
+};
+
+// ================= COLUMN KERNELS =================
+// Scalar, SSE2 and AVX2 versions of each aggregate. activeSessionKernels() picks the
+// widest set the CPU supports the first time it is called. All three give identical
+// results: sums are exact 64-bit integers and the weighted value sums counts per
+// session type and applies each registered type's VALUE_PER_COUNT, the same rule
+// calculateValue() uses.
+
+// GCC and Clang need AVX2 code marked per function; MSVC accepts the intrinsics anywhere
+#if defined(__GNUC__)
+#define TRACKER_AVX2 __attribute__((target("avx2")))
+#else
+#define TRACKER_AVX2
+#endif
+
+struct SessionKernels {
+    const char* name;
+    long long (*sumInt32)(const int32_t* values, size_t n);
+    // Leaves lo = INT32_MAX and hi = INT32_MIN when n is 0
+    void (*minMaxInt32)(const int32_t* values, size_t n, int32_t& lo, int32_t& hi);
+    size_t (*countEqualU8)(const uint8_t* values, size_t n, uint8_t target);
+    size_t (*countGreaterInt32)(const int32_t* values, size_t n, int32_t threshold);
+    double (*weightedValue)(const int32_t* counts, const uint8_t* types, size_t n);
+};
+
+long long scalarSumInt32(const int32_t* v, size_t n) {
+    long long s = 0;
+    for (size_t i = 0; i < n; i++) s += v[i];
+    return s;
+}
+
+void scalarMinMaxInt32(const int32_t* v, size_t n, int32_t& lo, int32_t& hi) {
+    lo = numeric_limits<int32_t>::max();
+    hi = numeric_limits<int32_t>::min();
+    for (size_t i = 0; i < n; i++) {
+        lo = min(lo, v[i]);
+        hi = max(hi, v[i]);
+    }
+}
+
+size_t scalarCountEqualU8(const uint8_t* v, size_t n, uint8_t target) {
+    size_t c = 0;
+    for (size_t i = 0; i < n; i++) c += v[i] == target;
+    return c;
+}
+
+size_t scalarCountGreaterInt32(const int32_t* v, size_t n, int32_t threshold) {
+    size_t c = 0;
+    for (size_t i = 0; i < n; i++) c += v[i] > threshold;
+    return c;
+}
+
+const size_t SESSION_TYPE_COUNT = RegisteredSessions::COUNT;
+
+// Applies each type's VALUE_PER_COUNT to its summed counts
+double typeWeightedTotal(const long long* sums) {
+    double total = 0;
+    for (size_t t = 0; t < SESSION_TYPE_COUNT; t++)
+        total += sums[t] * RegisteredSessions::valuePerCount(static_cast<SessionType>(t));
+    return total;
+}
+
+double scalarWeightedValue(const int32_t* counts, const uint8_t* types, size_t n) {
+    long long sums[SESSION_TYPE_COUNT] = {};
+    for (size_t i = 0; i < n; i++)
+        if (types[i] < SESSION_TYPE_COUNT) sums[types[i]] += counts[i];
+    return typeWeightedTotal(sums);
+}
+
+const SessionKernels& scalarSessionKernels() {
+    static const SessionKernels k = { "scalar", scalarSumInt32, scalarMinMaxInt32,
+        scalarCountEqualU8, scalarCountGreaterInt32, scalarWeightedValue };
+    return k;
+}
+
+#ifdef TRACKER_X86_SIMD
+
+// ---- SSE2 ----
+
+// Adds four signed 32-bit lanes into two 64-bit accumulator lanes
+inline __m128i sse2AddWidened(__m128i acc, __m128i x) {
+    __m128i sign = _mm_srai_epi32(x, 31);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(x, sign));
+    return _mm_add_epi64(acc, _mm_unpackhi_epi32(x, sign));
+}
+
+inline long long sse2HorizontalSum64(__m128i acc) {
+    long long lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    return lanes[0] + lanes[1];
+}
+
+long long sse2SumInt32(const int32_t* v, size_t n) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        acc = sse2AddWidened(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+
+    long long s = sse2HorizontalSum64(acc);
+    for (; i < n; i++) s += v[i];
+    return s;
+}
+
+void sse2MinMaxInt32(const int32_t* v, size_t n, int32_t& lo, int32_t& hi) {
+    // SSE2 has no 32-bit min/max, so select with compare masks
+    __m128i vlo = _mm_set1_epi32(numeric_limits<int32_t>::max());
+    __m128i vhi = _mm_set1_epi32(numeric_limits<int32_t>::min());
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        __m128i lt = _mm_cmplt_epi32(x, vlo);
+        __m128i gt = _mm_cmpgt_epi32(x, vhi);
+        vlo = _mm_or_si128(_mm_and_si128(lt, x), _mm_andnot_si128(lt, vlo));
+        vhi = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, vhi));
+    }
+
+    int32_t los[4], his[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(los), vlo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(his), vhi);
+    lo = min(min(los[0], los[1]), min(los[2], los[3]));
+    hi = max(max(his[0], his[1]), max(his[2], his[3]));
+    for (; i < n; i++) {
+        lo = min(lo, v[i]);
+        hi = max(hi, v[i]);
+    }
+}
+
+size_t sse2CountEqualU8(const uint8_t* v, size_t n, uint8_t target) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i t = _mm_set1_epi8(static_cast<char>(target));
+    size_t total = 0;
+    size_t i = 0;
+    size_t fullEnd = n - n % 16;
+
+    while (i < fullEnd) {
+        // Byte counters overflow after 255 steps, so fold them into the total per block
+        __m128i counts = zero;
+        size_t blockEnd = min(fullEnd, i + 255 * 16);
+        for (; i < blockEnd; i += 16)
+            counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)), t));
+
+        __m128i sums = _mm_sad_epu8(counts, zero);
+        total += static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+    }
+    for (; i < n; i++) total += v[i] == target;
+    return total;
+}
+
+size_t sse2CountGreaterInt32(const int32_t* v, size_t n, int32_t threshold) {
+    const __m128i th = _mm_set1_epi32(threshold);
+    size_t total = 0;
+    size_t i = 0;
+    size_t fullEnd = n - n % 4;
+
+    while (i < fullEnd) {
+        __m128i counts = _mm_setzero_si128();
+        size_t blockEnd = min(fullEnd, i + (size_t(1) << 24));
+        for (; i < blockEnd; i += 4)
+            counts = _mm_sub_epi32(counts, _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)), th));
+
+        int32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), counts);
+        total += static_cast<size_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    for (; i < n; i++) total += v[i] > threshold;
+    return total;
+}
+
+double sse2WeightedValue(const int32_t* counts, const uint8_t* types, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc[SESSION_TYPE_COUNT];
+    for (size_t t = 0; t < SESSION_TYPE_COUNT; t++) acc[t] = zero;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        int32_t packedTypes;
+        memcpy(&packedTypes, types + i, 4);
+        __m128i ids = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedTypes), zero), zero);
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i));
+
+        for (size_t t = 0; t < SESSION_TYPE_COUNT; t++) {
+            __m128i match = _mm_cmpeq_epi32(ids, _mm_set1_epi32(static_cast<int>(t)));
+            acc[t] = sse2AddWidened(acc[t], _mm_and_si128(match, x));
+        }
+    }
+
+    long long sums[SESSION_TYPE_COUNT];
+    for (size_t t = 0; t < SESSION_TYPE_COUNT; t++) sums[t] = sse2HorizontalSum64(acc[t]);
+    for (; i < n; i++)
+        if (types[i] < SESSION_TYPE_COUNT) sums[types[i]] += counts[i];
+    return typeWeightedTotal(sums);
+}
+
+// ---- AVX2 ----
+
+TRACKER_AVX2 inline __m256i avx2AddWidened(__m256i acc, __m256i x) {
+    acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+    return _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+}
+
+TRACKER_AVX2 inline long long avx2HorizontalSum64(__m256i acc) {
+    long long lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+TRACKER_AVX2 long long avx2SumInt32(const int32_t* v, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        acc = avx2AddWidened(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+
+    long long s = avx2HorizontalSum64(acc);
+    for (; i < n; i++) s += v[i];
+    return s;
+}
+
+TRACKER_AVX2 void avx2MinMaxInt32(const int32_t* v, size_t n, int32_t& lo, int32_t& hi) {
+    __m256i vlo = _mm256_set1_epi32(numeric_limits<int32_t>::max());
+    __m256i vhi = _mm256_set1_epi32(numeric_limits<int32_t>::min());
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        vlo = _mm256_min_epi32(vlo, x);
+        vhi = _mm256_max_epi32(vhi, x);
+    }
+
+    int32_t los[8], his[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(los), vlo);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(his), vhi);
+    lo = *min_element(los, los + 8);
+    hi = *max_element(his, his + 8);
+    for (; i < n; i++) {
+        lo = min(lo, v[i]);
+        hi = max(hi, v[i]);
+    }
+}
+
+TRACKER_AVX2 size_t avx2CountEqualU8(const uint8_t* v, size_t n, uint8_t target) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i t = _mm256_set1_epi8(static_cast<char>(target));
+    size_t total = 0;
+    size_t i = 0;
+    size_t fullEnd = n - n % 32;
+
+    while (i < fullEnd) {
+        __m256i counts = zero;
+        size_t blockEnd = min(fullEnd, i + 255 * 32);
+        for (; i < blockEnd; i += 32)
+            counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)), t));
+
+        total += static_cast<size_t>(avx2HorizontalSum64(_mm256_sad_epu8(counts, zero)));
+    }
+    for (; i < n; i++) total += v[i] == target;
+    return total;
+}
+
+TRACKER_AVX2 size_t avx2CountGreaterInt32(const int32_t* v, size_t n, int32_t threshold) {
+    const __m256i th = _mm256_set1_epi32(threshold);
+    size_t total = 0;
+    size_t i = 0;
+    size_t fullEnd = n - n % 8;
+
+    while (i < fullEnd) {
+        __m256i counts = _mm256_setzero_si256();
+        size_t blockEnd = min(fullEnd, i + (size_t(1) << 24));
+        for (; i < blockEnd; i += 8)
+            counts = _mm256_sub_epi32(counts, _mm256_cmpgt_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)), th));
+
+        total += static_cast<size_t>(avx2HorizontalSum64(avx2AddWidened(_mm256_setzero_si256(), counts)));
+    }
+    for (; i < n; i++) total += v[i] > threshold;
+    return total;
+}
+
+TRACKER_AVX2 double avx2WeightedValue(const int32_t* counts, const uint8_t* types, size_t n) {
+    __m256i acc[SESSION_TYPE_COUNT];
+    for (size_t t = 0; t < SESSION_TYPE_COUNT; t++) acc[t] = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i ids = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(types + i)));
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counts + i));
+
+        for (size_t t = 0; t < SESSION_TYPE_COUNT; t++) {
+            __m256i match = _mm256_cmpeq_epi32(ids, _mm256_set1_epi32(static_cast<int>(t)));
+            acc[t] = avx2AddWidened(acc[t], _mm256_and_si256(match, x));
+        }
+    }
+
+    long long sums[SESSION_TYPE_COUNT];
+    for (size_t t = 0; t < SESSION_TYPE_COUNT; t++) sums[t] = avx2HorizontalSum64(acc[t]);
+    for (; i < n; i++)
+        if (types[i] < SESSION_TYPE_COUNT) sums[types[i]] += counts[i];
+    return typeWeightedTotal(sums);
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    // AVX2 also needs the OS to save the YMM registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+// nullptr when the build or the CPU has no SSE2
+const SessionKernels* sse2SessionKernels() {
+#ifdef TRACKER_X86_SIMD
+    static const SessionKernels k = { "sse2", sse2SumInt32, sse2MinMaxInt32,
+        sse2CountEqualU8, sse2CountGreaterInt32, sse2WeightedValue };
+    return &k;
+#else
+    return nullptr;
+#endif
+}
+
+// nullptr when the build or the CPU has no AVX2
+const SessionKernels* avx2SessionKernels() {
+#ifdef TRACKER_X86_SIMD
+    static const SessionKernels k = { "avx2", avx2SumInt32, avx2MinMaxInt32,
+        avx2CountEqualU8, avx2CountGreaterInt32, avx2WeightedValue };
+    static const bool supported = cpuHasAvx2();
+    return supported ? &k : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+const SessionKernels& activeSessionKernels() {
+    static const SessionKernels& k = avx2SessionKernels() ? *avx2SessionKernels()
+        : sse2SessionKernels() ? *sse2SessionKernels() : scalarSessionKernels();
+    return k;
+}
+
+struct ColumnTotals {
+    size_t sessions = 0;
+    long long minutes = 0;
+    long long gold = 0;
+    int32_t shortest = 0;
+    int32_t longest = 0;
+    size_t rareItems = 0;
+    size_t combatSessions = 0;
+    size_t longSessions = 0;    // over LONG_SESSION_MINUTES
+    double value = 0;
+
+    // Folds in totals over another batch of sessions
+    void merge(const ColumnTotals& o) {
+        if (o.sessions == 0) return;
+        shortest = sessions == 0 ? o.shortest : min(shortest, o.shortest);
+        longest = sessions == 0 ? o.longest : max(longest, o.longest);
+        sessions += o.sessions;
+        minutes += o.minutes;
+        gold += o.gold;
+        rareItems += o.rareItems;
+        combatSessions += o.combatSessions;
+        longSessions += o.longSessions;
+        value += o.value;
+    }
+};
+
+const int LONG_SESSION_MINUTES = 60;
+
+// Totals over rows [begin, end)
+ColumnTotals aggregateColumnRange(const SessionColumns& c, size_t begin, size_t end, const SessionKernels& k) {
+    ColumnTotals t;
+    size_t n = end - begin;
+    t.sessions = n;
+    if (n == 0) return t;
+
+    const int32_t* duration = c.duration.data() + begin;
+    t.minutes = k.sumInt32(duration, n);
+    t.gold = k.sumInt32(c.gold.data() + begin, n);
+    k.minMaxInt32(duration, n, t.shortest, t.longest);
+    t.rareItems = k.countEqualU8(c.rare.data() + begin, n, 1);
+    t.combatSessions = k.countEqualU8(c.type.data() + begin, n, COMBAT_SESSION);
+    t.longSessions = k.countGreaterInt32(duration, n, LONG_SESSION_MINUTES);
+    t.value = k.weightedValue(c.count.data() + begin, c.type.data() + begin, n);
+    return t;
+}
+
+const size_t AGGREGATE_GRAIN = 1 << 16;
+
+// Splits the rows into AGGREGATE_GRAIN pieces on the shared scheduler and merges the
+// piece totals in row order
+ColumnTotals aggregateColumns(const SessionColumns& c, const SessionKernels& k = activeSessionKernels()) {
+    return sharedScheduler().parallelReduce(WORK_AGGREGATION, c.size(), AGGREGATE_GRAIN, ColumnTotals(),
+        [&](size_t begin, size_t end) { return aggregateColumnRange(c, begin, end, k); },
+        [](ColumnTotals a, const ColumnTotals& b) { a.merge(b); return a; });
+}
+
+// ================= SNAPSHOT CONTAINER =================
+// Readers grab an immutable snapshot in O(1) and iterate it while one writer at a time
+// keeps appending and removing. Sessions are held by shared_ptr, so a removed session
+// is freed only once the last snapshot that can still see it is released (RCU-style
+// reclamation: no reader ever waits and no writer ever frees under a reader).
+//
+// Sessions live in fixed-size segments shared between versions. Appends fill the tail
+// segment in place; a slot is written once before the count that exposes it is
+// published, and older snapshots never read past their own count. Removing copies
+// only the segments from the removed index onward into a new version.
+
+class SnapshotSessionContainer {
+    static const size_t SEGMENT_SIZE = 256;
+
+    using SessionPtr = shared_ptr<const PlaySession>;
+    using Segment = vector<SessionPtr>;
+
+    struct Version {
+        vector<shared_ptr<Segment>> segments;
+        atomic<size_t> count{ 0 };
+    };
+
+    shared_ptr<Version> current;    // only touched through atomic_load / atomic_store
+    mutex writeLock;
+
+    static shared_ptr<Segment> newSegment() { return make_shared<Segment>(SEGMENT_SIZE); }
+
+public:
+    class Snapshot {
+        shared_ptr<const Version> version;
+        size_t count;
+
+    public:
+        Snapshot(shared_ptr<const Version> v, size_t n) : version(move(v)), count(n) {}
+
+        size_t size() const { return count; }
+
+        const PlaySession& at(size_t index) const {
+            if (index >= count) throw ContainerException("Index out of bounds");
+            return *(*version->segments[index / SEGMENT_SIZE])[index % SEGMENT_SIZE];
+        }
+
+        // Keeps a single session alive beyond the snapshot
+        SessionPtr share(size_t index) const {
+            if (index >= count) throw ContainerException("Index out of bounds");
+            return (*version->segments[index / SEGMENT_SIZE])[index % SEGMENT_SIZE];
+        }
+
+        // Calls fn(const PlaySession&) for every session in order
+        template <typename Fn>
+        void forEach(Fn fn) const {
+            for (size_t i = 0; i < count; i++)
+                fn(*(*version->segments[i / SEGMENT_SIZE])[i % SEGMENT_SIZE]);
+        }
+
+        int linearSearch(const string& loc) const {
+            for (size_t i = 0; i < count; i++)
+                if (at(i).getLocation() == loc) return static_cast<int>(i);
+            return -1;
+        }
+    };
+
+    SnapshotSessionContainer() : current(make_shared<Version>()) {}
+    SnapshotSessionContainer(const SnapshotSessionContainer&) = delete;
+    SnapshotSessionContainer& operator=(const SnapshotSessionContainer&) = delete;
+
+    Snapshot snapshot() const {
+        shared_ptr<const Version> v = atomic_load(&current);
+        size_t n = v->count.load(memory_order_acquire);
+        return Snapshot(move(v), n);
+    }
+
+    size_t size() const { return snapshot().size(); }
+
+    // Takes ownership of the session
+    void add(PlaySession* s) {
+        SessionPtr session(s);
+        lock_guard<mutex> guard(writeLock);
+
+        shared_ptr<Version> v = atomic_load(&current);
+        size_t n = v->count.load(memory_order_relaxed);
+
+        if (n == v->segments.size() * SEGMENT_SIZE) {
+            // Only the segment directory is copied; the segments themselves are shared
+            auto grown = make_shared<Version>();
+            grown->segments = v->segments;
+            grown->segments.push_back(newSegment());
+            grown->count.store(n, memory_order_relaxed);
+            atomic_store(&current, grown);
+            v = grown;
+        }
+
+        (*v->segments[n / SEGMENT_SIZE])[n % SEGMENT_SIZE] = move(session);
+        v->count.store(n + 1, memory_order_release);
+    }
+
+    void remove(size_t index) {
+        lock_guard<mutex> guard(writeLock);
+
+        shared_ptr<Version> v = atomic_load(&current);
+        size_t n = v->count.load(memory_order_relaxed);
+        if (index >= n) throw ContainerException("Invalid index");
+
+        auto next = make_shared<Version>();
+        size_t firstCopied = index / SEGMENT_SIZE;
+        next->segments.assign(v->segments.begin(), v->segments.begin() + firstCopied);
+
+        size_t out = firstCopied * SEGMENT_SIZE;
+        for (size_t i = out; i < n; i++) {
+            if (i == index) continue;
+            if (out % SEGMENT_SIZE == 0) next->segments.push_back(newSegment());
+            (*next->segments.back())[out % SEGMENT_SIZE] = (*v->segments[i / SEGMENT_SIZE])[i % SEGMENT_SIZE];
+            out++;
+        }
+
+        next->count.store(n - 1, memory_order_relaxed);
+        atomic_store(&current, next);
+    }
+};
+
+
+// ================= CONCURRENT CONTAINER =================
+// Sessions are spread over lock stripes. Each thread appends to the stripe picked by its
+// thread id, so writers on different threads rarely share a lock. Searches and
+// aggregates lock one stripe at a time, so they run alongside writers instead of
+// stopping them. Order across stripes is not kept; use SessionContainer when it matters.
+
+class ConcurrentSessionContainer {
+    struct alignas(64) Stripe {     // one cache line apart so stripes do not false-share
+        mutable mutex lock;
+        vector<PlaySession*> sessions;
+    };
+
+    int stripeCount;
+    unique_ptr<Stripe[]> stripes;
+
+    Stripe& stripeForThisThread() {
+        size_t h = hash<thread::id>()(this_thread::get_id());
+        return stripes[h % stripeCount];
+    }
+
+public:
+    // 0 picks four stripes per hardware thread
+    explicit ConcurrentSessionContainer(int stripeTotal = 0)
+        : stripeCount(stripeTotal > 0 ? stripeTotal : max(1, 4 * static_cast<int>(thread::hardware_concurrency()))),
+          stripes(new Stripe[stripeCount]) {}
+
+    ConcurrentSessionContainer(const ConcurrentSessionContainer&) = delete;
+    ConcurrentSessionContainer& operator=(const ConcurrentSessionContainer&) = delete;
+
+    ~ConcurrentSessionContainer() {
+        for (int i = 0; i < stripeCount; i++)
+            for (PlaySession* s : stripes[i].sessions) delete s;
+    }
+
+    // Takes ownership of the session
+    void add(PlaySession* s) {
+        Stripe& stripe = stripeForThisThread();
+        lock_guard<mutex> guard(stripe.lock);
+        stripe.sessions.push_back(s);
+    }
+
+    int size() const {
+        size_t total = 0;
+        for (int i = 0; i < stripeCount; i++) {
+            lock_guard<mutex> guard(stripes[i].lock);
+            total += stripes[i].sessions.size();
+        }
+        return static_cast<int>(total);
+    }
+
+    // Calls fn(const PlaySession&) for every session, holding one stripe lock at a time
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (int i = 0; i < stripeCount; i++) {
+            lock_guard<mutex> guard(stripes[i].lock);
+            for (const PlaySession* s : stripes[i].sessions) fn(*s);
+        }
+    }
+
+    int countLocation(const string& loc) const {
+        int found = 0;
+        forEach([&](const PlaySession& s) { if (s.getLocation() == loc) found++; });
+        return found;
+    }
+
+    bool contains(const string& loc) const {
+        for (int i = 0; i < stripeCount; i++) {
+            lock_guard<mutex> guard(stripes[i].lock);
+            for (const PlaySession* s : stripes[i].sessions)
+                if (s->getLocation() == loc) return true;
+        }
+        return false;
+    }
+
+    long long totalMinutes() const {
+        long long total = 0;
+        forEach([&](const PlaySession& s) { total += s.getDuration(); });
+        return total;
+    }
+
+    double totalValue() const {
+        double total = 0;
+        forEach([&](const PlaySession& s) { total += s.calculateValue(); });
+        return total;
+    }
+};
+
+
+// ================= SESSION ARCHIVE =================
+// Compressed columnar file (.bgsa) for old sessions that are only read back in bulk.
+// Sessions are cut into blocks so a reader decodes one block at a time and never holds
+// more than ARCHIVE_BLOCK_SESSIONS rows, whatever the archive size.
+//
+//   header      "BGSA", u16 version, u16 reserved, u64 session count,
+//               u32 block count, then the location dictionary: varint entry count
+//               followed by varint length + bytes per distinct location
+//   each block  u32 session count, u32 payload size, u32 checksum of the payload
+//   payload     durations   zigzag varint delta from the previous row (first from 0)
+//               counts      zigzag varint
+//               gold        zigzag varint
+//               locations   varint dictionary index
+//               flags       ARCHIVE_FLAG_BITS per row, packed LSB first:
+//                           type id, then 2 bits difficulty, then 1 bit rare
+//
+// Fixed-size integers are little-endian. Varints are 7 bits per byte, low group first.
+
+const uint16_t ARCHIVE_VERSION = 1;
+const size_t ARCHIVE_BLOCK_SESSIONS = 4096;
+const size_t ARCHIVE_BLOCK_HEADER_SIZE = 12;
+
+constexpr unsigned archiveTypeBits(size_t types) {
+    return types <= 2 ? 1 : 1 + archiveTypeBits((types + 1) / 2);
+}
+
+const unsigned ARCHIVE_TYPE_BITS = archiveTypeBits(RegisteredSessions::COUNT);
+const unsigned ARCHIVE_FLAG_BITS = ARCHIVE_TYPE_BITS + 3;
+
+inline uint32_t zigzagEncode(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(-static_cast<int32_t>(static_cast<uint32_t>(v) >> 31));
+}
+
+inline int32_t zigzagDecode(uint32_t v) {
+    return static_cast<int32_t>((v >> 1) ^ (0u - (v & 1u)));
+}
+
+inline void putVarint(string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+// Advances p past one varint. Throws runtime_error if it runs past end or over 32 bits.
+inline uint32_t getVarint(const char*& p, const char* end) {
+    uint32_t v = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        if (p == end) throw runtime_error("Session archive block is truncated");
+        unsigned char b = static_cast<unsigned char>(*p++);
+        v |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (b < 0x80) return v;
+    }
+    throw runtime_error("Session archive varint is too long");
+}
+
+// Encodes the columns as an archive. Location ids index c.locations. Smaller blocks
+// trade a little size for less work per streamed step.
+void writeSessionArchive(ostream& out, const SessionColumns& c, size_t blockSessions = ARCHIVE_BLOCK_SESSIONS) {
+    blockSessions = min(max<size_t>(blockSessions, 1), ARCHIVE_BLOCK_SESSIONS);
+    size_t n = c.size();
+    size_t blocks = (n + blockSessions - 1) / blockSessions;
+
+    string head(20, '\0');
+    memcpy(&head[0], "BGSA", 4);
+    storeLE16(&head[4], ARCHIVE_VERSION);
+    storeLE64(&head[8], n);
+    storeLE32(&head[16], static_cast<uint32_t>(blocks));
+    putVarint(head, static_cast<uint32_t>(c.locations.size()));
+    for (uint32_t id = 0; id < c.locations.size(); id++) {
+        const string& loc = c.locations.name(id);
+        putVarint(head, static_cast<uint32_t>(loc.size()));
+        head += loc;
+    }
+    out.write(head.data(), static_cast<streamsize>(head.size()));
+
+    string payload;
+    for (size_t begin = 0; begin < n; begin += blockSessions) {
+        size_t end = min(n, begin + blockSessions);
+        payload.clear();
+
+        int32_t previous = 0;
+        for (size_t i = begin; i < end; i++) {
+            // Wraps like the decoder, so any pair of durations round-trips
+            putVarint(payload, zigzagEncode(static_cast<int32_t>(static_cast<uint32_t>(c.duration[i]) - static_cast<uint32_t>(previous))));
+            previous = c.duration[i];
+        }
+        for (size_t i = begin; i < end; i++) putVarint(payload, zigzagEncode(c.count[i]));
+        for (size_t i = begin; i < end; i++) putVarint(payload, zigzagEncode(c.gold[i]));
+        for (size_t i = begin; i < end; i++) putVarint(payload, c.locationId[i]);
+
+        uint64_t bits = 0;
+        unsigned used = 0;
+        for (size_t i = begin; i < end; i++) {
+            uint64_t flags = c.type[i] | (uint64_t(c.difficulty[i] & 3u) << ARCHIVE_TYPE_BITS)
+                | (uint64_t(c.rare[i] ? 1 : 0) << (ARCHIVE_TYPE_BITS + 2));
+            bits |= flags << used;
+            used += ARCHIVE_FLAG_BITS;
+            while (used >= 8) {
+                payload += static_cast<char>(bits);
+                bits >>= 8;
+                used -= 8;
+            }
+        }
+        if (used > 0) payload += static_cast<char>(bits);
+
+        WireChecksum sum;
+        sum.update(payload.data(), payload.size());
+        char blockHead[ARCHIVE_BLOCK_HEADER_SIZE];
+        storeLE32(blockHead, static_cast<uint32_t>(end - begin));
+        storeLE32(blockHead + 4, static_cast<uint32_t>(payload.size()));
+        storeLE32(blockHead + 8, sum.value());
+        out.write(blockHead, ARCHIVE_BLOCK_HEADER_SIZE);
+        out.write(payload.data(), static_cast<streamsize>(payload.size()));
+    }
+}
+
+// Streams an archive one block at a time. The stream must outlive the reader.
+class SessionArchiveReader {
+    istream& in;
+    vector<string> dictionary;
+    uint64_t sessions = 0;
+    uint64_t remaining = 0;
+    uint32_t blocksLeft = 0;
+    string payload;
+
+    void readExact(char* out, size_t n) {
+        if (!in.read(out, static_cast<streamsize>(n))) throw runtime_error("Session archive is truncated");
+    }
+
+    uint32_t readVarint() {
+        uint32_t v = 0;
+        for (unsigned shift = 0; shift < 35; shift += 7) {
+            char b;
+            readExact(&b, 1);
+            v |= static_cast<uint32_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) return v;
+        }
+        throw runtime_error("Session archive varint is too long");
+    }
+
+public:
+    // Reads the header and location dictionary. Throws runtime_error if they are invalid.
+    explicit SessionArchiveReader(istream& input) : in(input) {
+        char head[20];
+        readExact(head, sizeof(head));
+        if (memcmp(head, "BGSA", 4) != 0) throw runtime_error("Not a session archive");
+        if (loadLE16(head + 4) != ARCHIVE_VERSION)
+            throw runtime_error("Unsupported session archive version " + to_string(loadLE16(head + 4)));
+        sessions = remaining = loadLE64(head + 8);
+        blocksLeft = loadLE32(head + 16);
+
+        uint32_t entries = readVarint();
+        for (uint32_t i = 0; i < entries; i++) {
+            uint32_t len = readVarint();
+            if (len > (1u << 24)) throw runtime_error("Session archive location is too long");
+            string loc(len, '\0');
+            readExact(&loc[0], len);
+            dictionary.push_back(move(loc));
+        }
+    }
+
+    uint64_t size() const { return sessions; }
+    size_t locationCount() const { return dictionary.size(); }
+    const string& location(uint32_t id) const { return dictionary.at(id); }
+
+    // Replaces the columns with the next block (location ids index this reader's
+    // dictionary). Returns false once every block has been read.
+    bool next(SessionColumns& block) {
+        block.clear();
+        if (blocksLeft == 0) {
+            if (remaining != 0) throw runtime_error("Session archive is truncated");
+            return false;
+        }
+        blocksLeft--;
+
+        char head[ARCHIVE_BLOCK_HEADER_SIZE];
+        readExact(head, sizeof(head));
+        uint32_t n = loadLE32(head);
+        uint32_t bytes = loadLE32(head + 4);
+        if (n == 0 || n > remaining || n > ARCHIVE_BLOCK_SESSIONS)
+            throw runtime_error("Session archive block has a bad session count");
+        // Every row takes at least four varint bytes, and no field needs more than five
+        if (bytes < uint64_t(n) * 4 || bytes > uint64_t(n) * 21)
+            throw runtime_error("Session archive block has a bad size");
+        payload.resize(bytes);
+        readExact(&payload[0], bytes);
+        WireChecksum sum;
+        sum.update(payload.data(), payload.size());
+        if (sum.value() != loadLE32(head + 8)) throw runtime_error("Session archive checksum mismatch");
+        remaining -= n;
+
+        block.duration.resize(n); block.count.resize(n); block.gold.resize(n);
+        block.locationId.resize(n); block.type.resize(n); block.difficulty.resize(n); block.rare.resize(n);
+
+        const char* p = payload.data();
+        const char* end = p + payload.size();
+        int32_t previous = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            previous = static_cast<int32_t>(static_cast<uint32_t>(previous) + static_cast<uint32_t>(zigzagDecode(getVarint(p, end))));
+            block.duration[i] = previous;
+        }
+        for (uint32_t i = 0; i < n; i++) block.count[i] = zigzagDecode(getVarint(p, end));
+        for (uint32_t i = 0; i < n; i++) block.gold[i] = zigzagDecode(getVarint(p, end));
+        for (uint32_t i = 0; i < n; i++) {
+            block.locationId[i] = getVarint(p, end);
+            if (block.locationId[i] >= dictionary.size())
+                throw runtime_error("Session archive location out of range");
+        }
+
+        if (static_cast<size_t>(end - p) != (uint64_t(n) * ARCHIVE_FLAG_BITS + 7) / 8)
+            throw runtime_error("Session archive block has a bad size");
+        const uint32_t mask = (1u << ARCHIVE_FLAG_BITS) - 1;
+        uint64_t bits = 0;
+        unsigned have = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            while (have < ARCHIVE_FLAG_BITS) {
+                bits |= uint64_t(static_cast<unsigned char>(*p++)) << have;
+                have += 8;
+            }
+            uint32_t flags = static_cast<uint32_t>(bits) & mask;
+            bits >>= ARCHIVE_FLAG_BITS;
+            have -= ARCHIVE_FLAG_BITS;
+
+            uint32_t type = flags & ((1u << ARCHIVE_TYPE_BITS) - 1);
+            if (type >= RegisteredSessions::COUNT) throw runtime_error("Session archive record has an unknown type");
+            uint32_t difficulty = (flags >> ARCHIVE_TYPE_BITS) & 3u;
+            if (difficulty < EXPLORER || difficulty > TACTICIAN) throw runtime_error("Session archive record is corrupt");
+            block.type[i] = static_cast<uint8_t>(type);
+            block.difficulty[i] = static_cast<uint8_t>(difficulty);
+            block.rare[i] = static_cast<uint8_t>(flags >> (ARCHIVE_TYPE_BITS + 2));
+        }
+        return true;
+    }
+};
+
+// Aggregates an archive block by block without ever expanding it in full
+ColumnTotals aggregateArchive(istream& in, const SessionKernels& k = activeSessionKernels()) {
+    SessionArchiveReader reader(in);
+    SessionColumns block;
+    block.reserve(ARCHIVE_BLOCK_SESSIONS);
+    ColumnTotals total;
+    while (reader.next(block)) total.merge(aggregateColumns(block, k));
+    return total;
+}
+
+void saveSessionsToArchive(const string& fileName, SessionContainer& manager) {
+    SessionColumns columns = SessionColumns::from(manager);
+    ofstream outFile(fileName, ios::binary);
+    if (!outFile) throw runtime_error("Could not write " + fileName);
+    writeSessionArchive(outFile, columns);
+}
+
+// Like loadSessionsFromJson: all or nothing, returns how many sessions were added
+int loadSessionsFromArchive(const string& fileName, SessionContainer& manager) {
+    ifstream inFile(fileName, ios::binary);
+    if (!inFile) throw runtime_error("Could not open " + fileName);
+
+    SessionArchiveReader reader(inFile);
+    vector<unique_ptr<PlaySession>> loaded;
+    SessionColumns block;
+    while (reader.next(block)) {
+        for (size_t i = 0; i < block.size(); i++) {
+            loaded.emplace_back(makeSession(static_cast<SessionType>(block.type[i]), reader.location(block.locationId[i]),
+                block.duration[i], static_cast<Difficulty>(block.difficulty[i]), block.count[i],
+                LootInfo(block.gold[i], block.rare[i] != 0)));
+        }
+    }
+    for (auto& s : loaded) manager.add(s.release());
+    return static_cast<int>(loaded.size());
+}
+
+
+// ================= WORKLOAD GENERATOR =================
+// Synthetic session files for load testing. Record i is a pure function of the seed and
+// i: a splitmix64 stream jumped ahead to i * WORKLOAD_DRAWS, so output is identical no
+// matter how the work is split across threads. Records are generated in parallel in
+// rounds and written in order, so memory stays bounded for any count.
+//
+// Command line (interactive build):
+//     tracker --generate <count> <file> [--seed S] [--locations L] [--location-skew K]
+//             [--combat-share P] [--duration MIN MAX] [--max-enemies N] [--max-areas N]
+//             [--max-gold N] [--rare-rate P]
+// The file extension picks the format, as in openSessionSource: .jsonl/.ndjson for
+// JSON lines, .bgsw for the wire format, anything else for a JSON array.
+
+// Every name is built before the first record, so the count is kept to what fits in memory
+const uint32_t MAX_WORKLOAD_LOCATIONS = 1u << 20;
+
+struct WorkloadConfig {
+    uint64_t seed = 42;
+    uint64_t sessions = 1000;
+    uint32_t locations = 1000;      // distinct location names
+    double locationSkew = 1.0;      // 1 is uniform; higher values favour low location ids
+    double combatShare = 0.5;       // the rest are exploration sessions
+    int minDuration = 10;
+    int maxDuration = 180;
+    int maxEnemies = 50;            // combat count is uniform in 0..maxEnemies
+    int maxAreas = 12;              // exploration count is uniform in 0..maxAreas
+    int maxGold = 500;
+    double rareRate = 0.05;
+
+    // Throws runtime_error on a setting the generator cannot honour
+    void validate() const {
+        if (locations == 0) throw runtime_error("Workload needs at least one location");
+        if (locations > MAX_WORKLOAD_LOCATIONS)
+            throw runtime_error("At most " + to_string(MAX_WORKLOAD_LOCATIONS) + " locations are supported");
+        if (locationSkew <= 0) throw runtime_error("Location skew must be positive");
+        if (combatShare < 0 || combatShare > 1) throw runtime_error("Combat share must be between 0 and 1");
+        if (rareRate < 0 || rareRate > 1) throw runtime_error("Rare rate must be between 0 and 1");
+        if (minDuration < 0 || minDuration > maxDuration) throw runtime_error("Bad duration range");
+        if (maxEnemies < 0 || maxAreas < 0 || maxGold < 0) throw runtime_error("Maximums must not be negative");
+    }
+};
+
+struct GeneratedSession {
+    SessionType type;
+    uint32_t locationId;
+    int duration;
+    Difficulty difficulty;
+    int count;
+    int gold;
+    bool rare;
+};
+
+inline uint64_t splitmix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+const uint64_t SPLITMIX_GAMMA = 0x9E3779B97F4A7C15ull;
+const uint64_t WORKLOAD_DRAWS = 8;     // random draws reserved for each record
+
+// Counter-based generator: positioned directly at any record, no shared state
+class WorkloadRng {
+    uint64_t state;
+
+public:
+    WorkloadRng(uint64_t seed, uint64_t record) : state(splitmix64(seed) + record * WORKLOAD_DRAWS * SPLITMIX_GAMMA) {}
+
+    uint64_t next() { return splitmix64(state += SPLITMIX_GAMMA); }
+
+    // Uniform in [0, 1)
+    double unit() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Uniform in [lo, hi]
+    int between(int lo, int hi) {
+        uint64_t span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo) + 1;
+        return lo + static_cast<int>(((next() >> 32) * span) >> 32);
+    }
+};
+
+GeneratedSession generateSession(const WorkloadConfig& c, uint64_t index) {
+    WorkloadRng rng(c.seed, index);
+    GeneratedSession g;
+    g.type = rng.unit() < c.combatShare ? COMBAT_SESSION : EXPLORATION_SESSION;
+
+    double u = rng.unit();
+    if (c.locationSkew != 1.0) u = pow(u, c.locationSkew);
+    g.locationId = min(c.locations - 1, static_cast<uint32_t>(u * c.locations));
+
+    g.duration = rng.between(c.minDuration, c.maxDuration);
+    g.difficulty = static_cast<Difficulty>(rng.between(EXPLORER, TACTICIAN));
+    g.count = rng.between(0, g.type == COMBAT_SESSION ? c.maxEnemies : c.maxAreas);
+    g.gold = rng.between(0, c.maxGold);
+    g.rare = rng.unit() < c.rareRate;
+    return g;
+}
+
+string workloadLocation(uint32_t id) {
+    static const char* places[] = { "Nautiloid Crash Site", "Emerald Grove", "Goblin Camp",
+        "Underdark", "Moonrise Towers", "Camp", "Forest" };
+    return string(places[id % 7]) + " " + to_string(id / 7);
+}
+
+enum WorkloadFormat { WORKLOAD_JSON, WORKLOAD_JSON_LINES, WORKLOAD_WIRE };
+
+WorkloadFormat workloadFormatFor(const string& fileName) {
+    string ext = filesystem::path(fileName).extension().string();
+    if (ext == ".bgsw") return WORKLOAD_WIRE;
+    if (ext == ".jsonl" || ext == ".ndjson") return WORKLOAD_JSON_LINES;
+    return WORKLOAD_JSON;
+}
+
+inline void appendInt(string& out, long long v) {
+    char buf[24];
+    auto r = to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, r.ptr);
+}
+
+// Same fields and spelling as sessionToJson. Generated names need no escaping.
+void appendSessionJson(string& out, const GeneratedSession& g, const string& location) {
+    out += "{\"type\":\"";
+    out += RegisteredSessions::tagOf(g.type);
+    out += "\",\"location\":\"";
+    out += location;
+    out += "\",\"durationMinutes\":";
+    appendInt(out, g.duration);
+    out += ",\"difficulty\":\"";
+    out += difficultyName(g.difficulty);
+    out += "\",\"goldEarned\":";
+    appendInt(out, g.gold);
+    out += ",\"rareItemFound\":";
+    out += g.rare ? "true" : "false";
+    out += ",\"";
+    out += RegisteredSessions::countFieldOf(g.type);
+    out += "\":";
+    appendInt(out, g.count);
+    out += '}';
+}
+
+const size_t WORKLOAD_PIECE = 1 << 15;    // records one task renders
+const size_t WORKLOAD_ROUND = 1 << 21;    // records rendered before a write
+
+// Writes config.sessions generated sessions to fileName and returns the bytes written
+uint64_t generateWorkload(const WorkloadConfig& config, const string& fileName) {
+    config.validate();
+    WorkloadFormat format = workloadFormatFor(fileName);
+    vector<string> names(config.locations);
+    for (uint32_t id = 0; id < config.locations; id++) names[id] = workloadLocation(id);
+
+    unique_ptr<WireFileWriter> wire;
+    ofstream outFile;
+    if (format == WORKLOAD_WIRE) {
+        wire.reset(new WireFileWriter(fileName));
+    }
+    else {
+        outFile.open(fileName, ios::binary);
+        if (!outFile) throw runtime_error("Could not write " + fileName);
+    }
+    if (format == WORKLOAD_JSON) outFile << "[\n";
+
+    vector<uint32_t> nameOffsets(config.locations);
+    if (wire)
+        for (uint32_t id = 0; id < config.locations; id++) nameOffsets[id] = wire->location(names[id]);
+
+    vector<string> pieces;
+    for (uint64_t roundBegin = 0; roundBegin < config.sessions; roundBegin += WORKLOAD_ROUND) {
+        uint64_t roundEnd = min<uint64_t>(config.sessions, roundBegin + WORKLOAD_ROUND);
+        size_t pieceCount = static_cast<size_t>((roundEnd - roundBegin + WORKLOAD_PIECE - 1) / WORKLOAD_PIECE);
+        pieces.resize(pieceCount);
+
+        sharedScheduler().parallelFor(WORK_GENERATION, pieceCount, 1, [&](size_t firstPiece, size_t lastPiece) {
+            for (size_t p = firstPiece; p < lastPiece; p++) {
+                string& out = pieces[p];
+                out.clear();
+                uint64_t begin = roundBegin + p * WORKLOAD_PIECE;
+                uint64_t end = min<uint64_t>(roundEnd, begin + WORKLOAD_PIECE);
+                for (uint64_t i = begin; i < end; i++) {
+                    GeneratedSession g = generateSession(config, i);
+                    if (format == WORKLOAD_WIRE) {
+                        char rec[WIRE_RECORD_SIZE];
+                        packWireRecord(rec, nameOffsets[g.locationId], static_cast<uint32_t>(names[g.locationId].size()),
+                            g.type, g.difficulty, g.duration, g.count, LootInfo(g.gold, g.rare));
+                        out.append(rec, WIRE_RECORD_SIZE);
+                    }
+                    else {
+                        if (format == WORKLOAD_JSON && i > 0) out += ",\n";
+                        appendSessionJson(out, g, names[g.locationId]);
+                        if (format == WORKLOAD_JSON_LINES) out += '\n';
+                    }
+                }
+            }
+        });
+
+        for (const string& piece : pieces) {
+            if (wire) wire->addRecords(piece.data(), piece.size() / WIRE_RECORD_SIZE);
+            else outFile.write(piece.data(), static_cast<streamsize>(piece.size()));
+        }
+    }
+
+    if (wire) return wire->finish();
+    if (format == WORKLOAD_JSON) outFile << "\n]\n";
+
+    uint64_t bytes = static_cast<uint64_t>(outFile.tellp());
+    if (!outFile) throw runtime_error("Failed writing " + fileName);
+    return bytes;
+}
+
+// Parses the arguments after --generate. Throws runtime_error on bad usage.
+WorkloadConfig parseWorkloadArgs(const vector<string>& args, string& fileName) {
+    if (args.size() < 2) throw runtime_error("Usage: --generate <count> <file> [options]");
+
+    WorkloadConfig c;
+    auto number = [](const string& text) {
+        try {
+            size_t used = 0;
+            double v = stod(text, &used);
+            if (used != text.size() || !isfinite(v)) throw invalid_argument(text);
+            return v;
+        }
+        catch (const logic_error&) {
+            throw runtime_error("Not a number: " + text);
+        }
+    };
+
+    auto wholeNumber = [](const string& text) {
+        if (text.empty() || text.find_first_not_of("0123456789") != string::npos)
+            throw runtime_error("Not a whole number: " + text);
+        uint64_t v = 0;
+        auto r = from_chars(text.data(), text.data() + text.size(), v);
+        if (r.ec != errc()) throw runtime_error("Number out of range: " + text);
+        return v;
+    };
+
+    // Settings stored in narrower integers are range-checked before the cast
+    auto upTo = [&](const string& text, uint64_t limit) {
+        uint64_t v = wholeNumber(text);
+        if (v > limit) throw runtime_error("Number out of range: " + text);
+        return v;
+    };
+    auto intSetting = [&](const string& text) { return static_cast<int>(upTo(text, numeric_limits<int>::max())); };
+
+    c.sessions = wholeNumber(args[0]);
+    fileName = args[1];
+    for (size_t i = 2; i < args.size(); i++) {
+        const string& flag = args[i];
+        size_t values = flag == "--duration" ? 2 : 1;
+        if (i + values >= args.size()) throw runtime_error("Missing value for " + flag);
+        const string& value = args[i + 1];
+
+        if (flag == "--seed") c.seed = wholeNumber(value);
+        else if (flag == "--locations") c.locations = static_cast<uint32_t>(upTo(value, numeric_limits<uint32_t>::max()));
+        else if (flag == "--location-skew") c.locationSkew = number(value);
+        else if (flag == "--combat-share") c.combatShare = number(value);
+        else if (flag == "--duration") { c.minDuration = intSetting(value); c.maxDuration = intSetting(args[i + 2]); }
+        else if (flag == "--max-enemies") c.maxEnemies = intSetting(value);
+        else if (flag == "--max-areas") c.maxAreas = intSetting(value);
+        else if (flag == "--max-gold") c.maxGold = intSetting(value);
+        else if (flag == "--rare-rate") c.rareRate = number(value);
+        else throw runtime_error("Unknown option " + flag);
+        i += values;
+    }
+    c.validate();
+    return c;
+}
+
+// Entry point for --generate; returns the process exit code
+int runGenerateCommand(const vector<string>& args) {
+    try {
+        string fileName;
+        WorkloadConfig config = parseWorkloadArgs(args, fileName);
+        auto start = chrono::steady_clock::now();
+        uint64_t bytes = generateWorkload(config, fileName);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Wrote " << config.sessions << " sessions to " << fileName << " (" << fixed << setprecision(1)
+            << bytes / 1048576.0 << " MiB) in " << setprecision(2) << seconds << " s\n" << defaultfloat;
+        return 0;
+    }
+    catch (const runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+
+// ================= FILTER EXPRESSIONS =================
+// Ad-hoc session filters such as
+//     type == combat && difficulty >= balanced && durationMinutes > 45 && rareItemFound
+// An expression is parsed once into a tree, then either compiled into nested closures
+// for one session at a time (SessionFilter::matches) or evaluated a column at a time
+// over SessionColumns, one tight loop per comparison into a byte mask (evaluate).
+//
+//   expr     := and ("||" and)*
+//   and      := unary ("&&" unary)*
+//   unary    := "!" unary | "(" expr ")" | field [op value]
+//   op       := == != < <= > >=
+//   value    := integer | "quoted text" | name
+//
+// Fields: type, location, durationMinutes (duration), difficulty, goldEarned (gold),
+// rareItemFound (rare), count, and each registered type's count field, which also
+// requires that type (enemiesDefeated > 5 only matches combat sessions). A field with
+// no comparison must be rareItemFound. Type and location take only == and !=.
+
+enum FilterField { FILTER_TYPE, FILTER_LOCATION, FILTER_DURATION, FILTER_DIFFICULTY, FILTER_GOLD, FILTER_RARE, FILTER_COUNT };
+enum FilterOp { FILTER_EQ, FILTER_NE, FILTER_LT, FILTER_LE, FILTER_GT, FILTER_GE };
+
+struct FilterNode {
+    enum Kind { AND, OR, NOT, COMPARE } kind;
+    FilterField field = FILTER_DURATION;
+    FilterOp op = FILTER_EQ;
+    long long number = 0;       // every field but location compares as an integer
+    string text;                // location
+    unique_ptr<FilterNode> left, right;
+    int depth = 1;              // levels from this node down to its deepest leaf
+
+    explicit FilterNode(Kind k) : kind(k) {}
+};
+
+// Parsing, compiling, evaluating and freeing all recurse over the tree
+const int MAX_FILTER_DEPTH = 256;
+
+class FilterParser {
+    struct Token {
+        enum Kind { NAME, NUMBER, TEXT, SYMBOL, END } kind;
+        string text;
+        size_t column;
+    };
+
+    vector<Token> tokens;
+    size_t pos = 0;
+    int nesting = 0;        // '!' and '(' currently open
+
+    [[noreturn]] static void fail(size_t column, const string& message) {
+        throw runtime_error("Filter error at column " + to_string(column + 1) + ": " + message);
+    }
+
+    void tokenize(const string& src) {
+        size_t i = 0;
+        while (i < src.size()) {
+            char c = src[i];
+            if (isspace(static_cast<unsigned char>(c))) { i++; continue; }
+
+            size_t start = i;
+            if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                while (i < src.size() && (isalnum(static_cast<unsigned char>(src[i])) || src[i] == '_')) i++;
+                tokens.push_back({ Token::NAME, src.substr(start, i - start), start });
+            }
+            else if (isdigit(static_cast<unsigned char>(c)) || (c == '-' && i + 1 < src.size() && isdigit(static_cast<unsigned char>(src[i + 1])))) {
+                i++;
+                while (i < src.size() && isdigit(static_cast<unsigned char>(src[i]))) i++;
+                tokens.push_back({ Token::NUMBER, src.substr(start, i - start), start });
+            }
+            else if (c == '"') {
+                string text;
+                for (i++; i < src.size() && src[i] != '"'; i++) {
+                    if (src[i] == '\\' && i + 1 < src.size()) i++;
+                    text += src[i];
+                }
+                if (i == src.size()) fail(start, "unterminated text");
+                i++;
+                tokens.push_back({ Token::TEXT, text, start });
+            }
+            else {
+                static const char* symbols[] = { "&&", "||", "==", "!=", "<=", ">=", "<", ">", "!", "(", ")" };
+                const char* match = nullptr;
+                for (const char* sym : symbols)
+                    if (src.compare(i, strlen(sym), sym) == 0) { match = sym; break; }
+                if (!match) fail(start, string("unexpected '") + c + "'");
+                i += strlen(match);
+                tokens.push_back({ Token::SYMBOL, match, start });
+            }
+        }
+        tokens.push_back({ Token::END, "", src.size() });
+    }
+
+    const Token& peek() const { return tokens[pos]; }
+    bool accept(const char* symbol) {
+        if (peek().kind == Token::SYMBOL && peek().text == symbol) { pos++; return true; }
+        return false;
+    }
+
+    static string lower(string s) {
+        for (char& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    static unique_ptr<FilterNode> join(FilterNode::Kind kind, unique_ptr<FilterNode> a, unique_ptr<FilterNode> b) {
+        unique_ptr<FilterNode> n(new FilterNode(kind));
+        n->depth = 1 + max(a->depth, b->depth);
+        n->left = move(a);
+        n->right = move(b);
+        return n;
+    }
+
+    // A chain of && or || grows the tree one level per operator
+    unique_ptr<FilterNode> checkDepth(unique_ptr<FilterNode> n, size_t column) {
+        if (n->depth > MAX_FILTER_DEPTH) fail(column, "expression is nested too deeply");
+        return n;
+    }
+
+    unique_ptr<FilterNode> parseOr() {
+        unique_ptr<FilterNode> n = parseAnd();
+        while (accept("||")) {
+            size_t column = tokens[pos - 1].column;
+            n = checkDepth(join(FilterNode::OR, move(n), parseAnd()), column);
+        }
+        return n;
+    }
+
+    unique_ptr<FilterNode> parseAnd() {
+        unique_ptr<FilterNode> n = parseUnary();
+        while (accept("&&")) {
+            size_t column = tokens[pos - 1].column;
+            n = checkDepth(join(FilterNode::AND, move(n), parseUnary()), column);
+        }
+        return n;
+    }
+
+    unique_ptr<FilterNode> parseUnary() {
+        if (peek().kind == Token::SYMBOL && (peek().text == "!" || peek().text == "(") && nesting == MAX_FILTER_DEPTH)
+            fail(peek().column, "expression is nested too deeply");
+        if (accept("!")) {
+            size_t column = tokens[pos - 1].column;
+            unique_ptr<FilterNode> n(new FilterNode(FilterNode::NOT));
+            nesting++;
+            n->left = parseUnary();
+            nesting--;
+            n->depth = 1 + n->left->depth;
+            return checkDepth(move(n), column);
+        }
+        if (accept("(")) {
+            nesting++;
+            unique_ptr<FilterNode> n = parseOr();
+            nesting--;
+            if (!accept(")")) fail(peek().column, "expected ')'");
+            return n;
+        }
+        return parseComparison();
+    }
+
+    unique_ptr<FilterNode> parseComparison() {
+        Token name = peek();
+        if (name.kind != Token::NAME) fail(name.column, name.kind == Token::END ? "unexpected end" : "expected a field");
+        pos++;
+
+        unique_ptr<FilterNode> n(new FilterNode(FilterNode::COMPARE));
+        int requiredType = -1;
+        string field = name.text;
+        if (field == "type") n->field = FILTER_TYPE;
+        else if (field == "location") n->field = FILTER_LOCATION;
+        else if (field == "durationMinutes" || field == "duration") n->field = FILTER_DURATION;
+        else if (field == "difficulty") n->field = FILTER_DIFFICULTY;
+        else if (field == "goldEarned" || field == "gold") n->field = FILTER_GOLD;
+        else if (field == "rareItemFound" || field == "rare") n->field = FILTER_RARE;
+        else if (field == "count") n->field = FILTER_COUNT;
+        else {
+            for (int id = 0; id < static_cast<int>(RegisteredSessions::COUNT); id++)
+                if (field == RegisteredSessions::countFieldOf(static_cast<SessionType>(id))) requiredType = id;
+            if (requiredType < 0) fail(name.column, "unknown field '" + field + "'");
+            n->field = FILTER_COUNT;
+        }
+
+        static const char* ops[] = { "==", "!=", "<", "<=", ">", ">=" };
+        int op = -1;
+        for (int i = 0; i < 6 && op < 0; i++)
+            if (accept(ops[i])) op = i;
+
+        if (op < 0) {
+            if (n->field != FILTER_RARE) fail(peek().column, "expected a comparison after '" + field + "'");
+            n->op = FILTER_EQ;
+            n->number = 1;
+            return n;
+        }
+        n->op = static_cast<FilterOp>(op);
+        if ((n->field == FILTER_TYPE || n->field == FILTER_LOCATION || n->field == FILTER_RARE) && n->op > FILTER_NE)
+            fail(tokens[pos - 1].column, "'" + field + "' only supports == and !=");
+
+        Token value = peek();
+        if (value.kind == Token::END || value.kind == Token::SYMBOL) fail(value.column, "expected a value");
+        pos++;
+        parseValue(*n, value);
+
+        if (requiredType >= 0) {
+            unique_ptr<FilterNode> type(new FilterNode(FilterNode::COMPARE));
+            type->field = FILTER_TYPE;
+            type->number = requiredType;
+            return join(FilterNode::AND, move(type), move(n));
+        }
+        return n;
+    }
+
+    void parseValue(FilterNode& n, const Token& value) {
+        if (n.field == FILTER_LOCATION) {
+            n.text = value.text;
+            return;
+        }
+        if (value.kind == Token::NUMBER) {
+            if (n.field == FILTER_TYPE) fail(value.column, "expected a session type");
+            try { n.number = stoll(value.text); }
+            catch (const out_of_range&) { fail(value.column, "number out of range"); }
+            return;
+        }
+
+        string word = lower(value.text);
+        SessionType type;
+        if (n.field == FILTER_TYPE && value.kind == Token::NAME && RegisteredSessions::findTag(word, type))
+            n.number = type;
+        else if (n.field == FILTER_DIFFICULTY && value.kind == Token::NAME && (word == "explorer" || word == "balanced" || word == "tactician"))
+            n.number = word == "explorer" ? EXPLORER : word == "balanced" ? BALANCED : TACTICIAN;
+        else if (n.field == FILTER_RARE && value.kind == Token::NAME && (word == "true" || word == "false"))
+            n.number = word == "true";
+        else
+            fail(value.column, "'" + value.text + "' is not a valid value here");
+    }
+
+public:
+    // Throws runtime_error naming the column of the first problem
+    unique_ptr<FilterNode> parse(const string& src) {
+        tokenize(src);
+        unique_ptr<FilterNode> root = parseOr();
+        if (peek().kind != Token::END) fail(peek().column, "unexpected '" + peek().text + "'");
+        return root;
+    }
+};
+
+// Column loop for one comparison, specialised on the operator so the body is a single
+// compare the compiler can vectorise
+template <typename T, typename Cmp>
+void compareColumn(const T* column, size_t n, long long value, uint8_t* out, Cmp cmp) {
+    for (size_t i = 0; i < n; i++) out[i] = cmp(static_cast<long long>(column[i]), value) ? 1 : 0;
+}
+
+template <typename T>
+void compareColumn(const T* column, size_t n, FilterOp op, long long value, uint8_t* out) {
+    switch (op) {
+    case FILTER_EQ: compareColumn(column, n, value, out, equal_to<long long>()); break;
+    case FILTER_NE: compareColumn(column, n, value, out, not_equal_to<long long>()); break;
+    case FILTER_LT: compareColumn(column, n, value, out, less<long long>()); break;
+    case FILTER_LE: compareColumn(column, n, value, out, less_equal<long long>()); break;
+    case FILTER_GT: compareColumn(column, n, value, out, greater<long long>()); break;
+    case FILTER_GE: compareColumn(column, n, value, out, greater_equal<long long>()); break;
+    }
+}
+
+template <typename T>
+bool compareValues(T a, FilterOp op, T b) {
+    switch (op) {
+    case FILTER_EQ: return a == b;
+    case FILTER_NE: return a != b;
+    case FILTER_LT: return a < b;
+    case FILTER_LE: return a <= b;
+    case FILTER_GT: return a > b;
+    case FILTER_GE: return a >= b;
+    }
+    return false;
+}
+
+class SessionFilter {
+    string source;
+    shared_ptr<const FilterNode> root;
+    function<bool(const PlaySession&)> predicate;
+
+    template <typename Get>
+    static function<bool(const PlaySession&)> compareWith(Get get, FilterOp op, long long v) {
+        switch (op) {
+        case FILTER_EQ: return [get, v](const PlaySession& s) { return get(s) == v; };
+        case FILTER_NE: return [get, v](const PlaySession& s) { return get(s) != v; };
+        case FILTER_LT: return [get, v](const PlaySession& s) { return get(s) < v; };
+        case FILTER_LE: return [get, v](const PlaySession& s) { return get(s) <= v; };
+        case FILTER_GT: return [get, v](const PlaySession& s) { return get(s) > v; };
+        case FILTER_GE: return [get, v](const PlaySession& s) { return get(s) >= v; };
+        }
+        return nullptr;
+    }
+
+    static function<bool(const PlaySession&)> compile(const FilterNode& n) {
+        switch (n.kind) {
+        case FilterNode::AND: {
+            auto a = compile(*n.left), b = compile(*n.right);
+            return [a, b](const PlaySession& s) { return a(s) && b(s); };
+        }
+        case FilterNode::OR: {
+            auto a = compile(*n.left), b = compile(*n.right);
+            return [a, b](const PlaySession& s) { return a(s) || b(s); };
+        }
+        case FilterNode::NOT: {
+            auto a = compile(*n.left);
+            return [a](const PlaySession& s) { return !a(s); };
+        }
+        case FilterNode::COMPARE:
+            break;
+        }
+
+        switch (n.field) {
+        case FILTER_LOCATION: {
+            string loc = n.text;
+            if (n.op == FILTER_EQ) return [loc](const PlaySession& s) { return s.getLocation() == loc; };
+            return [loc](const PlaySession& s) { return s.getLocation() != loc; };
+        }
+        case FILTER_TYPE: return compareWith([](const PlaySession& s) { return static_cast<long long>(s.getType()); }, n.op, n.number);
+        case FILTER_DURATION: return compareWith([](const PlaySession& s) { return static_cast<long long>(s.getDuration()); }, n.op, n.number);
+        case FILTER_DIFFICULTY: return compareWith([](const PlaySession& s) { return static_cast<long long>(s.getDifficulty()); }, n.op, n.number);
+        case FILTER_GOLD: return compareWith([](const PlaySession& s) { return static_cast<long long>(sessionLoot(s).getGoldEarned()); }, n.op, n.number);
+        case FILTER_RARE: return compareWith([](const PlaySession& s) { return static_cast<long long>(sessionLoot(s).isRareItemFound()); }, n.op, n.number);
+        case FILTER_COUNT: return compareWith([](const PlaySession& s) { return static_cast<long long>(sessionCount(s)); }, n.op, n.number);
+        }
+        return nullptr;
+    }
+
+    static void evaluate(const FilterNode& n, const SessionColumns& c, uint8_t* out) {
+        size_t size = c.size();
+        if (n.kind != FilterNode::COMPARE) {
+            evaluate(*n.left, c, out);
+            if (n.kind == FilterNode::NOT) {
+                for (size_t i = 0; i < size; i++) out[i] ^= 1;
+                return;
+            }
+            vector<uint8_t> other(size);
+            evaluate(*n.right, c, other.data());
+            if (n.kind == FilterNode::AND) for (size_t i = 0; i < size; i++) out[i] &= other[i];
+            else for (size_t i = 0; i < size; i++) out[i] |= other[i];
+            return;
+        }
+
+        switch (n.field) {
+        case FILTER_LOCATION: {
+            // Compare interned ids; a name that was never interned matches nothing
+            long long id = c.locations.find(n.text);
+            if (id < 0) fill(out, out + size, static_cast<uint8_t>(n.op == FILTER_NE));
+            else compareColumn(c.locationId.data(), size, n.op, id, out);
+            break;
+        }
+        case FILTER_TYPE: compareColumn(c.type.data(), size, n.op, n.number, out); break;
+        case FILTER_DURATION: compareColumn(c.duration.data(), size, n.op, n.number, out); break;
+        case FILTER_DIFFICULTY: compareColumn(c.difficulty.data(), size, n.op, n.number, out); break;
+        case FILTER_GOLD: compareColumn(c.gold.data(), size, n.op, n.number, out); break;
+        case FILTER_RARE: compareColumn(c.rare.data(), size, n.op, n.number, out); break;
+        case FILTER_COUNT: compareColumn(c.count.data(), size, n.op, n.number, out); break;
+        }
+    }
+
+public:
+    // Throws runtime_error if the expression does not parse
+    explicit SessionFilter(const string& expression) : source(expression) {
+        root = FilterParser().parse(expression);
+        predicate = compile(*root);
+    }
+
+    const string& text() const { return source; }
+
+    bool matches(const PlaySession& s) const { return predicate(s); }
+
+    // One byte per row, 1 where the row matches
+    vector<uint8_t> evaluate(const SessionColumns& c) const {
+        vector<uint8_t> mask(c.size());
+        evaluate(*root, c, mask.data());
+        return mask;
+    }
+
+    size_t count(const SessionColumns& c) const {
+        vector<uint8_t> mask = evaluate(c);
+        return static_cast<size_t>(std::count(mask.begin(), mask.end(), uint8_t(1)));
+    }
+};
+
+// Indices of the matching sessions, in container order
+vector<int> filterSessions(SessionContainer& manager, const SessionFilter& filter) {
+    vector<int> found;
+    int index = 0;
+    for (const PlaySession& s : manager) {
+        if (filter.matches(s)) found.push_back(index);
+        index++;
+    }
+    return found;
+}
+
+// --filter <file> <expression>: streams any session file into columns, then prints
+// how many sessions match and their totals. Returns the process exit code.
+int runFilterCommand(const vector<string>& args) {
+    try {
+        if (args.size() < 2) throw runtime_error("Usage: --filter <file> <expression>");
+        SessionFilter filter(args[1]);
+
+        SessionColumns columns;
+        auto source = openSessionSource(args[0]);
+        while (unique_ptr<PlaySession> s = source->next()) columns.add(*s);
+
+        auto start = chrono::steady_clock::now();
+        vector<uint8_t> mask = filter.evaluate(columns);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t matched = 0;
+        long long minutes = 0, gold = 0;
+        for (size_t i = 0; i < mask.size(); i++) {
+            if (!mask[i]) continue;
+            matched++;
+            minutes += columns.duration[i];
+            gold += columns.gold[i];
+        }
+        cout << matched << " of " << columns.size() << " sessions match (" << minutes << " minutes, "
+            << gold << " gold), scanned in " << fixed << setprecision(2) << seconds * 1000 << " ms\n" << defaultfloat;
+        return 0;
+    }
+    catch (const runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+
+// ================= CSV =================
+// Spreadsheet-friendly session files. A header row, then one row per session:
+//     type,location,durationMinutes,difficulty,goldEarned,rareItemFound,enemiesDefeated,areasDiscovered
+// with one count column per registered type (in type id order); only the row's own
+// count column is filled. Locations are quoted when they hold a comma, quote or line
+// break, with quotes doubled (RFC 4180). Import accepts LF or CRLF line ends.
+//
+// Export formats numbers with to_chars into one reused buffer, so rows cost no
+// allocations. Import reads the file in large chunks, splits each at row boundaries
+// (tracking quotes), parses the pieces in parallel into SessionColumns and appends them
+// in file order.
+
+const size_t CSV_FLUSH_BYTES = 1 << 20;
+const size_t CSV_CHUNK_BYTES = 1 << 24;
+const size_t CSV_PIECE_BYTES = 1 << 20;     // smallest piece worth a task
+const size_t CSV_FIXED_FIELDS = 6;
+
+string csvHeader() {
+    string header = "type,location,durationMinutes,difficulty,goldEarned,rareItemFound";
+    for (size_t id = 0; id < RegisteredSessions::COUNT; id++)
+        header += string(",") + RegisteredSessions::countFieldOf(static_cast<SessionType>(id));
+    return header;
+}
+
+class CsvSessionWriter {
+    ofstream outFile;
+    string buffer;
+
+    void appendNumber(long long v) {
+        char digits[24];
+        auto r = to_chars(digits, digits + sizeof(digits), v);
+        buffer.append(digits, r.ptr);
+    }
+
+public:
+    explicit CsvSessionWriter(const string& fileName) : outFile(fileName, ios::binary) {
+        if (!outFile) throw runtime_error("Could not write " + fileName);
+        buffer.reserve(CSV_FLUSH_BYTES + 4096);
+        buffer += csvHeader();
+        buffer += '\n';
+    }
+
+    CsvSessionWriter(const CsvSessionWriter&) = delete;
+    CsvSessionWriter& operator=(const CsvSessionWriter&) = delete;
+
+    ~CsvSessionWriter() {
+        try { flush(); }
+        catch (...) {}
+    }
+
+    void write(SessionType type, string_view loc, int dur, Difficulty diff, int count, const LootInfo& loot) {
+        buffer += RegisteredSessions::tagOf(type);
+        buffer += ',';
+        if (loc.find_first_of(",\"\r\n") == string_view::npos) buffer.append(loc.data(), loc.size());
+        else {
+            buffer += '"';
+            for (char c : loc) {
+                if (c == '"') buffer += '"';
+                buffer += c;
+            }
+            buffer += '"';
+        }
+        buffer += ',';
+        appendNumber(dur);
+        buffer += ',';
+        buffer += difficultyName(diff);
+        buffer += ',';
+        appendNumber(loot.getGoldEarned());
+        buffer += loot.isRareItemFound() ? ",true" : ",false";
+        for (size_t id = 0; id < RegisteredSessions::COUNT; id++) {
+            buffer += ',';
+            if (id == static_cast<size_t>(type)) appendNumber(count);
+        }
+        buffer += '\n';
+        if (buffer.size() >= CSV_FLUSH_BYTES) flush();
+    }
+
+    void write(const PlaySession& s) {
+        write(s.getType(), s.getLocation(), s.getDuration(), s.getDifficulty(), sessionCount(s), sessionLoot(s));
+    }
+
+    // Throws runtime_error if the file cannot be written
+    void flush() {
+        outFile.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        buffer.clear();
+        if (!outFile) throw runtime_error("Failed writing CSV file");
+    }
+};
+
+void saveSessionsToCsv(const string& fileName, SessionContainer& manager) {
+    CsvSessionWriter writer(fileName);
+    for (const PlaySession& s : manager) writer.write(s);
+    writer.flush();
+}
+
+// Row number within a piece plus what was wrong with it
+struct CsvRowError {
+    size_t row;
+    string message;
+};
+
+// Reads one field starting at p. Quoted fields with doubled quotes are unescaped into
+// scratch. Returns true when the field ended its row.
+inline bool nextCsvField(const char*& p, const char* end, string_view& field, string& scratch) {
+    if (p < end && *p == '"') {
+        const char* start = ++p;
+        bool escaped = false;
+        while (true) {
+            if (p == end) throw runtime_error("unterminated quoted field");
+            if (*p == '"') {
+                if (p + 1 < end && p[1] == '"') { escaped = true; p += 2; continue; }
+                break;
+            }
+            p++;
+        }
+        if (escaped) {
+            scratch.clear();
+            for (const char* q = start; q < p; q++) {
+                scratch += *q;
+                if (*q == '"') q++;
+            }
+            field = scratch;
+        }
+        else field = string_view(start, static_cast<size_t>(p - start));
+        p++;    // closing quote
+    }
+    else {
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '\n' && *p != '\r') p++;
+        field = string_view(start, static_cast<size_t>(p - start));
+    }
+
+    if (p < end && *p == ',') { p++; return false; }
+    if (p < end && *p == '\r') p++;
+    if (p < end && *p != '\n') throw runtime_error("unexpected text after a quoted field");
+    if (p < end) p++;
+    return true;
+}
+
+inline int csvInt(string_view field, const char* name) {
+    int v = 0;
+    auto r = from_chars(field.data(), field.data() + field.size(), v);
+    if (field.empty() || r.ec != errc() || r.ptr != field.data() + field.size())
+        throw runtime_error(string("bad ") + name + " '" + string(field) + "'");
+    return v;
+}
+
+// Parses the rows in [p, end) and appends them to out. Throws CsvRowError.
+void parseCsvRows(const char* p, const char* end, SessionColumns& out) {
+    string scratch, location;   // reused, so rows only allocate for new locations
+    string_view fields[CSV_FIXED_FIELDS + RegisteredSessions::COUNT];
+    const size_t fieldCount = CSV_FIXED_FIELDS + RegisteredSessions::COUNT;
+    size_t row = 0;
+
+    while (p < end) {
+        try {
+            size_t n = 0;
+            bool rowEnded = false;
+            while (!rowEnded) {
+                if (n == fieldCount) throw runtime_error("too many fields");
+                rowEnded = nextCsvField(p, end, fields[n], scratch);
+                if (n == 1) location.assign(fields[1].data(), fields[1].size());   // before scratch is reused
+                n++;
+            }
+            if (n != fieldCount) throw runtime_error("expected " + to_string(fieldCount) + " fields, found " + to_string(n));
+
+            int type = -1;
+            for (size_t id = 0; id < RegisteredSessions::COUNT; id++)
+                if (fields[0] == RegisteredSessions::tagOf(static_cast<SessionType>(id))) type = static_cast<int>(id);
+            if (type < 0) throw runtime_error("unknown session type '" + string(fields[0]) + "'");
+
+            Difficulty diff;
+            if (fields[3] == "Explorer") diff = EXPLORER;
+            else if (fields[3] == "Balanced") diff = BALANCED;
+            else if (fields[3] == "Tactician") diff = TACTICIAN;
+            else throw runtime_error("unknown difficulty '" + string(fields[3]) + "'");
+
+            bool rare;
+            if (fields[5] == "true" || fields[5] == "1") rare = true;
+            else if (fields[5] == "false" || fields[5] == "0") rare = false;
+            else throw runtime_error("bad rareItemFound '" + string(fields[5]) + "'");
+
+            for (size_t id = 0; id < RegisteredSessions::COUNT; id++)
+                if (static_cast<int>(id) != type && !fields[CSV_FIXED_FIELDS + id].empty())
+                    throw runtime_error(string(RegisteredSessions::countFieldOf(static_cast<SessionType>(id))) +
+                        " is only for " + RegisteredSessions::tagOf(static_cast<SessionType>(id)) + " sessions");
+            int count = csvInt(fields[CSV_FIXED_FIELDS + type], RegisteredSessions::countFieldOf(static_cast<SessionType>(type)));
+
+            out.type.push_back(static_cast<uint8_t>(type));
+            out.difficulty.push_back(static_cast<uint8_t>(diff));
+            out.rare.push_back(rare ? 1 : 0);
+            out.duration.push_back(csvInt(fields[2], "durationMinutes"));
+            out.count.push_back(count);
+            out.gold.push_back(csvInt(fields[4], "goldEarned"));
+            out.locationId.push_back(out.locations.intern(location));
+        }
+        catch (const runtime_error& e) {
+            throw CsvRowError{ row, e.what() };
+        }
+        row++;
+    }
+}
+
+// Reads a whole CSV file into columns. Throws runtime_error naming the first bad row.
+// The chunk and piece sizes only change how the work is cut up, never the result.
+SessionColumns readSessionsCsv(const string& fileName, size_t chunkBytes = CSV_CHUNK_BYTES,
+    size_t pieceBytes = CSV_PIECE_BYTES) {
+    ifstream inFile(fileName, ios::binary);
+    if (!inFile) throw runtime_error("Could not open " + fileName);
+
+    string header;
+    getline(inFile, header);
+    if (!header.empty() && header.back() == '\r') header.pop_back();
+    if (header != csvHeader()) throw runtime_error(fileName + " does not have the session CSV header");
+
+    SessionColumns result;
+    size_t rowsBefore = 0;
+    string chunk;       // rows carried over from the last chunk, then the next read
+    bool atEnd = false;
+    while (!atEnd) {
+        size_t carried = chunk.size();
+        chunk.resize(carried + chunkBytes);
+        inFile.read(&chunk[carried], static_cast<streamsize>(chunkBytes));
+        size_t got = static_cast<size_t>(inFile.gcount());
+        atEnd = got < chunkBytes;
+        chunk.resize(carried + got);
+
+        // Cut at row ends outside quotes once a piece reaches pieceBytes. A partial
+        // last row waits for the next chunk unless the file has ended.
+        vector<size_t> cuts{ 0 };
+        size_t lastRowEnd = 0;
+        bool inQuotes = false;
+        for (size_t i = 0; i < chunk.size(); i++) {
+            char c = chunk[i];
+            if (c == '"') inQuotes = !inQuotes;
+            else if (c == '\n' && !inQuotes) {
+                lastRowEnd = i + 1;
+                if (lastRowEnd - cuts.back() >= pieceBytes) cuts.push_back(lastRowEnd);
+            }
+        }
+        if (atEnd && inQuotes) throw runtime_error("Bad CSV file " + fileName + ": unterminated quoted field");
+        size_t complete = atEnd ? chunk.size() : lastRowEnd;
+        if (complete > cuts.back()) cuts.push_back(complete);
+
+        size_t pieceCount = cuts.size() - 1;
+        vector<SessionColumns> pieces(pieceCount);
+        vector<unique_ptr<CsvRowError>> errors(pieceCount);
+        sharedScheduler().parallelFor(WORK_LOADING, pieceCount, 1, [&](size_t first, size_t last) {
+            for (size_t k = first; k < last; k++) {
+                try { parseCsvRows(chunk.data() + cuts[k], chunk.data() + cuts[k + 1], pieces[k]); }
+                catch (const CsvRowError& e) { errors[k].reset(new CsvRowError(e)); }
+            }
+        });
+
+        for (size_t k = 0; k < pieceCount; k++) {
+            if (errors[k]) {
+                throw runtime_error("Bad CSV file " + fileName + ": row " + to_string(rowsBefore + errors[k]->row + 1) +
+                    ": " + errors[k]->message);
+            }
+            rowsBefore += pieces[k].size();
+            result.append(pieces[k]);
+        }
+
+        chunk.erase(0, complete);
+    }
+    return result;
+}
+
+// Like loadSessionsFromJson: all or nothing, returns how many sessions were added
+int loadSessionsFromCsv(const string& fileName, SessionContainer& manager) {
+    SessionColumns c = readSessionsCsv(fileName);
+    vector<unique_ptr<PlaySession>> loaded;
+    loaded.reserve(c.size());
+    for (size_t i = 0; i < c.size(); i++) {
+        loaded.emplace_back(makeSession(static_cast<SessionType>(c.type[i]), c.locations.name(c.locationId[i]), c.duration[i],
+            static_cast<Difficulty>(c.difficulty[i]), c.count[i], LootInfo(c.gold[i], c.rare[i] != 0)));
+    }
+    for (auto& s : loaded) manager.add(s.release());
+    return static_cast<int>(loaded.size());
+}
+
+
+// ================= MERGE =================
+// Combines session files from several machines into one ordered history. Every input
+// must already be in order: by "timestamp" (any integer clock, such as epoch
+// milliseconds) when its records carry one, otherwise by position, which interleaves
+// the inputs record by record. Equal keys come out in input order.
+//
+// SessionMerge is a SessionSource, so drainInto loads the merged history into a
+// SessionContainer and mergeSessionFiles writes it to a file. It picks the next session
+// with a loser tree: each internal node keeps the input that lost the match played
+// there, so replacing the winner replays only its leaf-to-root path, about log2(k)
+// comparisons for k inputs. Each input is read ahead by its own PrefetchSource thread,
+// so parsing and disk reads overlap across files. These are plain threads, not tasks on
+// the shared scheduler, because they block on I/O and on full buffers. Memory is O(k)
+// plus a read-ahead buffer of at most 2 * MERGE_PREFETCH sessions per input.
+
+const size_t MERGE_PREFETCH = 4096;
+
+// Reads another source ahead on a background thread. Sessions cross between the
+// threads in batches, one lock per batch rather than per session, and at most
+// two batches wait at a time. Errors from the inner source are rethrown by next() once
+// the sessions before them are taken.
+class PrefetchSource : public SessionSource {
+    struct Item {
+        unique_ptr<PlaySession> session;
+        long long key;
+        bool timestamped;
+    };
+
+    unique_ptr<SessionSource> inner;
+    size_t batchSize;
+    mutex lock;
+    condition_variable filled;      // a batch is ready or the reader finished
+    condition_variable drained;     // room for another batch, or stopping
+    deque<vector<Item>> batches;    // guarded by lock
+    bool finished = false;
+    bool stopping = false;
+    exception_ptr error;
+    vector<Item> current;           // consumer side only
+    size_t currentPos = 0;
+    thread reader;
+
+    bool hand(vector<Item>& batch) {
+        unique_lock<mutex> guard(lock);
+        drained.wait(guard, [this] { return stopping || batches.size() < 2; });
+        if (stopping) return false;
+        batches.push_back(move(batch));
+        filled.notify_one();
+        batch.clear();
+        return true;
+    }
+
+    void run() {
+        vector<Item> batch;
+        exception_ptr failure;
+        try {
+            while (unique_ptr<PlaySession> s = inner->next()) {
+                batch.push_back(Item{ move(s), inner->lastKey(), inner->lastTimestamped() });
+                if (batch.size() == batchSize && !hand(batch)) return;
+            }
+        }
+        catch (...) {
+            failure = current_exception();
+        }
+        if (!batch.empty() && !hand(batch)) return;     // sessions read before a failure still count
+
+        lock_guard<mutex> guard(lock);
+        error = failure;
+        finished = true;
+        filled.notify_one();
+    }
+
+public:
+    explicit PrefetchSource(unique_ptr<SessionSource> source, size_t bufferSessions = MERGE_PREFETCH)
+        : inner(move(source)), batchSize(max<size_t>(1, bufferSessions / 2)) {
+        reader = thread(&PrefetchSource::run, this);
+    }
+
+    // Stops the reader early and frees anything it read ahead
+    ~PrefetchSource() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        drained.notify_one();
+        reader.join();
+    }
+
+    unique_ptr<PlaySession> next() override {
+        if (currentPos == current.size()) {
+            unique_lock<mutex> guard(lock);
+            filled.wait(guard, [this] { return !batches.empty() || finished; });
+            if (batches.empty()) {
+                if (error) rethrow_exception(error);
+                return nullptr;
+            }
+            current = move(batches.front());
+            batches.pop_front();
+            currentPos = 0;
+            drained.notify_one();
+        }
+
+        Item& item = current[currentPos++];
+        keyAs(item.key, item.timestamped);
+        return move(item.session);
+    }
+};
+
+class SessionMerge : public SessionSource {
+    struct Input {
+        unique_ptr<SessionSource> source;
+        string name;
+        unique_ptr<PlaySession> head;   // next session from this input, null once it is done
+        long long key = 0;
+        bool timestamped = false;
+        long long taken = 0;
+    };
+
+    vector<Input> inputs;
+    vector<size_t> tree;        // tree[0] is the winner, tree[1..k-1] the loser at each node
+    size_t keySetter = SIZE_MAX;    // first input to yield a session; its key kind holds for all
+
+    // Whether input a's head comes out before input b's
+    bool before(size_t a, size_t b) const {
+        const Input& x = inputs[a];
+        const Input& y = inputs[b];
+        if (!x.head || !y.head) return x.head != nullptr;
+        if (x.key != y.key) return x.key < y.key;
+        return a < b;
+    }
+
+    void advance(size_t i) {
+        Input& in = inputs[i];
+        long long previous = in.key;
+        in.head = in.source->next();
+        if (!in.head) return;
+
+        // Timestamps and positions are not on one axis, so every key must be the same kind
+        bool timestamped = in.source->lastTimestamped();
+        if (in.taken > 0 && timestamped != in.timestamped)
+            throw runtime_error(in.name + " mixes timestamped and untimed sessions at session " + to_string(in.taken + 1));
+        if (in.taken == 0) {
+            if (keySetter == SIZE_MAX) keySetter = i;
+            else if (timestamped != inputs[keySetter].timestamped)
+                throw runtime_error(in.name + (timestamped ? " is keyed by timestamp but " : " is keyed by position but ")
+                    + inputs[keySetter].name + (timestamped ? " by position" : " by timestamp"));
+        }
+
+        in.key = in.source->lastKey();
+        in.timestamped = timestamped;
+        if (in.taken++ > 0 && in.key < previous)
+            throw runtime_error(in.name + " is out of order at session " + to_string(in.taken));
+    }
+
+    // Plays the matches under node and returns the winner. Leaves are k..2k-1.
+    size_t play(size_t node) {
+        size_t k = inputs.size();
+        if (node >= k) return node - k;
+        size_t left = play(2 * node);
+        size_t right = play(2 * node + 1);
+        if (before(left, right)) {
+            tree[node] = right;
+            return left;
+        }
+        tree[node] = left;
+        return right;
+    }
+
+    // Input i has a new head: replay its path to the root
+    void replay(size_t i) {
+        size_t winner = i;
+        for (size_t node = (inputs.size() + i) / 2; node >= 1; node /= 2) {
+            if (before(tree[node], winner)) swap(tree[node], winner);
+        }
+        tree[0] = winner;
+    }
+
+public:
+    // Each input is named in error messages; wrap it in a PrefetchSource to read ahead
+    void addInput(unique_ptr<SessionSource> source, const string& name) {
+        if (!tree.empty()) throw runtime_error("Inputs must be added before the merge starts");
+        Input in;
+        in.source = move(source);
+        in.name = name;
+        inputs.push_back(move(in));
+    }
+
+    size_t inputCount() const { return inputs.size(); }
+
+    unique_ptr<PlaySession> next() override {
+        if (inputs.empty()) return nullptr;
+        if (tree.empty()) {
+            for (size_t i = 0; i < inputs.size(); i++) advance(i);
+            tree.assign(inputs.size(), 0);
+            tree[0] = play(1);
+        }
+
+        size_t w = tree[0];
+        Input& in = inputs[w];
+        if (!in.head) return nullptr;
+
+        unique_ptr<PlaySession> s = move(in.head);
+        keyAs(in.key, in.timestamped);
+        advance(w);
+        replay(w);
+        return s;
+    }
+};
+
+// Opens every file with openSessionSource behind its own prefetch thread
+unique_ptr<SessionMerge> openSessionMerge(const vector<string>& fileNames) {
+    unique_ptr<SessionMerge> merge(new SessionMerge());
+    for (const string& name : fileNames)
+        merge->addInput(unique_ptr<SessionSource>(new PrefetchSource(openSessionSource(name))), name);
+    return merge;
+}
+
+// Writes the merge of the inputs to output: .csv, .jsonl / .ndjson, .bgsw, or a JSON
+// array for anything else. JSON output keeps the "timestamp" of sessions that had one;
+// the other formats have no field for it and keep only the merged order. Returns how
+// many sessions were written.
+long long mergeSessionFiles(const vector<string>& inputs, const string& output) {
+    string ext = filesystem::path(output).extension().string();
+    unique_ptr<SessionMerge> merge = openSessionMerge(inputs);
+    long long written = 0;
+
+    if (ext == ".bgsw") {
+        WireFileWriter writer(output);
+        while (unique_ptr<PlaySession> s = merge->next()) {
+            writer.add(*s);
+            written++;
+        }
+        writer.finish();
+        return written;
+    }
+
+    if (ext == ".csv") {
+        CsvSessionWriter writer(output);
+        while (unique_ptr<PlaySession> s = merge->next()) {
+            writer.write(*s);
+            written++;
+        }
+        writer.flush();
+        return written;
+    }
+
+    bool lines = ext == ".jsonl" || ext == ".ndjson";
+    ofstream outFile(output, ios::binary);
+    if (!outFile) throw runtime_error("Could not write " + output);
+    if (!lines) outFile << "[\n";
+    while (unique_ptr<PlaySession> s = merge->next()) {
+        json j = sessionToJson(*s);
+        if (merge->lastTimestamped()) j["timestamp"] = merge->lastKey();
+        if (!lines && written > 0) outFile << ",\n";
+        outFile << j.dump();
+        if (lines) outFile << '\n';
+        written++;
+    }
+    if (!lines) outFile << "\n]\n";
+    outFile.close();
+    if (!outFile) throw runtime_error("Could not write " + output);
+    return written;
+}
+
+// --merge <output> <input>...: entry point, returns the process exit code
+int runMergeCommand(const vector<string>& args) {
+    try {
+        if (args.size() < 2) throw runtime_error("Usage: --merge <output> <input>...");
+        auto start = chrono::steady_clock::now();
+        long long written = mergeSessionFiles(vector<string>(args.begin() + 1, args.end()), args[0]);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Merged " << written << " sessions from " << args.size() - 1 << " file(s) into " << args[0] << " in "
+            << fixed << setprecision(2) << seconds << " s\n" << defaultfloat;
+        return 0;
+    }
+    catch (const runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ================= REPORT =================
+// Writes report.txt as fixed-capacity sections: one for the character header and one
+// per session. A binary sidecar (report.txt.idx) records each section's offset,
+// capacity and content hash. A save renders only the sessions the container reports
+// as changed (plus the header), and rewrites only sections whose text differs, in
+// place when the new text fits. Appending a session writes one section, editing one
+// rewrites one, and removing session i rewrites the sections after i because their
+// numbers shift.
+//
+// The writer consumes the container's change tracking, so use one writer per container.
+
+struct ReportSaveStats {
+    int sectionsWritten = 0;
+    long long bytesWritten = 0;
+    bool fullRewrite = false;
+};
+
+class ReportWriter {
+    struct Section {
+        uint64_t offset;
+        uint64_t capacity;
+        uint64_t hash;
+    };
+
+    static const size_t INDEX_HEADER_SIZE = 16;
+    static const size_t INDEX_ENTRY_SIZE = 24;
+    static const size_t REPORT_RENDER_GRAIN = 256;
+
+    string reportPath;
+    string indexPath;
+    vector<Section> sections;       // [0] is the header, [i + 1] is session i
+    bool indexLoaded = false;
+
+public:
+    // The same text as report.txt, also served by the HTTP API
+    static string renderHeader(const Character& c) {
+        ostringstream os;
+        os << "Adventure Report\n\n";
+        os << "Character: " << c.name << endl;
+        os << "Level: " << c.level << endl;
+        os << fixed << setprecision(2);
+        os << "Gold: " << c.gold << "\n\n";
+        return os.str();
+    }
+
+    static string renderSession(int index, const PlaySession& s) {
+        ostringstream os;
+        os << "Session #" << index << ":\n";
+        s.print(os);
+        os << "\n";
+        return os.str();
+    }
+
+private:
+    // Room to grow in place before a section has to move
+    static uint64_t capacityFor(size_t textSize) { return (textSize + 32 + 63) / 64 * 64; }
+
+    // Text followed by a line of spaces that fills the rest of the section
+    static string padded(const string& text, uint64_t capacity) {
+        string out = text;
+        if (capacity > text.size()) {
+            out.append(static_cast<size_t>(capacity - text.size() - 1), ' ');
+            out += '\n';
+        }
+        return out;
+    }
+
+    // Reads the sidecar once. Any mismatch with the report file means a full rewrite.
+    void loadIndex() {
+        indexLoaded = true;
+        sections.clear();
+
+        ifstream idx(indexPath, ios::binary);
+        error_code ec;
+        uint64_t reportSize = filesystem::file_size(reportPath, ec);
+        if (!idx || ec) return;
+
+        char header[INDEX_HEADER_SIZE];
+        if (!idx.read(header, INDEX_HEADER_SIZE) || memcmp(header, "BGRI", 4) != 0) return;
+
+        vector<Section> loaded(static_cast<size_t>(loadLE64(header + 8)));
+        uint64_t expectedOffset = 0;
+        for (Section& sec : loaded) {
+            char entry[INDEX_ENTRY_SIZE];
+            if (!idx.read(entry, INDEX_ENTRY_SIZE)) return;
+            sec.offset = loadLE64(entry);
+            sec.capacity = loadLE64(entry + 8);
+            sec.hash = loadLE64(entry + 16);
+            if (sec.offset != expectedOffset) return;
+            expectedOffset += sec.capacity;
+        }
+        if (expectedOffset != reportSize) return;
+
+        sections = move(loaded);
+    }
+
+    void writeIndexEntry(fstream& idx, size_t i) {
+        char entry[INDEX_ENTRY_SIZE];
+        storeLE64(entry, sections[i].offset);
+        storeLE64(entry + 8, sections[i].capacity);
+        storeLE64(entry + 16, sections[i].hash);
+        idx.seekp(static_cast<streamoff>(INDEX_HEADER_SIZE + i * INDEX_ENTRY_SIZE));
+        idx.write(entry, INDEX_ENTRY_SIZE);
+    }
+
+    static void ensureFileExists(const string& path) {
+        if (!filesystem::exists(path)) ofstream(path, ios::binary).close();
+    }
+
+public:
+    explicit ReportWriter(const string& path = "report.txt")
+        : reportPath(path), indexPath(path + ".idx") {}
+
+    ReportSaveStats save(const Character& c, SessionContainer& manager) {
+        if (!indexLoaded) loadIndex();
+
+        ReportSaveStats stats;
+        int n = manager.size();
+        size_t oldSections = sections.size();
+        stats.fullRewrite = oldSections == 0;
+
+        ensureFileExists(reportPath);
+        ensureFileExists(indexPath);
+        fstream out(reportPath, ios::in | ios::out | ios::binary);
+        fstream idx(indexPath, ios::in | ios::out | ios::binary);
+        if (!out || !idx) throw runtime_error("Could not write " + reportPath);
+
+        // Sections from here on are laid out back to back again after a section outgrows
+        // its slot; everything before it stays where it is
+        size_t relayoutFrom = sections.size() + 1;
+
+        auto place = [&](size_t i, const string& text) {
+            uint64_t hash = fnv1a64(text.data(), text.size());
+            if (i < sections.size() && i < relayoutFrom) {
+                if (sections[i].hash == hash) return;
+                if (text.size() <= sections[i].capacity) {
+                    string body = padded(text, sections[i].capacity);
+                    out.seekp(static_cast<streamoff>(sections[i].offset));
+                    out.write(body.data(), static_cast<streamsize>(body.size()));
+                    sections[i].hash = hash;
+                    writeIndexEntry(idx, i);
+                    stats.sectionsWritten++;
+                    stats.bytesWritten += static_cast<long long>(body.size());
+                    return;
+                }
+                relayoutFrom = i;
+            }
+
+            uint64_t offset = i == 0 ? 0 : sections[i - 1].offset + sections[i - 1].capacity;
+            Section sec = { offset, capacityFor(text.size()), hash };
+            if (i < sections.size()) sections[i] = sec;
+            else sections.push_back(sec);
+
+            string body = padded(text, sec.capacity);
+            out.seekp(static_cast<streamoff>(offset));
+            out.write(body.data(), static_cast<streamsize>(body.size()));
+            writeIndexEntry(idx, i);
+            stats.sectionsWritten++;
+            stats.bytesWritten += static_cast<long long>(body.size());
+        };
+
+        place(0, renderHeader(c));
+
+        // Edited sessions that did not move, then everything from the first moved index.
+        // Sessions past the old section count are always new.
+        vector<int> edited = manager.editedIndices();
+        sort(edited.begin(), edited.end());
+        int from = min(manager.firstChangedIndex(), n);
+        if (oldSections == 0) from = 0;
+        else from = min(from, static_cast<int>(oldSections) - 1);
+
+        // Render the sessions known to need rewriting up front, in parallel. Ones that only
+        // need it because an earlier section moved are rendered as they come up.
+        vector<pair<int, const PlaySession*>> due;
+        size_t nextEdit = 0;
+        int index = 0;
+        for (auto it = manager.begin(); it != manager.end(); ++it, index++) {
+            while (nextEdit < edited.size() && edited[nextEdit] < index) nextEdit++;
+            if (index >= from || (nextEdit < edited.size() && edited[nextEdit] == index))
+                due.emplace_back(index, &*it);
+            else if (from >= n && nextEdit == edited.size())
+                break;
+        }
+        vector<string> rendered(due.size());
+        sharedScheduler().parallelFor(WORK_REPORTING, due.size(), REPORT_RENDER_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) rendered[k] = renderSession(due[k].first, *due[k].second);
+        });
+
+        size_t nextDue = 0;
+        index = 0;
+        for (auto it = manager.begin(); it != manager.end(); ++it, index++) {
+            size_t section = static_cast<size_t>(index) + 1;
+            if (nextDue < due.size() && due[nextDue].first == index)
+                place(section, rendered[nextDue++]);
+            else if (section >= relayoutFrom)
+                place(section, renderSession(index, *it));
+            else if (nextDue == due.size())
+                break;      // nothing left to rewrite
+        }
+
+        // Drop sections for sessions that no longer exist
+        sections.resize(static_cast<size_t>(n) + 1);
+        uint64_t end = sections.back().offset + sections.back().capacity;
+
+        char header[INDEX_HEADER_SIZE] = { 'B', 'G', 'R', 'I' };
+        storeLE64(header + 8, sections.size());
+        idx.seekp(0);
+        idx.write(header, INDEX_HEADER_SIZE);
+
+        out.close();
+        idx.close();
+        if (!out || !idx) throw runtime_error("Could not write " + reportPath);
+        filesystem::resize_file(reportPath, end);
+        filesystem::resize_file(indexPath, INDEX_HEADER_SIZE + sections.size() * INDEX_ENTRY_SIZE);
+
+        manager.clearChanges();
+        return stats;
+    }
+};
+
+
+// ================= LOCATION INDEX =================
+// Sorted string table (.bgsi) that maps each location in a .bgsw data file to the byte
+// offsets of its records, for lookups over histories that do not fit in memory.
+//
+//   header     "BGSI", u16 version, u16 reserved, u32 data checksum (copied from the
+//              wire header, to spot a stale index), u32 directory checksum,
+//              u64 data record count, u64 block count, u64 directory offset,
+//              u64 directory size
+//   blocks     entries in ascending key order: varint key length, key bytes,
+//              varint record count, then record numbers as varint deltas
+//   directory  per block: u64 offset, u32 size, u32 checksum, u32 bloom size,
+//              varint first-key length, first key, bloom filter bits
+//
+// Opening an index loads only the header and the directory. A lookup binary-searches
+// the first keys for the one block that could hold the location, asks that block's
+// bloom filter, and reads the block only on a hit: one read, and none for most
+// locations that are not there. Building keeps 16 bytes per record in memory for the sort.
+
+const uint16_t LOCATION_INDEX_VERSION = 1;
+const size_t LOCATION_INDEX_HEADER_SIZE = 48;
+const size_t LOCATION_INDEX_BLOCK_BYTES = 4096;
+const unsigned LOCATION_BLOOM_BITS_PER_KEY = 10;
+const unsigned LOCATION_BLOOM_PROBES = 7;
+
+// Double hashing over one 64-bit hash, as in Kirsch and Mitzenmacher
+class LocationBloom {
+public:
+    static void add(string& bits, string_view key) {
+        uint64_t h = fnv1a64(key.data(), key.size());
+        uint64_t m = bits.size() * 8;
+        for (unsigned i = 0; i < LOCATION_BLOOM_PROBES; i++) {
+            uint64_t bit = (h + i * ((h >> 33) | 1)) % m;
+            bits[bit / 8] = static_cast<char>(bits[bit / 8] | (1 << (bit % 8)));
+        }
+    }
+
+    static bool mayContain(string_view bits, string_view key) {
+        if (bits.empty()) return true;
+        uint64_t h = fnv1a64(key.data(), key.size());
+        uint64_t m = bits.size() * 8;
+        for (unsigned i = 0; i < LOCATION_BLOOM_PROBES; i++) {
+            uint64_t bit = (h + i * ((h >> 33) | 1)) % m;
+            if ((bits[bit / 8] & (1 << (bit % 8))) == 0) return false;
+        }
+        return true;
+    }
+};
+
+
+// Builds indexFile for dataFile, streaming the records. Throws runtime_error if the
+// data file is unreadable or fails its checksum.
+void buildLocationIndex(const string& dataFile, const string& indexFile) {
+    ifstream in(dataFile, ios::binary);
+    if (!in) throw runtime_error("Could not open " + dataFile);
+    char header[WIRE_HEADER_SIZE];
+    readWireFileHeader(in, header);
+    uint64_t count = loadLE64(header + 8);
+
+    string strings(static_cast<size_t>(loadLE64(header + 24)), '\0');
+    in.seekg(static_cast<streamoff>(loadLE64(header + 16)));
+    if (!in.read(&strings[0], static_cast<streamsize>(strings.size())))
+        throw runtime_error("Session wire file is truncated");
+    in.seekg(static_cast<streamoff>(WIRE_HEADER_SIZE));
+
+    // Location offset << 32 | length for every record, checked against the file checksum
+    vector<uint64_t> locations;
+    locations.reserve(static_cast<size_t>(count));
+    WireChecksum sum;
+    vector<char> chunk(WIRE_RECORD_SIZE * 4096);
+    for (uint64_t done = 0; done < count;) {
+        size_t records = static_cast<size_t>(min<uint64_t>(count - done, chunk.size() / WIRE_RECORD_SIZE));
+        if (!in.read(chunk.data(), static_cast<streamsize>(records * WIRE_RECORD_SIZE)))
+            throw runtime_error("Session wire file is truncated");
+        sum.update(chunk.data(), records * WIRE_RECORD_SIZE);
+        for (size_t r = 0; r < records; r++) {
+            const char* rec = chunk.data() + r * WIRE_RECORD_SIZE;
+            if (uint64_t(loadLE32(rec)) + loadLE32(rec + 4) > strings.size())
+                throw runtime_error("Session wire location out of bounds");
+            locations.push_back(uint64_t(loadLE32(rec)) << 32 | loadLE32(rec + 4));
+        }
+        done += records;
+    }
+    sum.update(strings.data(), strings.size());
+    if (sum.value() != loadLE32(header + 32)) throw runtime_error("Session wire checksum mismatch");
+
+    // Rank the distinct names so equal text stored twice still shares one key
+    vector<uint64_t> distinct(locations);
+    parallelSort(WORK_SORTING, distinct.begin(), distinct.end());
+    distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+    auto text = [&](uint64_t loc) { return string_view(strings.data() + (loc >> 32), static_cast<size_t>(loc & 0xFFFFFFFFu)); };
+    vector<uint64_t> byText(distinct);
+    parallelSort(WORK_SORTING, byText.begin(), byText.end(), [&](uint64_t a, uint64_t b) { return text(a) < text(b); });
+    unordered_map<uint64_t, uint64_t> rank;
+    uint64_t nextRank = 0;
+    for (size_t i = 0; i < byText.size(); i++) {
+        if (i > 0 && text(byText[i]) != text(byText[i - 1])) nextRank++;
+        rank[byText[i]] = nextRank;
+    }
+
+    vector<pair<uint64_t, uint64_t>> postings;     // (key rank, record number)
+    postings.reserve(locations.size());
+    for (size_t i = 0; i < locations.size(); i++) postings.emplace_back(rank[locations[i]], i);
+    vector<uint64_t>().swap(locations);
+    parallelSort(WORK_SORTING, postings.begin(), postings.end());
+
+    vector<string_view> keyOfRank(byText.empty() ? 0 : static_cast<size_t>(nextRank) + 1);
+    for (uint64_t loc : byText) keyOfRank[static_cast<size_t>(rank[loc])] = text(loc);
+
+    ofstream out(indexFile, ios::binary);
+    if (!out) throw runtime_error("Could not write " + indexFile);
+    out.write(string(LOCATION_INDEX_HEADER_SIZE, '\0').data(), LOCATION_INDEX_HEADER_SIZE);
+
+    string directory, block, bloom;
+    uint64_t blocks = 0;
+    uint64_t offset = LOCATION_INDEX_HEADER_SIZE;
+    vector<string_view> blockKeys;
+    auto flush = [&]() {
+        if (blockKeys.empty()) return;
+        bloom.assign((blockKeys.size() * LOCATION_BLOOM_BITS_PER_KEY + 7) / 8, '\0');
+        for (string_view key : blockKeys) LocationBloom::add(bloom, key);
+
+        WireChecksum blockSum;
+        blockSum.update(block.data(), block.size());
+        char fixed[20];
+        storeLE64(fixed, offset);
+        storeLE32(fixed + 8, static_cast<uint32_t>(block.size()));
+        storeLE32(fixed + 12, blockSum.value());
+        storeLE32(fixed + 16, static_cast<uint32_t>(bloom.size()));
+        directory.append(fixed, sizeof(fixed));
+        putVarint(directory, static_cast<uint32_t>(blockKeys.front().size()));
+        directory.append(blockKeys.front().data(), blockKeys.front().size());
+        directory += bloom;
+
+        out.write(block.data(), static_cast<streamsize>(block.size()));
+        offset += block.size();
+        blocks++;
+        block.clear();
+        blockKeys.clear();
+    };
+
+    // A key's postings never straddle blocks, so one block read answers a lookup
+    for (size_t i = 0; i < postings.size();) {
+        size_t end = i;
+        while (end < postings.size() && postings[end].first == postings[i].first) end++;
+
+        string_view key = keyOfRank[static_cast<size_t>(postings[i].first)];
+        string entry;
+        putVarint(entry, static_cast<uint32_t>(key.size()));
+        entry.append(key.data(), key.size());
+        putVarint(entry, static_cast<uint32_t>(end - i));
+        uint64_t previous = 0;
+        for (size_t j = i; j < end; j++) {
+            uint64_t delta = postings[j].second - previous;
+            if (delta > 0xFFFFFFFFu) throw runtime_error("Session wire file is too large to index");
+            putVarint(entry, static_cast<uint32_t>(delta));
+            previous = postings[j].second;
+        }
+
+        if (!block.empty() && block.size() + entry.size() > LOCATION_INDEX_BLOCK_BYTES) flush();
+        block += entry;
+        blockKeys.push_back(key);
+        i = end;
+    }
+    flush();
+    out.write(directory.data(), static_cast<streamsize>(directory.size()));
+
+    WireChecksum dirSum;
+    dirSum.update(directory.data(), directory.size());
+    char head[LOCATION_INDEX_HEADER_SIZE];
+    memcpy(head, "BGSI", 4);
+    storeLE16(head + 4, LOCATION_INDEX_VERSION);
+    storeLE16(head + 6, 0);
+    storeLE32(head + 8, loadLE32(header + 32));
+    storeLE32(head + 12, dirSum.value());
+    storeLE64(head + 16, count);
+    storeLE64(head + 24, blocks);
+    storeLE64(head + 32, offset);
+    storeLE64(head + 40, directory.size());
+    out.seekp(0);
+    out.write(head, LOCATION_INDEX_HEADER_SIZE);
+    if (!out) throw runtime_error("Failed writing " + indexFile);
+}
+
+// Random access to single records of a wire file, without reading the rest
+class WireRecordFile {
+    ifstream in;
+    uint64_t count;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint32_t checksum;
+
+public:
+    explicit WireRecordFile(const string& fileName) : in(fileName, ios::binary) {
+        if (!in) throw runtime_error("Could not open " + fileName);
+        char header[WIRE_HEADER_SIZE];
+        readWireFileHeader(in, header);
+        count = loadLE64(header + 8);
+        stringsOffset = loadLE64(header + 16);
+        stringsSize = loadLE64(header + 24);
+        checksum = loadLE32(header + 32);
+    }
+
+    uint64_t size() const { return count; }
+    uint32_t dataChecksum() const { return checksum; }
+
+    // Reads the record that starts at a byte offset from a LocationIndex
+    unique_ptr<PlaySession> readAt(uint64_t offset) {
+        if (offset < WIRE_HEADER_SIZE || (offset - WIRE_HEADER_SIZE) % WIRE_RECORD_SIZE != 0 ||
+            (offset - WIRE_HEADER_SIZE) / WIRE_RECORD_SIZE >= count)
+            throw runtime_error("Not a record offset: " + to_string(offset));
+
+        char rec[WIRE_RECORD_SIZE];
+        in.seekg(static_cast<streamoff>(offset));
+        if (!in.read(rec, WIRE_RECORD_SIZE)) throw runtime_error("Session wire file is truncated");
+        if (!wireRecordValid(rec, stringsSize)) throw runtime_error("Session wire record is corrupt");
+
+        string loc(loadLE32(rec + 4), '\0');
+        in.seekg(static_cast<streamoff>(stringsOffset + loadLE32(rec)));
+        if (!loc.empty() && !in.read(&loc[0], static_cast<streamsize>(loc.size())))
+            throw runtime_error("Session wire file is truncated");
+
+        storeLE32(rec, 0);      // the location now starts at loc[0]
+        return unique_ptr<PlaySession>(WireRecordView(rec, loc.data()).toSession());
+    }
+};
+
+class LocationIndex {
+    struct BlockRef {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t checksum;
+        string firstKey;
+        string bloom;
+    };
+
+    ifstream in;
+    vector<BlockRef> blocks;
+    uint64_t records;
+    uint32_t checksum;
+    uint64_t reads = 0;
+
+public:
+    // Loads the header and directory. Throws runtime_error if the index is damaged.
+    explicit LocationIndex(const string& indexFile) : in(indexFile, ios::binary) {
+        if (!in) throw runtime_error("Could not open " + indexFile);
+        char head[LOCATION_INDEX_HEADER_SIZE];
+        if (!in.read(head, LOCATION_INDEX_HEADER_SIZE) || memcmp(head, "BGSI", 4) != 0)
+            throw runtime_error("Not a location index");
+        if (loadLE16(head + 4) != LOCATION_INDEX_VERSION)
+            throw runtime_error("Unsupported location index version " + to_string(loadLE16(head + 4)));
+        checksum = loadLE32(head + 8);
+        records = loadLE64(head + 16);
+        uint64_t blockCount = loadLE64(head + 24);
+
+        // The checksum only covers the directory, so bound it by the file size before sizing it
+        uint64_t fileSize = filesystem::file_size(indexFile);
+        uint64_t directoryOffset = loadLE64(head + 32);
+        uint64_t directorySize = loadLE64(head + 40);
+        if (directoryOffset < LOCATION_INDEX_HEADER_SIZE || directoryOffset > fileSize ||
+            directorySize != fileSize - directoryOffset)
+            throw runtime_error("Location index is truncated");
+
+        string directory(static_cast<size_t>(directorySize), '\0');
+        in.seekg(static_cast<streamoff>(directoryOffset));
+        if (!in.read(&directory[0], static_cast<streamsize>(directory.size())))
+            throw runtime_error("Location index is truncated");
+        WireChecksum sum;
+        sum.update(directory.data(), directory.size());
+        if (sum.value() != loadLE32(head + 12)) throw runtime_error("Location index checksum mismatch");
+
+        const char* p = directory.data();
+        const char* end = p + directory.size();
+        for (uint64_t b = 0; b < blockCount; b++) {
+            BlockRef ref;
+            if (end - p < 20) throw runtime_error("Location index is truncated");
+            ref.offset = loadLE64(p);
+            ref.size = loadLE32(p + 8);
+            ref.checksum = loadLE32(p + 12);
+            uint32_t bloomSize = loadLE32(p + 16);
+            if (ref.offset < LOCATION_INDEX_HEADER_SIZE || ref.offset > directoryOffset || ref.size > directoryOffset - ref.offset)
+                throw runtime_error("Location index is corrupt");
+            p += 20;
+            uint32_t keyLength = getVarint(p, end);
+            if (static_cast<uint64_t>(end - p) < uint64_t(keyLength) + bloomSize)
+                throw runtime_error("Location index is truncated");
+            ref.firstKey.assign(p, keyLength);
+            ref.bloom.assign(p + keyLength, bloomSize);
+            p += keyLength + bloomSize;
+            blocks.push_back(move(ref));
+        }
+    }
+
+    uint64_t recordCount() const { return records; }
+    uint32_t dataChecksum() const { return checksum; }
+    size_t blockCount() const { return blocks.size(); }
+    uint64_t blockReads() const { return reads; }      // disk reads made by find() so far
+
+    // Byte offsets in the data file of every record at loc, in file order
+    vector<uint64_t> find(const string& loc) {
+        vector<uint64_t> offsets;
+        auto after = upper_bound(blocks.begin(), blocks.end(), loc,
+            [](const string& key, const BlockRef& b) { return key < b.firstKey; });
+        if (after == blocks.begin()) return offsets;
+        const BlockRef& ref = *(after - 1);
+        if (!LocationBloom::mayContain(ref.bloom, loc)) return offsets;
+
+        string block(ref.size, '\0');
+        in.clear();
+        in.seekg(static_cast<streamoff>(ref.offset));
+        reads++;
+        if (!in.read(&block[0], static_cast<streamsize>(block.size()))) throw runtime_error("Location index is truncated");
+        WireChecksum sum;
+        sum.update(block.data(), block.size());
+        if (sum.value() != ref.checksum) throw runtime_error("Location index block checksum mismatch");
+
+        const char* p = block.data();
+        const char* end = p + block.size();
+        while (p < end) {
+            uint32_t keyLength = getVarint(p, end);
+            if (static_cast<size_t>(end - p) < keyLength) throw runtime_error("Location index block is corrupt");
+            int order = string_view(p, keyLength).compare(loc);
+            p += keyLength;
+            uint32_t n = getVarint(p, end);
+            if (order > 0) break;
+
+            uint64_t record = 0;
+            for (uint32_t i = 0; i < n; i++) {
+                record += getVarint(p, end);
+                if (order == 0) offsets.push_back(WIRE_HEADER_SIZE + record * WIRE_RECORD_SIZE);
+            }
+            if (order == 0) break;
+        }
+        return offsets;
+    }
+};
+
+// Sessions at loc, read from the data file through its index. Throws runtime_error if
+// the index was built from a different version of the data file.
+vector<unique_ptr<PlaySession>> findSessionsByLocation(LocationIndex& index, WireRecordFile& data, const string& loc) {
+    if (index.dataChecksum() != data.dataChecksum() || index.recordCount() != data.size())
+        throw runtime_error("Location index is stale for this data file");
+
+    vector<unique_ptr<PlaySession>> found;
+    for (uint64_t offset : index.find(loc)) found.push_back(data.readAt(offset));
+    return found;
+}
+
+
+// --index <data.bgsw> writes data.bgsi next to it; --find <data.bgsw> <location> prints
+// the matching sessions through that index. Returns the process exit code.
+int runIndexCommand(const string& command, const vector<string>& args) {
+    try {
+        if (args.empty() || (command == "--find" && args.size() < 2))
+            throw runtime_error("Usage: --index <data.bgsw> | --find <data.bgsw> <location>");
+        string indexFile = filesystem::path(args[0]).replace_extension(".bgsi").string();
+
+        if (command == "--index") {
+            buildLocationIndex(args[0], indexFile);
+            cout << "Wrote " << indexFile << "\n";
+            return 0;
+        }
+
+        LocationIndex index(indexFile);
+        WireRecordFile data(args[0]);
+        auto found = findSessionsByLocation(index, data, args[1]);
+        for (const auto& session : found) session->print();
+        cout << found.size() << " session(s) at " << args[1] << "\n";
+        return 0;
+    }
+    catch (const runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ================= HTTP API =================
+// A small HTTP/1.1 JSON API so other local tools can add and query sessions:
+//
+//   GET  /health                            {"status":"ok","sessions":N}
+//   POST /sessions                          body: one session object or an array of them
+//   GET  /sessions?location=X&filter=E&limit=N
+//   GET  /aggregates?filter=E               totals, optionally over a filter expression
+//   GET  /report                            report.txt text for every session
+//
+// Request parsing, routing and response formatting are plain functions over strings
+// and build everywhere. HttpServer, the socket side, is Linux only: one thread runs a
+// non-blocking epoll loop bound to 127.0.0.1 that reads, parses and writes every
+// connection, and queries that scan the sessions go to a WorkerPool. Connections are
+// kept alive and requests may be pipelined; replies always leave in request order,
+// because each request gets a slot in its connection's queue and only finished slots
+// at the front of the queue are written.
+
+const size_t HTTP_MAX_HEAD_BYTES = 16 * 1024;
+const size_t HTTP_MAX_BODY_BYTES = 8 * 1024 * 1024;
+const size_t HTTP_MAX_PIPELINED = 64;            // per connection; reading pauses beyond this
+const size_t HTTP_MAX_UNSENT_BYTES = 1 << 20;    // replies the client has not taken yet
+
+// A request the client got wrong; status is the HTTP status to answer with
+struct HttpError : runtime_error {
+    int status;
+    HttpError(int code, const string& message) : runtime_error(message), status(code) {}
+};
+
+const char* httpStatusText(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 505: return "HTTP Version Not Supported";
+    }
+    return "Unknown";
+}
+
+inline bool equalsIgnoreCase(string_view a, string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) return false;
+    return true;
+}
+
+// Value of the named header in a block of "Name: value" lines, or an empty view
+string_view httpHeader(string_view headers, string_view name) {
+    while (!headers.empty()) {
+        size_t lineEnd = headers.find("\r\n");
+        string_view line = headers.substr(0, lineEnd);
+        headers = lineEnd == string_view::npos ? string_view() : headers.substr(lineEnd + 2);
+
+        size_t colon = line.find(':');
+        if (colon == string_view::npos || !equalsIgnoreCase(line.substr(0, colon), name)) continue;
+        string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+        return value;
+    }
+    return string_view();
+}
+
+// Decodes %XX escapes and '+' as in a query string
+string urlDecode(string_view text) {
+    auto hexValue = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+
+    string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '+') out += ' ';
+        else if (text[i] != '%') out += text[i];
+        else {
+            int high = i + 2 < text.size() ? hexValue(text[i + 1]) : -1;
+            int low = high >= 0 ? hexValue(text[i + 2]) : -1;
+            if (low < 0) throw HttpError(400, "Bad percent escape in query");
+            out += static_cast<char>(high * 16 + low);
+            i += 2;
+        }
+    }
+    return out;
+}
+
+struct HttpRequest {
+    string method;
+    string path;
+    string query;       // raw text after '?'
+    string body;
+    bool keepAlive = true;
+
+    // Looks up a query parameter; returns false if it is absent
+    bool param(string_view name, string& value) const {
+        string_view rest = query;
+        while (!rest.empty()) {
+            size_t amp = rest.find('&');
+            string_view pair = rest.substr(0, amp);
+            rest = amp == string_view::npos ? string_view() : rest.substr(amp + 1);
+
+            size_t eq = pair.find('=');
+            if (urlDecode(pair.substr(0, eq)) != name) continue;
+            value = eq == string_view::npos ? string() : urlDecode(pair.substr(eq + 1));
+            return true;
+        }
+        return false;
+    }
+};
+
+// Incremental request parser for one connection. feed() bytes as they arrive, then call
+// next() until it returns false; several pipelined requests can come out of one read.
+// Throws HttpError for a malformed request, after which the connection should close.
+class HttpRequestParser {
+    string buffer;
+    size_t pos = 0;     // start of the first request not yet returned
+
+public:
+    void feed(const char* data, size_t n) { buffer.append(data, n); }
+
+    size_t buffered() const { return buffer.size() - pos; }
+
+    bool next(HttpRequest& out) {
+        string_view data(buffer.data() + pos, buffer.size() - pos);
+        size_t headEnd = data.find("\r\n\r\n");
+        if (headEnd == string_view::npos) {
+            if (data.size() > HTTP_MAX_HEAD_BYTES) throw HttpError(431, "Request headers are too large");
+            return false;
+        }
+        if (headEnd > HTTP_MAX_HEAD_BYTES) throw HttpError(431, "Request headers are too large");
+
+        string_view head = data.substr(0, headEnd);
+        size_t lineEnd = head.find("\r\n");
+        string_view line = head.substr(0, lineEnd);
+        string_view headers = lineEnd == string_view::npos ? string_view() : head.substr(lineEnd + 2);
+
+        size_t sp1 = line.find(' ');
+        size_t sp2 = sp1 == string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+        if (sp2 == string_view::npos || sp1 == 0 || sp2 == sp1 + 1 || line.find(' ', sp2 + 1) != string_view::npos)
+            throw HttpError(400, "Malformed request line");
+        string_view version = line.substr(sp2 + 1);
+        if (version != "HTTP/1.1" && version != "HTTP/1.0") throw HttpError(505, "Only HTTP/1.0 and HTTP/1.1 are supported");
+        string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        if (target.front() != '/') throw HttpError(400, "Request target must be a path");
+
+        if (!httpHeader(headers, "Transfer-Encoding").empty())
+            throw HttpError(501, "Chunked request bodies are not supported");
+        size_t length = 0;
+        string_view lengthText = httpHeader(headers, "Content-Length");
+        if (!lengthText.empty()) {
+            auto r = from_chars(lengthText.data(), lengthText.data() + lengthText.size(), length);
+            if (r.ec != errc() || r.ptr != lengthText.data() + lengthText.size()) throw HttpError(400, "Bad Content-Length");
+            if (length > HTTP_MAX_BODY_BYTES) throw HttpError(413, "Request body is too large");
+        }
+        size_t total = headEnd + 4 + length;
+        if (data.size() < total) return false;
+
+        out.method.assign(line.data(), sp1);
+        size_t question = target.find('?');
+        out.path.assign(target.substr(0, question));
+        out.query.assign(question == string_view::npos ? string_view() : target.substr(question + 1));
+        out.body.assign(data.data() + headEnd + 4, length);
+        string_view connection = httpHeader(headers, "Connection");
+        out.keepAlive = version == "HTTP/1.1" ? !equalsIgnoreCase(connection, "close") : equalsIgnoreCase(connection, "keep-alive");
+
+        pos += total;
+        if (pos == buffer.size()) { buffer.clear(); pos = 0; }
+        else if (pos >= 64 * 1024) { buffer.erase(0, pos); pos = 0; }
+        return true;
+    }
+};
+
+string httpResponse(int status, const char* contentType, string_view body, bool keepAlive) {
+    string out = "HTTP/1.1 ";
+    appendInt(out, status);
+    out += ' ';
+    out += httpStatusText(status);
+    out += "\r\nContent-Type: ";
+    out += contentType;
+    out += "\r\nContent-Length: ";
+    appendInt(out, static_cast<long long>(body.size()));
+    out += keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    out += body;
+    return out;
+}
+
+// Length of the first complete response in data, or 0 if more bytes are needed.
+// Responses without a Content-Length are not supported.
+size_t httpResponseLength(string_view data) {
+    size_t headEnd = data.find("\r\n\r\n");
+    if (headEnd == string_view::npos) return 0;
+    string_view headers = data.substr(0, headEnd);
+    size_t lineEnd = headers.find("\r\n");
+    headers = lineEnd == string_view::npos ? string_view() : headers.substr(lineEnd + 2);
+    string_view lengthText = httpHeader(headers, "Content-Length");
+    size_t length = 0;
+    from_chars(lengthText.data(), lengthText.data() + lengthText.size(), length);
+    size_t total = headEnd + 4 + length;
+    return data.size() >= total ? total : 0;
+}
+
+// Status code of a response, or 0 if the status line is malformed
+int httpStatusOf(string_view response) {
+    int status = 0;
+    if (response.size() < 12 || response.compare(0, 5, "HTTP/") != 0) return 0;
+    from_chars(response.data() + 9, response.data() + 12, status);
+    return status;
+}
+
+// Fixed set of threads draining one FIFO of jobs. The destructor runs every queued job
+// before joining.
+class WorkerPool {
+    vector<thread> threads;
+    mutex lock;
+    condition_variable wake;
+    deque<function<void()>> jobs;
+    bool stopping = false;
+
+public:
+    // 0 picks one thread per hardware thread
+    explicit WorkerPool(int count = 0) {
+        if (count <= 0) count = max(1, static_cast<int>(thread::hardware_concurrency()));
+        for (int i = 0; i < count; i++) {
+            threads.emplace_back([this] {
+                while (true) {
+                    function<void()> job;
+                    {
+                        unique_lock<mutex> guard(lock);
+                        wake.wait(guard, [this] { return stopping || !jobs.empty(); });
+                        if (jobs.empty()) return;
+                        job = move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    job();
+                }
+            });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& t : threads) t.join();
+    }
+
+    size_t size() const { return threads.size(); }
+
+    // The job must not throw
+    void submit(function<void()> job) {
+        {
+            lock_guard<mutex> guard(lock);
+            jobs.push_back(move(job));
+        }
+        wake.notify_one();
+    }
+};
+
+struct HttpReply {
+    int status = 200;
+    const char* contentType = "application/json";
+    string body;
+};
+
+// The API's routes over a SnapshotSessionContainer. Adds take the container's write lock
+// and every query reads a snapshot, so any number of threads may call respond() at once.
+class SessionApi {
+    SnapshotSessionContainer& sessions;
+    Character character;
+
+    static HttpReply jsonReply(int status, const json& j) {
+        HttpReply reply;
+        reply.status = status;
+        reply.body = j.dump();
+        return reply;
+    }
+
+    static unique_ptr<SessionFilter> filterFrom(const HttpRequest& request) {
+        string expression;
+        if (!request.param("filter", expression)) return nullptr;
+        return unique_ptr<SessionFilter>(new SessionFilter(expression));
+    }
+
+    HttpReply addSessions(const HttpRequest& request) {
+        json body = json::parse(request.body);
+        vector<unique_ptr<PlaySession>> parsed;
+        if (body.is_array())
+            for (const json& record : body) parsed.emplace_back(sessionFromJson(record));
+        else
+            parsed.emplace_back(sessionFromJson(body));
+
+        // Every record parsed, so none of them is added twice or half way
+        for (auto& s : parsed) sessions.add(s.release());
+        return jsonReply(201, { { "added", parsed.size() }, { "sessions", sessions.size() } });
+    }
+
+    HttpReply searchSessions(const HttpRequest& request) const {
+        string location, limitText;
+        bool byLocation = request.param("location", location);
+        size_t limit = 1000;
+        if (request.param("limit", limitText)) {
+            auto r = from_chars(limitText.data(), limitText.data() + limitText.size(), limit);
+            if (r.ec != errc() || r.ptr != limitText.data() + limitText.size()) throw HttpError(400, "Bad limit: " + limitText);
+        }
+        unique_ptr<SessionFilter> filter = filterFrom(request);
+
+        json found = json::array();
+        size_t matched = 0;
+        sessions.snapshot().forEach([&](const PlaySession& s) {
+            if (byLocation && s.getLocation() != location) return;
+            if (filter && !filter->matches(s)) return;
+            if (matched++ < limit) found.push_back(sessionToJson(s));
+        });
+        return jsonReply(200, { { "matched", matched }, { "sessions", move(found) } });
+    }
+
+    HttpReply aggregates(const HttpRequest& request) const {
+        unique_ptr<SessionFilter> filter = filterFrom(request);
+
+        size_t count = 0, rare = 0;
+        long long minutes = 0, gold = 0;
+        double value = 0;
+        size_t byType[RegisteredSessions::COUNT] = {};
+        sessions.snapshot().forEach([&](const PlaySession& s) {
+            if (filter && !filter->matches(s)) return;
+            LootInfo loot = sessionLoot(s);
+            count++;
+            minutes += s.getDuration();
+            gold += loot.getGoldEarned();
+            rare += loot.isRareItemFound();
+            value += sessionValue(s);
+            byType[s.getType()]++;
+        });
+
+        json types = json::object();
+        for (size_t t = 0; t < RegisteredSessions::COUNT; t++)
+            types[RegisteredSessions::tagOf(static_cast<SessionType>(t))] = byType[t];
+        return jsonReply(200, { { "sessions", count }, { "totalMinutes", minutes }, { "goldEarned", gold },
+            { "rareItemsFound", rare }, { "totalValue", value }, { "byType", move(types) } });
+    }
+
+    HttpReply report() const {
+        HttpReply reply;
+        reply.contentType = "text/plain; charset=utf-8";
+        reply.body = ReportWriter::renderHeader(character);
+        auto snapshot = sessions.snapshot();
+        for (size_t i = 0; i < snapshot.size(); i++)
+            reply.body += ReportWriter::renderSession(static_cast<int>(i), snapshot.at(i));
+        return reply;
+    }
+
+public:
+    explicit SessionApi(SnapshotSessionContainer& store, const Character& owner = Character{ "Adventurer", 1, 0, BALANCED })
+        : sessions(store), character(owner) {}
+
+    // Queries that walk every session; the server runs these on its worker pool
+    static bool isHeavy(const HttpRequest& request) {
+        return request.method == "GET" && request.path != "/health";
+    }
+
+    // Throws HttpError for requests that cannot be routed
+    HttpReply handle(const HttpRequest& request) {
+        auto only = [&](const char* method) {
+            if (request.method != method) throw HttpError(405, "Use " + string(method) + " for " + request.path);
+        };
+
+        if (request.path == "/health") {
+            only("GET");
+            return jsonReply(200, { { "status", "ok" }, { "sessions", sessions.size() } });
+        }
+        if (request.path == "/sessions") {
+            if (request.method == "POST") return addSessions(request);
+            only("GET");
+            return searchSessions(request);
+        }
+        if (request.path == "/aggregates") { only("GET"); return aggregates(request); }
+        if (request.path == "/report") { only("GET"); return report(); }
+        throw HttpError(404, "No such endpoint: " + request.path);
+    }
+
+    // The complete response for a request. Never throws; errors become {"error": ...}.
+    string respond(const HttpRequest& request) {
+        HttpReply reply;
+        try { reply = handle(request); }
+        catch (const HttpError& e) { reply = jsonReply(e.status, { { "error", e.what() } }); }
+        catch (const json::exception& e) { reply = jsonReply(400, { { "error", e.what() } }); }
+        catch (const runtime_error& e) { reply = jsonReply(400, { { "error", e.what() } }); }
+        catch (const exception& e) { reply = jsonReply(500, { { "error", e.what() } }); }
+        return httpResponse(reply.status, reply.contentType, reply.body, request.keepAlive);
+    }
+};
+
+#ifdef __linux__
+
+[[noreturn]] void throwSystemError(const string& what) {
+    throw runtime_error(what + ": " + strerror(errno));
+}
+
+// Loopback HTTP server for a SessionApi. run() blocks the calling thread on the event
+// loop until stop() is called from any other thread.
+class HttpServer {
+    // One reply, filled in by the loop or a worker; ready is set last
+    struct Slot {
+        string response;
+        atomic<bool> ready{ false };
+    };
+
+    struct Connection {
+        HttpRequestParser parser;
+        deque<shared_ptr<Slot>> slots;   // replies owed, in request order
+        string out;
+        size_t outPos = 0;
+        uint32_t events = EPOLLIN;
+        bool peerClosed = false;        // nothing more will arrive
+        bool closing = false;           // answer no further requests
+    };
+
+    SessionApi& api;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;                    // eventfd: workers and stop() interrupt epoll_wait
+    uint16_t boundPort = 0;
+    atomic<bool> stopping{ false };
+    unordered_map<int, unique_ptr<Connection>> connections;
+    mutex finishedLock;
+    vector<int> finished;               // connections a worker has answered since the last wake
+    unique_ptr<WorkerPool> workers;
+
+    void closeAll() {
+        for (auto& entry : connections) close(entry.first);
+        connections.clear();
+        if (listenFd >= 0) close(listenFd);
+        if (epollFd >= 0) close(epollFd);
+        if (wakeFd >= 0) close(wakeFd);
+        listenFd = epollFd = wakeFd = -1;
+    }
+
+    void watch(int fd, uint32_t events, int op) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, op, fd, &ev) < 0) throwSystemError("epoll_ctl failed");
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;         // EAGAIN, or a client that gave up before we got to it
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) { close(fd); continue; }
+            connections[fd].reset(new Connection());
+        }
+    }
+
+    void closeConnection(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections.erase(fd);      // slots still held by workers stay alive until they finish
+    }
+
+    // Reads everything available. Returns false if the socket failed.
+    bool readInput(int fd, Connection& c) {
+        char buffer[64 * 1024];
+        while (true) {
+            ssize_t got = recv(fd, buffer, sizeof buffer, 0);
+            if (got > 0) { c.parser.feed(buffer, static_cast<size_t>(got)); continue; }
+            if (got == 0) { c.peerClosed = true; return true; }
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Starts every complete request in the buffer, up to the pipelining limit.
+    // Returns true if anything new was queued.
+    bool startRequests(int fd, Connection& c) {
+        bool queued = false;
+        while (!c.closing && c.slots.size() < HTTP_MAX_PIPELINED) {
+            auto slot = make_shared<Slot>();
+            HttpRequest request;
+            try {
+                if (!c.parser.next(request)) break;
+            }
+            catch (const HttpError& e) {
+                json error = { { "error", e.what() } };
+                slot->response = httpResponse(e.status, "application/json", error.dump(), false);
+                slot->ready = true;
+                c.slots.push_back(slot);
+                c.closing = true;
+                return true;
+            }
+
+            c.slots.push_back(slot);
+            queued = true;
+            if (!request.keepAlive) c.closing = true;
+
+            if (SessionApi::isHeavy(request)) {
+                workers->submit([this, fd, slot, request = move(request)] {
+                    slot->response = api.respond(request);
+                    slot->ready.store(true, memory_order_release);
+                    {
+                        lock_guard<mutex> guard(finishedLock);
+                        finished.push_back(fd);
+                    }
+                    uint64_t one = 1;
+                    if (write(wakeFd, &one, sizeof one) < 0) {}     // the counter cannot overflow in practice
+                });
+            }
+            else {
+                slot->response = api.respond(request);
+                slot->ready.store(true, memory_order_relaxed);
+            }
+        }
+        return queued;
+    }
+
+    // Moves finished replies at the front of the queue to the socket. Returns false if
+    // the socket failed.
+    bool writeOutput(int fd, Connection& c) {
+        while (!c.slots.empty() && c.slots.front()->ready.load(memory_order_acquire)) {
+            c.out += c.slots.front()->response;
+            c.slots.pop_front();
+        }
+        while (c.outPos < c.out.size()) {
+            ssize_t sent = send(fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+            if (sent > 0) { c.outPos += static_cast<size_t>(sent); continue; }
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            return false;
+        }
+        c.out.clear();
+        c.outPos = 0;
+        return true;
+    }
+
+    // Does all the work a connection allows right now, then closes it or updates what
+    // epoll should wait for. A client that pipelines without reading its replies stops
+    // being read once HTTP_MAX_PIPELINED replies are owed or HTTP_MAX_UNSENT_BYTES are
+    // waiting to be sent.
+    void advance(int fd, Connection& c) {
+        bool progressed = true;
+        while (progressed) {
+            progressed = c.out.size() - c.outPos < HTTP_MAX_UNSENT_BYTES && startRequests(fd, c);
+            if (!writeOutput(fd, c)) { closeConnection(fd); return; }
+        }
+
+        bool flushed = c.outPos == c.out.size();
+        if ((c.closing || c.peerClosed) && c.slots.empty() && flushed) { closeConnection(fd); return; }
+
+        bool wantInput = !c.peerClosed && !c.closing && c.slots.size() < HTTP_MAX_PIPELINED &&
+            c.out.size() - c.outPos < HTTP_MAX_UNSENT_BYTES;
+        uint32_t events = (flushed ? 0u : uint32_t(EPOLLOUT)) | (wantInput ? uint32_t(EPOLLIN) : 0u);
+        if (events != c.events) {
+            watch(fd, events, EPOLL_CTL_MOD);
+            c.events = events;
+        }
+    }
+
+    void serviceConnection(int fd, uint32_t events) {
+        auto it = connections.find(fd);
+        if (it == connections.end()) return;
+        Connection& c = *it->second;
+        // A hang-up means the replies could not be delivered either
+        if (events & (EPOLLERR | EPOLLHUP)) { closeConnection(fd); return; }
+        if ((events & EPOLLIN) && !readInput(fd, c)) { closeConnection(fd); return; }
+        advance(fd, c);
+    }
+
+    void serviceFinished() {
+        uint64_t count;
+        if (read(wakeFd, &count, sizeof count) < 0) {}      // EAGAIN when stop() raced a worker
+        vector<int> ready;
+        {
+            lock_guard<mutex> guard(finishedLock);
+            ready.swap(finished);
+        }
+        // A closed fd may have been reused by a new connection; advancing it is harmless
+        for (int fd : ready) {
+            auto it = connections.find(fd);
+            if (it != connections.end()) advance(fd, *it->second);
+        }
+    }
+
+public:
+    // Port 0 picks a free port; workerCount 0 uses one worker per hardware thread
+    explicit HttpServer(SessionApi& handler, uint16_t port = 0, int workerCount = 0) : api(handler) {
+        try {
+            listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listenFd < 0) throwSystemError("Could not create socket");
+            int one = 1;
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+            if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof address) < 0)
+                throwSystemError("Could not bind 127.0.0.1:" + to_string(port));
+            if (listen(listenFd, SOMAXCONN) < 0) throwSystemError("Could not listen");
+            socklen_t length = sizeof address;
+            getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+            boundPort = ntohs(address.sin_port);
+
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (epollFd < 0) throwSystemError("Could not create epoll instance");
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wakeFd < 0) throwSystemError("Could not create eventfd");
+            watch(listenFd, EPOLLIN, EPOLL_CTL_ADD);
+            watch(wakeFd, EPOLLIN, EPOLL_CTL_ADD);
+        }
+        catch (...) {
+            closeAll();
+            throw;
+        }
+        workers.reset(new WorkerPool(workerCount));
+    }
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    ~HttpServer() {
+        workers.reset();        // queued jobs still signal wakeFd, so finish them first
+        closeAll();
+    }
+
+    uint16_t port() const { return boundPort; }
+
+    void run() {
+        epoll_event events[128];
+        while (!stopping.load()) {
+            int n = epoll_wait(epollFd, events, 128, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throwSystemError("epoll_wait failed");
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) acceptAll();
+                else if (fd == wakeFd) serviceFinished();
+                else serviceConnection(fd, events[i].events);
+            }
+        }
+    }
+
+    void stop() {
+        stopping = true;
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof one) < 0) {}
+    }
+};
+
+struct HttpLoadOptions {
+    string method = "GET";
+    string target = "/health";
+    string body;
+    int connections = 4;
+    int requestsPerConnection = 1000;
+    int pipeline = 1;           // requests in flight per connection
+};
+
+struct HttpLoadResult {
+    long long requests = 0;     // responses received
+    long long failures = 0;     // non-2xx responses plus requests lost to socket errors
+    double seconds = 0;
+};
+
+// Bundled load client: each connection runs on its own thread with blocking sockets and
+// sends the same request in batches of options.pipeline, reading every reply before
+// the next batch.
+HttpLoadResult runHttpLoad(uint16_t port, const HttpLoadOptions& options) {
+    string request = options.method + " " + options.target + " HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+    if (!options.body.empty() || options.method == "POST")
+        request += "Content-Type: application/json\r\nContent-Length: " + to_string(options.body.size()) + "\r\n";
+    request += "\r\n" + options.body;
+
+    atomic<long long> responses{ 0 };
+    atomic<long long> failures{ 0 };
+
+    auto client = [&] {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) < 0) {
+            if (fd >= 0) close(fd);
+            failures += options.requestsPerConnection;
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        string batch, in;
+        char buffer[64 * 1024];
+        int left = options.requestsPerConnection;
+        while (left > 0) {
+            int depth = min(left, max(1, options.pipeline));
+            batch.clear();
+            for (int i = 0; i < depth; i++) batch += request;
+
+            bool failed = false;
+            for (size_t sent = 0; sent < batch.size() && !failed;) {
+                ssize_t n = send(fd, batch.data() + sent, batch.size() - sent, MSG_NOSIGNAL);
+                if (n > 0) sent += static_cast<size_t>(n);
+                else failed = errno != EINTR;
+            }
+            int answered = 0;
+            while (answered < depth && !failed) {
+                size_t length;
+                while (answered < depth && (length = httpResponseLength(in)) > 0) {
+                    int status = httpStatusOf(in);
+                    if (status < 200 || status > 299) failures++;
+                    responses++;
+                    answered++;
+                    in.erase(0, length);
+                }
+                if (answered == depth) break;
+                ssize_t n = recv(fd, buffer, sizeof buffer, 0);
+                if (n > 0) in.append(buffer, static_cast<size_t>(n));
+                else failed = n == 0 || errno != EINTR;
+            }
+            if (failed) { failures += left - answered; break; }
+            left -= depth;
+        }
+        close(fd);
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int i = 0; i < options.connections; i++) threads.emplace_back(client);
+    for (thread& t : threads) t.join();
+
+    HttpLoadResult result;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.requests = responses;
+    result.failures = failures;
+    return result;
+}
+
+#endif
+
+// A --port or --load-test value; rejected before it is narrowed to 16 bits
+uint16_t parseHttpPort(const string& text) {
+    int v = 0;
+    auto r = from_chars(text.data(), text.data() + text.size(), v);
+    if (text.empty() || (r.ec != errc() && r.ec != errc::result_out_of_range) || r.ptr != text.data() + text.size() || v < 0)
+        throw runtime_error("Not a whole number: " + text);
+    if (r.ec == errc::result_out_of_range || v > 65535) throw runtime_error("Number out of range: " + text);
+    return static_cast<uint16_t>(v);
+}
+
+// --serve [sessions file] [--port N] [--workers N] serves the API until the process is
+// stopped. --load-test <port> [--path P] [--connections N] [--requests N] [--pipeline N]
+// drives a running server and prints its throughput. Returns the process exit code.
+int runHttpCommand(const string& command, const vector<string>& args) {
+    try {
+#ifdef __linux__
+        auto wholeNumber = [](const string& text) {
+            int v = 0;
+            auto r = from_chars(text.data(), text.data() + text.size(), v);
+            if (text.empty() || r.ec != errc() || r.ptr != text.data() + text.size() || v < 0)
+                throw runtime_error("Not a whole number: " + text);
+            return v;
+        };
+
+        size_t first = command == "--load-test" ? 1 : 0;
+        if (command == "--load-test" && args.empty())
+            throw runtime_error("Usage: --load-test <port> [--path P] [--connections N] [--requests N] [--pipeline N]");
+        string sessionFile;
+        if (command == "--serve" && !args.empty() && args[0].compare(0, 2, "--") != 0) {
+            sessionFile = args[0];
+            first = 1;
+        }
+
+        uint16_t port = 0;
+        int workerCount = 0;
+        HttpLoadOptions load;
+        for (size_t i = first; i < args.size(); i += 2) {
+            const string& flag = args[i];
+            if (i + 1 >= args.size()) throw runtime_error("Missing value for " + flag);
+            const string& value = args[i + 1];
+            if (flag == "--port" && command == "--serve") port = parseHttpPort(value);
+            else if (flag == "--workers" && command == "--serve") workerCount = wholeNumber(value);
+            else if (flag == "--path" && command == "--load-test") load.target = value;
+            else if (flag == "--connections" && command == "--load-test") load.connections = max(1, wholeNumber(value));
+            else if (flag == "--requests" && command == "--load-test") load.requestsPerConnection = wholeNumber(value);
+            else if (flag == "--pipeline" && command == "--load-test") load.pipeline = max(1, wholeNumber(value));
+            else throw runtime_error("Unknown option " + flag);
+        }
+
+        if (command == "--load-test") {
+            HttpLoadResult result = runHttpLoad(parseHttpPort(args[0]), load);
+            cout << result.requests << " responses, " << result.failures << " failures in " << fixed << setprecision(2)
+                << result.seconds << " s (" << setprecision(0) << result.requests / result.seconds << " requests/s)\n"
+                << defaultfloat;
+            return result.failures == 0 ? 0 : 1;
+        }
+
+        SnapshotSessionContainer sessions;
+        if (!sessionFile.empty()) {
+            auto source = openSessionSource(sessionFile);
+            while (auto s = source->next()) sessions.add(s.release());
+        }
+        SessionApi api(sessions);
+        HttpServer server(api, port, workerCount);
+        cout << "Serving " << sessions.size() << " session(s) on http://127.0.0.1:" << server.port() << "/" << endl;
+        server.run();
+        return 0;
+#else
+        (void)args;
+        throw runtime_error(command + " needs Linux; the HTTP server uses epoll");
+#endif
+    }
+    catch (const runtime_error& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// Moves sessions parsed by a background load into the menu's container. The load
+// bypasses the history, so the history is cleared whenever sessions arrived.
+int drainPendingLoad(AsyncSessionLoad& load, SessionContainer& manager, SessionHistory& history) {
+    int arrived = load.drainInto(manager);
+    if (arrived > 0) history.clear();
+    return arrived;
+}
+
+// Banner Function
+void displayBanner() {
+    cout << "\n=== Baldur's Gate 3 - Adventure Tracker ===\n";
+}
+
+// Menu Display Function
+void displayMenu() {
+    cout << "\n=== Main Menu ===\n1. Add Session\n2. View Session Summary\n3. Remove Session\n4. Recommend Difficulty\n5. Save Report to File\n6. Quit\n7. Search by Location\n8. Push to stack\n9. Pop from stack\n10. Enqueue to queue\n11. Dequeue from queue\n12. Load sessions from JSON (background)\n13. Show load progress\n14. Show memory usage\n15. Filter sessions\n16. Undo\n17. Redo\n18. Show thread pool usage\n19. Remove duplicate sessions\n";
+}
+
+#if !defined(RUN_TESTS) && !defined(RUN_BENCHMARKS)
+int main(int argc, char* argv[]) {
+    // --threads N sizes the shared task scheduler and goes before any other arguments
+    if (argc > 2 && string(argv[1]) == "--threads") {
+        try {
+            setTaskWorkers(stoi(argv[2]));
+        }
+        catch (const exception&) {
+            cerr << "Usage: --threads <workers> [command]\n";
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    // Batch commands run without the menu
+    if (argc > 1 && string(argv[1]) == "--generate")
+        return runGenerateCommand(vector<string>(argv + 2, argv + argc));
+    if (argc > 1 && (string(argv[1]) == "--index" || string(argv[1]) == "--find"))
+        return runIndexCommand(argv[1], vector<string>(argv + 2, argv + argc));
+    if (argc > 1 && string(argv[1]) == "--filter")
+        return runFilterCommand(vector<string>(argv + 2, argv + argc));
+    if (argc > 1 && string(argv[1]) == "--merge")
+        return runMergeCommand(vector<string>(argv + 2, argv + argc));
+    if (argc > 1 && (string(argv[1]) == "--serve" || string(argv[1]) == "--load-test"))
+        return runHttpCommand(argv[1], vector<string>(argv + 2, argv + argc));
+
+    Character player;
+    SessionContainer manager;
+    SessionHistory history(manager);
+    SessionStack stack;
+    SessionQueue queue;
+    unique_ptr<AsyncSessionLoad> pendingLoad;
+    ReportWriter report("report.txt");
+    int choice;
+
+    displayBanner();
+    createCharacter(player);
+    displayCharacterSummary(player);
+
+    do {
+        // Sessions parsed in the background since the last choice become queryable now
+        if (pendingLoad) {
+            int arrived = drainPendingLoad(*pendingLoad, manager, history);
+            if (arrived > 0) cout << arrived << " loaded session(s) added.\n";
+        }
+
+        displayMenu();
+        choice = getValidInt("Choice: ", 1, 19);
+
+        switch (choice) {
+
+        case 1:   // Add Session
+        {
+            int type = getValidInt("1 Combat, 2 Explore: ", 1, 2);
+            string loc = getValidString("Location: ");
+            int dur = getValidInt("Duration: ", 1, 600);
+
+            LootInfo loot(0, false);
+
+            if (type == 1)
+                history.add(new CombatSession(loc, dur, BALANCED, 5, loot));
+            else
+                history.add(new ExplorationSession(loc, dur, EXPLORER, 3, loot));
+
+            cout << "Added\n";
+            break;
+        }
+
+        case 2:   // View Sessions
+        {
+            for (const PlaySession& s : manager) {
+                s.print();
+                cout << "---\n";
+            }
+            break;
+        }
+
+        case 3:   // Remove Session
+        {
+            if (manager.size() == 0) {
+                cout << "No sessions to remove.\n";
+                break;
+            }
+
+            int index = getValidInt(
+                "Enter session index to remove: ",
+                0,
+                manager.size() - 1
+            );
+
+            try {
+                history.remove(index);       // Remove session by index, keeping it for undo
+                cout << "Session removed.\n";
+            }
+            catch (const ContainerException& e) {
+                cout << "Error: " << e.what() << endl;
+            }
+            break;
+        }
+
+        case 4:   // Recommend Difficulty
+        {
+            if (manager.size() == 0) {
+                cout << "No sessions available.\n";
+                break;
+            }
+
+            int totalMinutes = 0;
+            for (const PlaySession& s : manager) {
+                totalMinutes += s.getDuration();
+            }
+
+            double avgHours =
+                (totalMinutes / 60.0) / manager.size();
+
+            Difficulty rec =
+                recommendDifficultyByStats(player.level, avgHours);
+
+            cout << "\n=== Difficulty Recommendation ===\n";
+
+            switch (rec) {
+            case EXPLORER:  cout << "Explorer\n"; break;
+            case BALANCED:  cout << "Balanced\n"; break;
+            case TACTICIAN: cout << "Tactician\n"; break;
+            }
+
+            break;
+        }
+
+        case 5:   // Save Report
+        {
+            try {
+                ReportSaveStats saved = report.save(player, manager);
+                cout << "Report saved to report.txt (" << saved.sectionsWritten << " section(s) rewritten)\n";
+            }
+            catch (const runtime_error& e) {
+                cout << "Error: " << e.what() << endl;
+            }
             break;
         }
 
@@ -507,23 +6948,724 @@ int main() {
             stack.push(new CombatSession("Camp", 30, BALANCED, 5, LootInfo()));
             break;
 
-        case 9:   // Pop from stack
-            try { stack.pop(); } catch (...) { cout << "Empty\n"; }
-            break;
+        case 9:   // Pop from stack
+            try { stack.pop(); } catch (...) { cout << "Empty\n"; }
+            break;
+
+        case 10:  // Enqueue to queue and Dequeue from queue
+            queue.enqueue(new ExplorationSession("Forest", 60, EXPLORER, 3, LootInfo()));
+            break;
+            try { queue.dequeue(); } catch (...) { cout << "Empty\n"; }
+            break;
+
+        case 12:  // Load sessions in the background
+        {
+            if (pendingLoad && !pendingLoad->isDone()) {
+                cout << "A load is already running.\n";
+                break;
+            }
+
+            string file = getValidString("JSON file: ");
+            IngestMode mode = getValidInt("Skip sessions already loaded? (1 = yes, 0 = no): ", 0, 1) ? INGEST_UNIQUE : INGEST_ALL;
+            try {
+                if (pendingLoad) drainPendingLoad(*pendingLoad, manager, history);
+                pendingLoad.reset(new AsyncSessionLoad(file, mode));
+                cout << "Loading in the background. Keep using the menu.\n";
+            }
+            catch (const runtime_error& e) {
+                cout << "Error: " << e.what() << endl;
+            }
+            break;
+        }
+
+        case 13:  // Load progress
+        {
+            if (!pendingLoad) {
+                cout << "No load started.\n";
+                break;
+            }
+
+            drainPendingLoad(*pendingLoad, manager, history);
+            LoadProgress p = pendingLoad->progress();
+            double percent = p.totalBytes > 0 ? 100.0 * p.bytesRead / p.totalBytes : 100.0;
+
+            cout << p.sessionsParsed << " session(s) loaded, " << fixed << setprecision(1)
+                << percent << "% of file read" << (p.done ? " (done)" : "") << endl << defaultfloat;
+            if (!p.error.empty()) cout << "Load stopped: " << p.error << endl;
+            break;
+        }
+
+        case 14:  // Memory usage, also dumped as JSON for tooling
+        {
+            cout << "\n=== Memory Usage ===\n";
+            printMemoryReport();
+            try {
+                saveMemoryReport("memory.json");
+                cout << "Written to memory.json\n";
+            }
+            catch (const runtime_error& e) {
+                cout << "Error: " << e.what() << endl;
+            }
+            break;
+        }
+
+        case 15:  // Filter sessions with an expression
+        {
+            string text = getValidString("Filter (e.g. type == combat && durationMinutes > 45): ");
+            try {
+                SessionFilter filter(text);
+                int index = 0, found = 0;
+                for (const PlaySession& s : manager) {
+                    if (filter.matches(s)) {
+                        cout << "\nSession #" << index << ":\n";
+                        s.print();
+                        found++;
+                    }
+                    index++;
+                }
+                cout << found << " of " << manager.size() << " session(s) match.\n";
+            }
+            catch (const runtime_error& e) {
+                cout << e.what() << endl;
+            }
+            break;
+        }
+
+        case 16:  // Undo the last add or remove
+            cout << (history.undo() ? "Undone.\n" : "Nothing to undo.\n");
+            break;
+
+        case 17:  // Redo the last undone change
+            cout << (history.redo() ? "Redone.\n" : "Nothing to redo.\n");
+            break;
+
+        case 18:  // Time each subsystem has spent on the shared scheduler
+            cout << "\n=== Thread Pool Usage ===\n";
+            printTaskReport();
+            break;
+
+        case 19:  // Keep one of each group of sessions with the same content
+        {
+            int removed = removeDuplicateSessions(manager);
+            if (removed > 0) history.clear();   // the removals bypassed the history
+            cout << "Removed " << removed << " duplicate session(s).\n";
+            break;
+        }
+        }
+
+    } while (choice != 6);
+
+    #ifdef _DEBUG
+        _CrtDumpMemoryLeaks();
+    #endif
+
+    return 0;
+}
+#endif
+
+// ===================== BENCHMARKS =====================
+#if defined(RUN_BENCHMARKS) && !defined(RUN_TESTS)
+
+using BenchClock = chrono::steady_clock;
+
+double secondsSince(BenchClock::time_point start) {
+    return chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+// Location names cycle through a fixed set so interning has realistic hits
+string benchLocation(size_t i) {
+    static const char* places[] = { "Nautiloid Crash Site", "Emerald Grove", "Goblin Camp",
+        "Underdark", "Moonrise Towers", "Camp", "Forest" };
+    return string(places[i % 7]) + " " + to_string(i % 1000);
+}
+
+PlaySession* benchSession(size_t i) {
+    LootInfo loot(static_cast<int>(i % 200), i % 17 == 0);
+    if (i % 2 == 0)
+        return new CombatSession(benchLocation(i), 30 + i % 90, BALANCED, static_cast<int>(i % 20), loot);
+    return new ExplorationSession(benchLocation(i), 20 + i % 120, EXPLORER, static_cast<int>(i % 8), loot);
+}
+
+void benchCompactFootprint(size_t n) {
+    cout << "\n--- Session memory footprint (" << n << " sessions) ---\n";
+
+    size_t legacyBytes = 0;
+    {
+        // Head insertion keeps the build linear; insertBack walks the whole list
+        SessionLinkedList list;
+        auto start = BenchClock::now();
+        for (size_t i = 0; i < n; i++) {
+            list.insertFront(benchSession(i));
+            legacyBytes += legacySessionBytes(*list.head->data);
+        }
+        cout << "Linked list build: " << secondsSince(start) << " s\n";
+    }
+
+    CompactSessionStore store;
+    store.reserve(n);
+    auto start = BenchClock::now();
+    for (size_t i = 0; i < n; i++) {
+        LootInfo loot(static_cast<int>(i % 200), i % 17 == 0);
+        if (i % 2 == 0)
+            store.add(benchLocation(i), COMBAT_SESSION, BALANCED, 30 + i % 90, static_cast<int>(i % 20), loot);
+        else
+            store.add(benchLocation(i), EXPLORATION_SESSION, EXPLORER, 20 + i % 120, static_cast<int>(i % 8), loot);
+    }
+    cout << "Compact store build: " << secondsSince(start) << " s\n";
+
+    size_t compactBytes = store.memoryBytes();
+    cout << fixed << setprecision(1);
+    cout << "Linked list: " << legacyBytes / 1048576.0 << " MiB ("
+        << double(legacyBytes) / n << " bytes/session, before allocator overhead)\n";
+    cout << "Compact:     " << compactBytes / 1048576.0 << " MiB ("
+        << double(compactBytes) / n << " bytes/session)\n";
+    cout << "Reduction:   " << double(legacyBytes) / compactBytes << "x\n";
+    cout << defaultfloat;
+}
+
+// Every thread appends its share of the sessions, then runs searches and totals
+// while the others are still writing. Reports throughput for 1 thread up to all cores.
+void benchConcurrentContainer(size_t n) {
+    int cores = max(1, static_cast<int>(thread::hardware_concurrency()));
+    cout << "\n--- Concurrent container throughput (" << n << " adds, " << cores << " cores) ---\n";
+
+    vector<int> threadCounts;
+    for (int t = 1; t < cores; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(cores);
+
+    double baseline = 0;
+    for (int threads : threadCounts) {
+        vector<vector<PlaySession*>> work(threads);
+        for (size_t i = 0; i < n; i++) work[i % threads].push_back(benchSession(i));
+
+        ConcurrentSessionContainer store;
+        atomic<long long> queries{ 0 };
+
+        auto start = BenchClock::now();
+        vector<thread> pool;
+        for (int t = 0; t < threads; t++) {
+            pool.emplace_back([&, t]() {
+                size_t i = 0;
+                for (PlaySession* s : work[t]) {
+                    store.add(s);
+                    if (++i % 100000 == 0) {
+                        store.contains(benchLocation(i));
+                        queries++;
+                    }
+                }
+                store.totalMinutes();
+                queries++;
+            });
+        }
+        for (thread& th : pool) th.join();
+        double secs = secondsSince(start);
+
+        double rate = n / secs / 1e6;
+        if (threads == 1) baseline = rate;
+        cout << threads << " thread(s): " << fixed << setprecision(2) << rate << " M adds/s"
+            << " (" << rate / baseline << "x, " << queries << " queries)\n" << defaultfloat;
+    }
+}
+
+// The current per-node loop against the column kernels for the same aggregates
+void benchColumnKernels(size_t n) {
+    cout << "\n--- Aggregate kernels (" << n << " sessions) ---\n";
+
+    SessionLinkedList list;
+    SessionColumns columns;
+    columns.reserve(n);
+    for (size_t i = 0; i < n; i++) list.insertFront(benchSession(n - 1 - i));
+    for (const PlaySession& s : list) columns.add(s);
+
+    auto start = BenchClock::now();
+    long long minutes = 0, gold = 0;
+    size_t rare = 0;
+    double value = 0;
+    for (const PlaySession& s : list) {
+        LootInfo loot = sessionLoot(s);
+        minutes += s.getDuration();
+        gold += loot.getGoldEarned();
+        rare += loot.isRareItemFound();
+        value += s.calculateValue();
+    }
+    double legacy = secondsSince(start);
+    cout << fixed << setprecision(2);
+    cout << "Linked list loop: " << legacy * 1000 << " ms\n";
+
+    vector<const SessionKernels*> sets = { &scalarSessionKernels(), sse2SessionKernels(), avx2SessionKernels() };
+    for (const SessionKernels* k : sets) {
+        if (!k) continue;
+        start = BenchClock::now();
+        ColumnTotals t = aggregateColumns(columns, *k);
+        double secs = secondsSince(start);
+        bool same = t.minutes == minutes && t.gold == gold && t.rareItems == rare && t.value == value;
+        cout << k->name << " kernels: " << secs * 1000 << " ms (" << legacy / secs << "x"
+            << (same ? "" : ", MISMATCH") << ")\n";
+    }
+    cout << "Dispatch picks: " << activeSessionKernels().name << "\n" << defaultfloat;
+}
+
+void benchBatchRecommendations(size_t n) {
+    cout << "\n--- Difficulty recommendations (" << n << " characters) ---\n";
+
+    vector<int> levels(n);
+    vector<double> hours(n);
+    uint64_t seed = 42;
+    for (size_t i = 0; i < n; i++) {
+        // Random inputs, so the scalar function's branches cannot be predicted
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        levels[i] = 1 + static_cast<int>((seed >> 33) % 12);
+        hours[i] = ((seed >> 17) % 40) / 10.0;
+    }
+    vector<Difficulty> scalar(n), batch(n);
+
+    auto start = BenchClock::now();
+    for (size_t i = 0; i < n; i++) scalar[i] = recommendDifficultyByStats(levels[i], hours[i]);
+    double perCall = secondsSince(start);
+
+    start = BenchClock::now();
+    recommendDifficultyBatch(levels.data(), hours.data(), batch.data(), n);
+    double batched = secondsSince(start);
+
+    cout << fixed << setprecision(2);
+    cout << "One call per character: " << perCall * 1000 << " ms\n";
+    cout << "Batch kernel:           " << batched * 1000 << " ms (" << perCall / batched << "x"
+        << (scalar == batch ? "" : ", MISMATCH") << ")\n" << defaultfloat;
+}
+
+// Archive size per session and streaming decode speed against the wire format
+void benchSessionArchive(size_t n) {
+    cout << "\n--- Session archive (" << n << " sessions) ---\n";
+
+    SessionColumns columns;
+    columns.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        LootInfo loot(static_cast<int>(i % 200), i % 17 == 0);
+        columns.add(i % 2 ? EXPLORATION_SESSION : COMBAT_SESSION, benchLocation(i), static_cast<int>(30 + i % 90),
+            BALANCED, static_cast<int>(i % 20), loot);
+    }
+
+    auto start = BenchClock::now();
+    stringstream archive;
+    writeSessionArchive(archive, columns);
+    double encode = secondsSince(start);
+    size_t archiveBytes = archive.str().size();
+
+    SessionWireWriter writer;
+    for (size_t i = 0; i < n; i++) {
+        writer.add(static_cast<SessionType>(columns.type[i]), columns.locations.name(columns.locationId[i]),
+            columns.duration[i], BALANCED, columns.count[i], LootInfo(columns.gold[i], columns.rare[i] != 0));
+    }
+    string wire = writer.finish();
+
+    start = BenchClock::now();
+    ColumnTotals fromArchive = aggregateArchive(archive);
+    double archiveDecode = secondsSince(start);
+
+    start = BenchClock::now();
+    SessionWireView view(wire.data(), wire.size());
+    long long minutes = 0;
+    double value = 0;
+    for (size_t i = 0; i < view.size(); i++) {
+        minutes += view.record(i).getDuration();
+        value += view.record(i).calculateValue();
+    }
+    double wireDecode = secondsSince(start);
+
+    bool match = fromArchive.minutes == minutes && fromArchive.value == value;
+    cout << fixed << setprecision(2);
+    cout << "Bytes/session: archive " << double(archiveBytes) / n << ", wire " << double(wire.size()) / n
+        << ", compact " << sizeof(CompactSession) << "\n";
+    cout << "Encode: " << encode * 1000 << " ms\n";
+    cout << "Aggregate: archive " << archiveDecode * 1000 << " ms (" << n / archiveDecode / 1e6
+        << " M sessions/s), wire " << wireDecode * 1000 << " ms" << (match ? "" : ", MISMATCH") << "\n" << defaultfloat;
+}
+
+// Generator throughput for the binary and JSON-lines writers
+void benchWorkloadGenerator(size_t n) {
+    cout << "\n--- Workload generator (" << n << " sessions, " << thread::hardware_concurrency() << " threads) ---\n";
+
+    WorkloadConfig config;
+    config.sessions = n;
+    for (const char* ext : { ".bgsw", ".jsonl" }) {
+        string fileName = (filesystem::temp_directory_path() / (string("bench_workload") + ext)).string();
+        auto start = BenchClock::now();
+        uint64_t bytes = generateWorkload(config, fileName);
+        double seconds = secondsSince(start);
+        filesystem::remove(fileName);
+
+        cout << fixed << setprecision(2) << ext << ": " << seconds << " s, " << n / seconds / 1e6 << " M sessions/s, "
+            << bytes / seconds / 1048576.0 << " MiB/s\n" << defaultfloat;
+    }
+}
+
+// 4-ary indexed heap against std::priority_queue (binary, no handles) over the same
+// sessions: heapify everything, then take them all back out in order
+void benchPriorityQueue(size_t n) {
+    n = min<size_t>(n, 2000000);
+    cout << "\n--- Priority queue (" << n << " sessions) ---\n";
+
+    vector<unique_ptr<PlaySession>> sessions;
+    sessions.reserve(n);
+    WorkloadConfig config;
+    for (size_t i = 0; i < n; i++) {
+        GeneratedSession g = generateSession(config, i);
+        sessions.emplace_back(makeSession(g.type, workloadLocation(g.locationId), g.duration, g.difficulty, g.count, LootInfo(g.gold, g.rare)));
+    }
+
+    // The standard binary heap over the same entries, in arrival order
+    struct Entry { double key; uint64_t order; PlaySession* session; };
+    auto later = [](const Entry& a, const Entry& b) { return a.key < b.key || (a.key == b.key && a.order > b.order); };
+    auto start = BenchClock::now();
+    vector<Entry> entries;
+    entries.reserve(n);
+    for (size_t i = 0; i < n; i++) entries.push_back(Entry{ priorityByValue(*sessions[i]), i, sessions[i].get() });
+    priority_queue<Entry, vector<Entry>, decltype(later)> binary(later, move(entries));
+    double binaryHeapifySecs = secondsSince(start);
+    start = BenchClock::now();
+    uint64_t check = 0;
+    while (!binary.empty()) {
+        check += binary.top().order;
+        binary.pop();
+    }
+    double binaryDrainSecs = secondsSince(start);
+
+    double scale = 1;       // lowered later to drive decrease-key
+    vector<PlaySession*> batch;
+    for (auto& s : sessions) batch.push_back(s.release());
+    start = BenchClock::now();
+    SessionPriorityQueue<> heap([&](const PlaySession& s) { return priorityByValue(s) * scale; });
+    heap.pushBatch(batch);
+    double heapifySecs = secondsSince(start);
+    start = BenchClock::now();
+    for (size_t i = 0; i < n; i++) sessions[i] = heap.take();
+    double drainSecs = secondsSince(start);
+
+    // Decrease-key on a full queue, which std::priority_queue cannot do
+    batch.clear();
+    for (auto& s : sessions) batch.push_back(s.release());
+    vector<SessionPriorityQueue<>::Handle> handles = heap.pushBatch(batch);
+    scale = 0.25;
+    start = BenchClock::now();
+    for (size_t i = 0; i < n; i += 7) heap.update(handles[i]);
+    double updateSecs = secondsSince(start);
+
+    cout << fixed << setprecision(1)
+        << "4-ary heapify:    " << heapifySecs * 1e3 << " ms, drain " << drainSecs * 1e3 << " ms\n"
+        << "binary heapify:   " << binaryHeapifySecs * 1e3 << " ms, drain " << binaryDrainSecs * 1e3 << " ms (checksum " << check % 1000 << ")\n"
+        << "decrease-key:     " << setprecision(2) << (n / 7) / updateSecs / 1e6 << " M/s\n" << defaultfloat;
+}
+
+// CSV export through the buffered writer and chunked parallel import back into columns
+void benchCsv(size_t n) {
+    cout << "\n--- CSV export/import (" << n << " sessions, " << thread::hardware_concurrency() << " threads) ---\n";
+
+    WorkloadConfig config;
+    config.sessions = n;
+    string fileName = (filesystem::temp_directory_path() / "bench_sessions.csv").string();
+
+    auto start = BenchClock::now();
+    {
+        CsvSessionWriter writer(fileName);
+        for (uint64_t i = 0; i < n; i++) {
+            GeneratedSession g = generateSession(config, i);
+            writer.write(g.type, workloadLocation(g.locationId), g.duration, g.difficulty, g.count, LootInfo(g.gold, g.rare));
+        }
+    }
+    double writeSecs = secondsSince(start);
+    double mib = filesystem::file_size(fileName) / 1048576.0;
+
+    start = BenchClock::now();
+    SessionColumns columns = readSessionsCsv(fileName);
+    double readSecs = secondsSince(start);
+    filesystem::remove(fileName);
+
+    cout << fixed << setprecision(2) << "File size:  " << mib << " MiB\n"
+        << "Export:     " << writeSecs << " s, " << mib / writeSecs << " MiB/s\n"
+        << "Import:     " << readSecs << " s, " << mib / readSecs << " MiB/s (" << columns.size() << " sessions)\n"
+        << defaultfloat;
+}
+
+// k-way merge of generated wire files against reading the same files one after another,
+// both into a counting sink, with and without read-ahead threads
+void benchSessionMerge(size_t n) {
+    n = min<size_t>(n, 4000000);
+    const size_t k = 8;
+    cout << "\n--- Merge (" << n << " sessions in " << k << " wire files, " << thread::hardware_concurrency() << " threads) ---\n";
+
+    vector<string> names;
+    for (size_t i = 0; i < k; i++) {
+        names.push_back((filesystem::temp_directory_path() / ("bench_merge_" + to_string(i) + ".bgsw")).string());
+        WorkloadConfig config;
+        config.sessions = n / k;
+        config.seed = 100 + i;
+        generateWorkload(config, names.back());
+    }
+
+    auto start = BenchClock::now();
+    long long sequential = 0;
+    for (const string& name : names) sequential += accumulate(*openSessionSource(name)).sessions;
+    double sequentialSecs = secondsSince(start);
+
+    start = BenchClock::now();
+    SessionMerge direct;
+    for (const string& name : names) direct.addInput(openSessionSource(name), name);
+    long long unprefetched = accumulate(direct).sessions;
+    double directSecs = secondsSince(start);
+
+    start = BenchClock::now();
+    long long merged = accumulate(*openSessionMerge(names)).sessions;
+    double mergeSecs = secondsSince(start);
+    for (const string& name : names) filesystem::remove(name);
+
+    bool same = sequential == unprefetched && sequential == merged;
+    cout << fixed << setprecision(2) << "Sequential read:        " << sequentialSecs * 1000 << " ms, "
+        << sequential / sequentialSecs / 1e6 << "M sessions/s\n"
+        << "Merge, no read-ahead:   " << directSecs * 1000 << " ms, " << unprefetched / directSecs / 1e6 << "M sessions/s\n"
+        << "Merge with read-ahead:  " << mergeSecs * 1000 << " ms, " << merged / mergeSecs / 1e6 << "M sessions/s"
+        << (same ? "" : ", MISMATCH") << "\n" << defaultfloat;
+}
+
+// Hash-based removeDuplicateSessions against comparing every pair, on sessions where
+// about a quarter repeat an earlier one
+void benchDeduplication(size_t n) {
+    n = min<size_t>(n, 1000000);
+    size_t pairwiseN = min<size_t>(n, 10000);
+    cout << "\n--- Deduplication (" << n << " sessions) ---\n";
+
+    auto fill = [](SessionContainer& manager, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            size_t id = i % 4 == 3 ? i / 2 : i;
+            manager.add(new CombatSession(benchLocation(id), static_cast<int>(id), BALANCED, static_cast<int>(id % 20),
+                LootInfo(static_cast<int>(id % 200), id % 17 == 0)));
+        }
+    };
+
+    SessionContainer manager;
+    fill(manager, n);
+    auto start = BenchClock::now();
+    int removed = removeDuplicateSessions(manager);
+    double hashSecs = secondsSince(start);
+
+    SessionContainer small;
+    fill(small, pairwiseN);
+    start = BenchClock::now();
+    int pairwise = small.removeIf([&](const PlaySession& s) {
+        for (const PlaySession& earlier : small) {
+            if (&earlier == &s) return false;
+            if (sameContent(earlier, s)) return true;
+        }
+        return false;
+    });
+    double pairwiseSecs = secondsSince(start);
+
+    cout << fixed << setprecision(2) << "Hash set:  " << hashSecs * 1000 << " ms, " << removed << " removed, "
+        << n / hashSecs / 1e6 << "M sessions/s\n"
+        << "Pairwise:  " << pairwiseSecs * 1000 << " ms for " << pairwiseN << " sessions, " << pairwise << " removed, "
+        << pairwiseN / pairwiseSecs / 1e3 << "K sessions/s\n" << defaultfloat;
+}
+
+// Summing durations with at(i) per index, as the menu used to, against one pass of the
+// iterators. at(i) walks from the head each time, so the first loop is O(n^2).
+void benchSessionIteration(size_t n) {
+    // The at(i) loop is quadratic; a prefix cannot be scaled linearly, so cap n instead
+    n = min<size_t>(n, 20000);
+    cout << "\n--- Indexed vs iterated (" << n << " sessions) ---\n";
+
+    SessionContainer manager;
+    for (size_t i = 0; i < n; i++) manager.add(benchSession(i));
+
+    auto start = BenchClock::now();
+    long long indexed = 0;
+    for (int i = 0; i < manager.size(); i++) indexed += manager.at(i)->getDuration();
+    double indexedSecs = secondsSince(start);
+
+    start = BenchClock::now();
+    long long iterated = 0;
+    for (const PlaySession& s : manager) iterated += s.getDuration();
+    double iteratedSecs = secondsSince(start);
+
+    cout << fixed << setprecision(3) << "at(i) loop: " << indexedSecs * 1000 << " ms\n"
+        << "Iterators:  " << iteratedSecs * 1000 << " ms (" << setprecision(0) << indexedSecs / iteratedSecs << "x"
+        << (indexed == iterated ? "" : ", MISMATCH") << ")\n" << defaultfloat;
+}
+
+// Column aggregation and parallelSort on the shared scheduler at a few worker counts,
+// with the utilization each run reached
+void benchTaskScheduler(size_t n) {
+    cout << "\n--- Task scheduler (" << n << " sessions, " << thread::hardware_concurrency() << " threads) ---\n";
+
+    WorkloadConfig config;
+    config.sessions = n;
+    SessionColumns columns;
+    vector<uint64_t> keys;
+    for (uint64_t i = 0; i < n; i++) {
+        GeneratedSession g = generateSession(config, i);
+        columns.add(g.type, workloadLocation(g.locationId), g.duration, g.difficulty, g.count, LootInfo(g.gold, g.rare));
+        keys.push_back(uint64_t(g.gold) << 32 | g.locationId);
+    }
+
+    cout << fixed << setprecision(2);
+    for (int workers : { 0, 1, 3, defaultTaskWorkers() }) {
+        setTaskWorkers(workers);
+        long long busyBefore = spanAccount(WORK_AGGREGATION).stats().busyNanos + spanAccount(WORK_SORTING).stats().busyNanos;
+        auto start = BenchClock::now();
+        ColumnTotals t;
+        for (int round = 0; round < 10; round++) t = aggregateColumns(columns);
+        double aggregateSecs = secondsSince(start);
+
+        vector<uint64_t> sorted(keys);
+        auto sortStart = BenchClock::now();
+        parallelSort(WORK_SORTING, sorted.begin(), sorted.end());
+        double sortSecs = secondsSince(sortStart);
+        double wall = secondsSince(start);
+        long long busyAfter = spanAccount(WORK_AGGREGATION).stats().busyNanos + spanAccount(WORK_SORTING).stats().busyNanos;
+
+        cout << workers << " worker(s): aggregate x10 " << aggregateSecs * 1000 << " ms, sort " << sortSecs * 1000
+            << " ms, utilization " << (busyAfter - busyBefore) / 1e9 / (wall * (workers + 1)) * 100 << "%, steals "
+            << sharedScheduler().stealCount() << (t.sessions == n && is_sorted(sorted.begin(), sorted.end()) ? "" : ", MISMATCH") << "\n";
+    }
+    cout << defaultfloat;
+    setTaskWorkers(defaultTaskWorkers());
+}
+
+#ifdef __linux__
+// Loopback requests per second through the epoll server and the bundled load client,
+// unpipelined and pipelined, for an inline route and a worker-pool route
+void benchHttpServer(size_t n) {
+    size_t stored = min<size_t>(n, 10000);
+    cout << "\n--- HTTP API (" << stored << " sessions, " << thread::hardware_concurrency() << " threads) ---\n";
+
+    SnapshotSessionContainer sessions;
+    WorkloadConfig config;
+    for (size_t i = 0; i < stored; i++) {
+        GeneratedSession g = generateSession(config, i);
+        sessions.add(makeSession(g.type, workloadLocation(g.locationId), g.duration, g.difficulty, g.count, LootInfo(g.gold, g.rare)));
+    }
+    SessionApi api(sessions);
+    HttpServer server(api);
+    thread loop([&] { server.run(); });
+
+    struct Run { const char* target; int pipeline; int requests; };
+    for (Run run : { Run{ "/health", 1, 5000 }, Run{ "/health", 16, 20000 }, Run{ "/aggregates", 1, 100 }, Run{ "/aggregates", 16, 100 } }) {
+        HttpLoadOptions options;
+        options.target = run.target;
+        options.pipeline = run.pipeline;
+        options.requestsPerConnection = run.requests;
+        HttpLoadResult result = runHttpLoad(server.port(), options);
+        cout << left << setw(12) << run.target << right << " pipeline " << setw(2) << run.pipeline << ": " << fixed
+            << setprecision(0) << result.requests / result.seconds << " requests/s (" << result.failures << " failed)\n"
+            << defaultfloat;
+    }
+
+    server.stop();
+    loop.join();
+}
+#endif
+
+// Column-at-a-time filter evaluation against the compiled row predicate
+void benchFilterScan(size_t n) {
+    cout << "\n--- Filter expressions (" << n << " sessions) ---\n";
+
+    SessionColumns columns;
+    columns.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        LootInfo loot(static_cast<int>(i % 200), i % 17 == 0);
+        columns.add(i % 2 ? EXPLORATION_SESSION : COMBAT_SESSION, benchLocation(i), static_cast<int>(30 + i % 90),
+            static_cast<Difficulty>(EXPLORER + i % 3), static_cast<int>(i % 20), loot);
+    }
+    SessionFilter filter("type == combat && difficulty >= balanced && durationMinutes > 45 && rareItemFound");
+
+    auto start = BenchClock::now();
+    size_t matched = filter.count(columns);
+    double columnSecs = secondsSince(start);
+
+    // Row predicate over the same sessions as objects, capped to keep memory sane
+    size_t rowsN = min<size_t>(n, 1000000);
+    vector<unique_ptr<PlaySession>> rows;
+    rows.reserve(rowsN);
+    for (size_t i = 0; i < rowsN; i++) {
+        rows.emplace_back(makeSession(static_cast<SessionType>(columns.type[i]), columns.locations.name(columns.locationId[i]),
+            columns.duration[i], static_cast<Difficulty>(columns.difficulty[i]), columns.count[i],
+            LootInfo(columns.gold[i], columns.rare[i] != 0)));
+    }
+    start = BenchClock::now();
+    size_t rowMatched = 0;
+    for (const auto& row : rows) rowMatched += filter.matches(*row);
+    double rowSecs = secondsSince(start) * (double(n) / rowsN);
+
+    cout << fixed << setprecision(2);
+    cout << "Columns: " << columnSecs * 1000 << " ms (" << n / columnSecs / 1e6 << " M sessions/s, " << matched << " match)\n";
+    cout << "Row predicate: " << rowSecs * 1000 << " ms scaled to " << n << " (" << rowSecs / columnSecs << "x slower)\n"
+        << defaultfloat;
+    (void)rowMatched;
+}
+
+// Encode and decode through the wire format and through JSON text
+void benchWireFormat(size_t n) {
+    n = min<size_t>(n, 1000000);    // a JSON document for more than this does not fit in memory comfortably
+    cout << "\n--- Wire format vs JSON (" << n << " sessions) ---\n";
 
-        case 10:  // Enqueue to queue and Dequeue from queue
-            queue.enqueue(new ExplorationSession("Forest", 60, EXPLORER, 3, LootInfo()));
-            break;
-            try { queue.dequeue(); } catch (...) { cout << "Empty\n"; }
-            break;
-        }
+    // Head insertion in reverse keeps the build linear and the order ascending
+    SessionLinkedList list;
+    for (size_t i = n; i-- > 0;) {
+        list.insertFront(benchSession(i));
+    }
 
-    } while (choice != 6);
+    auto start = BenchClock::now();
+    SessionWireWriter writer;
+    for (const PlaySession& s : list) writer.add(s);
+    string wire = writer.finish();
+    double wireEncode = secondsSince(start);
+
+    start = BenchClock::now();
+    json doc = json::array();
+    for (const PlaySession& s : list) doc.push_back(sessionToJson(s));
+    string text = doc.dump();
+    double jsonEncode = secondsSince(start);
+    doc = json();
+
+    start = BenchClock::now();
+    SessionWireView view(wire.data(), wire.size());
+    double wireValue = 0;
+    for (size_t i = 0; i < view.size(); i++) wireValue += view.record(i).calculateValue();
+    double wireDecode = secondsSince(start);
+
+    start = BenchClock::now();
+    double jsonValue = 0;
+    for (const json& record : json::parse(text)) {
+        unique_ptr<PlaySession> s(sessionFromJson(record));
+        jsonValue += s->calculateValue();
+    }
+    double jsonDecode = secondsSince(start);
 
-    #ifdef _DEBUG
-        _CrtDumpMemoryLeaks();
-    #endif
+    cout << fixed << setprecision(2);
+    cout << "Size:   wire " << wire.size() / 1048576.0 << " MiB, JSON " << text.size() / 1048576.0 << " MiB\n";
+    cout << "Encode: wire " << wireEncode * 1000 << " ms, JSON " << jsonEncode * 1000 << " ms\n";
+    cout << "Decode: wire " << wireDecode * 1000 << " ms, JSON " << jsonDecode * 1000 << " ms ("
+        << jsonDecode / wireDecode << "x" << (wireValue == jsonValue ? "" : ", MISMATCH") << ")\n" << defaultfloat;
+}
 
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? stoull(argv[1]) : 10000000;
+
+    benchCompactFootprint(n);
+    benchConcurrentContainer(n);
+    benchColumnKernels(n);
+    benchBatchRecommendations(n);
+    benchWireFormat(n);
+    benchSessionArchive(n);
+    benchWorkloadGenerator(n);
+    benchPriorityQueue(n);
+    benchCsv(n);
+    benchFilterScan(n);
+    benchTaskScheduler(n);
+    benchSessionIteration(n);
+    benchDeduplication(n);
+    benchSessionMerge(n);
+#ifdef __linux__
+    benchHttpServer(n);
+#endif
     return 0;
 }
 #endif
@@ -660,6 +7802,2256 @@ TEST_CASE("JSON loader throws when the file is malformed") {
 	CHECK_THROWS_AS(loadSessionsFromJson(badFileName, manager), runtime_error);
 	std::remove(badFileName.c_str());
 }
+
+// ---------- K) Roster ----------
+TEST_CASE("Roster looks up characters by id and rejects duplicates") {
+	CharacterRoster roster(4);
+	roster.addCharacter(7, Character{ "Shadowheart", 5, 120, BALANCED });
+	roster.addCharacter(12, Character{ "Astarion", 9, 300, TACTICIAN });
+
+	CHECK(roster.size() == 2);
+	CHECK(roster.contains(7));
+	CHECK_FALSE(roster.contains(8));
+	CHECK_THROWS_AS(roster.addCharacter(7, Character{ "Karlach", 3, 0, EXPLORER }), ContainerException);
+
+	string name;
+	CHECK(roster.withCharacter(12, [&](RosterEntry& e) { name = e.character.name; }));
+	CHECK(name == "Astarion");
+	CHECK_FALSE(roster.withCharacter(99, [](RosterEntry&) {}));
+
+	CHECK(roster.removeCharacter(7));
+	CHECK(roster.size() == 1);
+}
+
+TEST_CASE("Roster totals aggregate across every shard") {
+	CharacterRoster roster(3);
+	for (int id = 0; id < 10; id++) {
+		roster.addCharacter(id, Character{ "Tav", 4, 10, BALANCED });
+		roster.withCharacter(id, [](RosterEntry& e) {
+			e.sessions.add(new CombatSession("Camp", 30, BALANCED, 5, LootInfo()));
+			e.sessions.add(new ExplorationSession("Forest", 60, EXPLORER, 4, LootInfo()));
+		});
+	}
+
+	RosterTotals t = roster.totals();
+	CHECK(t.characters == 10);
+	CHECK(t.sessions == 20);
+	CHECK(t.minutes == 900);
+	CHECK(t.gold == 100);
+	CHECK(t.sessionValue == 700.0);
+}
+
+TEST_CASE("Roster saves and reloads every character") {
+	const string dir = "roster_test_dir";
+	{
+		CharacterRoster roster;
+		roster.addCharacter(1, Character{ "Gale", 6, 55.5, TACTICIAN });
+		roster.addCharacter(2, Character{ "Lae'zel", 2, 0, EXPLORER });
+		roster.withCharacter(1, [](RosterEntry& e) {
+			e.sessions.add(new CombatSession("Goblin Camp", 70, TACTICIAN, 14, LootInfo(95, true)));
+		});
+		roster.saveAll(dir);
+	}
+
+	CharacterRoster loaded(5);
+	CHECK(loaded.loadAll(dir) == 1);
+	CHECK(loaded.size() == 2);
+	loaded.withCharacter(1, [](RosterEntry& e) {
+		CHECK(e.character.name == "Gale");
+		CHECK(e.character.difficulty == TACTICIAN);
+		REQUIRE(e.sessions.size() == 1);
+		CHECK(e.sessions.at(0)->getLocation() == "Goblin Camp");
+	});
+
+	// A bad session file names itself and leaves the roster untouched
+	const string badFile = (filesystem::path(dir) / "character_2.json").string();
+	ofstream(badFile) << "[{\"type\": \"combat\"";
+	CharacterRoster partial;
+	partial.addCharacter(7, Character{ "Karlach", 3, 2, BALANCED });
+	try {
+		partial.loadAll(dir);
+		FAIL("loadAll accepted a truncated session file");
+	}
+	catch (const runtime_error& e) {
+		CHECK(string(e.what()).find(badFile) != string::npos);
+	}
+	CHECK(partial.size() == 1);
+	CHECK_FALSE(partial.contains(1));
+
+	// So does an id clash with a character already in the roster
+	std::remove(badFile.c_str());
+	partial.addCharacter(2, Character{ "Shadowheart", 5, 8, BALANCED });
+	CHECK_THROWS_AS(partial.loadAll(dir), ContainerException);
+	CHECK(partial.size() == 2);
+	CHECK_FALSE(partial.contains(1));
+
+	filesystem::remove_all(dir);
+}
+
+// ---------- L) Compact Sessions ----------
+TEST_CASE("Compact sessions pack every field into 12 bytes") {
+	CompactSessionStore store;
+	store.add(CombatSession("Moonrise Towers", 65, TACTICIAN, 11, LootInfo(120, true)));
+	store.add(ExplorationSession("Emerald Grove", 50, EXPLORER, 4, LootInfo(22, false)));
+	store.add(CombatSession("Moonrise Towers", 10, BALANCED, 1, LootInfo()));
+
+	CHECK(sizeof(CompactSession) == 12);
+	CHECK(store.getLocations().size() == 2);
+
+	const CompactSession& c = store.at(0);
+	CHECK(store.locationOf(0) == "Moonrise Towers");
+	CHECK(c.getType() == COMBAT_SESSION);
+	CHECK(c.getDifficulty() == TACTICIAN);
+	CHECK(c.getDuration() == 65);
+	CHECK(c.getCount() == 11);
+	CHECK(c.getGoldEarned() == 120);
+	CHECK(c.isRareItemFound());
+	CHECK(c.calculateValue() == 110.0);
+
+	PlaySession* e = store.expand(1);
+	REQUIRE(dynamic_cast<ExplorationSession*>(e) != nullptr);
+	CHECK(e->getLocation() == "Emerald Grove");
+	CHECK(e->calculateValue() == 20.0);
+	CHECK_FALSE(sessionLoot(*e).isRareItemFound());
+	delete e;
+}
+
+TEST_CASE("Compact sessions reject values wider than their fields") {
+	CompactSessionStore store;
+	CHECK_THROWS_AS(store.add(CombatSession("Camp", 70000, BALANCED, 5, LootInfo())), ContainerException);
+	CHECK_THROWS_AS(store.add(CombatSession("Camp", 30, BALANCED, -1, LootInfo())), ContainerException);
+	CHECK(store.size() == 0);
+	CHECK(store.getLocations().size() == 0);
+
+	store.add(CombatSession("Forest", 30, BALANCED, 1, LootInfo()));
+	CHECK_THROWS_AS(store.add("Camp", COMBAT_SESSION, BALANCED, 30, 1, LootInfo(-5, false)), ContainerException);
+	store.add(CombatSession("Camp", 30, BALANCED, 1, LootInfo()));
+	CHECK(store.getLocations().size() == 2);
+	CHECK(store.locationOf(1) == "Camp");
+}
+
+// ---------- M) Snapshot Container ----------
+// Counts destructor calls so the tests can see when a removed session is reclaimed
+struct TrackedSession : public CombatSession {
+	static int destroyed;
+	TrackedSession(const string& loc) : CombatSession(loc, 30, BALANCED, 5, LootInfo()) {}
+	~TrackedSession() { destroyed++; }
+};
+int TrackedSession::destroyed = 0;
+
+TEST_CASE("Snapshots are unaffected by later adds and removes") {
+	SnapshotSessionContainer store;
+	for (int i = 0; i < 600; i++)
+		store.add(new CombatSession("Loc" + to_string(i), i, BALANCED, 1, LootInfo()));
+
+	auto before = store.snapshot();
+	store.add(new ExplorationSession("Forest", 60, EXPLORER, 3, LootInfo()));
+	store.remove(0);
+	store.remove(300);
+
+	CHECK(before.size() == 600);
+	CHECK(before.at(0).getLocation() == "Loc0");
+	CHECK(before.at(599).getLocation() == "Loc599");
+	CHECK(before.linearSearch("Forest") == -1);
+
+	auto after = store.snapshot();
+	CHECK(after.size() == 599);
+	CHECK(after.at(0).getLocation() == "Loc1");
+	CHECK(after.at(300).getLocation() == "Loc302");
+	CHECK(after.linearSearch("Forest") == 598);
+	CHECK_THROWS_AS(after.at(599), ContainerException);
+	CHECK_THROWS_AS(store.remove(599), ContainerException);
+}
+
+TEST_CASE("Removed sessions are reclaimed after the last snapshot is released") {
+	TrackedSession::destroyed = 0;
+	SnapshotSessionContainer store;
+	store.add(new TrackedSession("Camp"));
+	store.add(new TrackedSession("Forest"));
+	{
+		auto reader = store.snapshot();
+		store.remove(0);
+		CHECK(TrackedSession::destroyed == 0);
+		CHECK(reader.at(0).getLocation() == "Camp");
+	}
+	CHECK(TrackedSession::destroyed == 1);
+}
+
+TEST_CASE("Readers iterate snapshots while a writer appends and removes") {
+	SnapshotSessionContainer store;
+	atomic<bool> done{ false };
+
+	thread writer([&]() {
+		for (int i = 0; i < 5000; i++) {
+			store.add(new CombatSession("Camp", 10, BALANCED, 1, LootInfo()));
+			if (i % 3 == 0) store.remove(0);
+		}
+		done = true;
+	});
+
+	bool consistent = true;
+	while (!done) {
+		auto snap = store.snapshot();
+		int minutes = 0;
+		snap.forEach([&](const PlaySession& s) { minutes += s.getDuration(); });
+		if (minutes != static_cast<int>(snap.size()) * 10) consistent = false;
+	}
+	writer.join();
+
+	CHECK(consistent);
+	CHECK(store.size() == 5000 - 1667);
+}
+
+// ---------- N) Concurrent Container ----------
+TEST_CASE("Concurrent container accepts adds from many threads") {
+	ConcurrentSessionContainer store(8);
+	vector<thread> writers;
+	for (int t = 0; t < 4; t++) {
+		writers.emplace_back([&store, t]() {
+			for (int i = 0; i < 1000; i++)
+				store.add(new CombatSession(t == 0 ? "Camp" : "Forest", 10, BALANCED, 2, LootInfo()));
+		});
+	}
+	// Searches and totals run while the writers are still going
+	while (store.size() < 4000) store.totalMinutes();
+	for (thread& w : writers) w.join();
+
+	CHECK(store.size() == 4000);
+	CHECK(store.countLocation("Camp") == 1000);
+	CHECK(store.contains("Forest"));
+	CHECK_FALSE(store.contains("Underdark"));
+	CHECK(store.totalMinutes() == 40000);
+	CHECK(store.totalValue() == 80000.0);
+}
+
+// ---------- O) Background Loading ----------
+TEST_CASE("JSON array reader yields elements one at a time") {
+	istringstream in(" [ {\"a\": \"x],{\\\"\"}, [1, [2]] ,3 ] ");
+	JsonArrayReader reader(in);
+	json j;
+
+	REQUIRE(reader.next(j));
+	CHECK(j["a"] == "x],{\"");
+	REQUIRE(reader.next(j));
+	CHECK(j[1][0] == 2);
+	REQUIRE(reader.next(j));
+	CHECK(j == 3);
+	CHECK_FALSE(reader.next(j));
+
+	istringstream empty("[]");
+	JsonArrayReader emptyReader(empty);
+	CHECK_FALSE(emptyReader.next(j));
+
+	istringstream cut("[{\"a\": 1}, {");
+	JsonArrayReader cutReader(cut);
+	CHECK(cutReader.next(j));
+	CHECK_THROWS_AS(cutReader.next(j), runtime_error);
+}
+
+TEST_CASE("Background load fills the container in file order") {
+	SessionContainer manager;
+	AsyncSessionLoad load("sessions.json");
+	load.wait();
+
+	CHECK(load.drainInto(manager) == 5);
+	CHECK(manager.size() == 5);
+	CHECK(manager.at(0)->getLocation() == "Nautiloid Crash Site");
+	CHECK(manager.at(4)->getLocation() == "Moonrise Towers");
+
+	LoadProgress p = load.progress();
+	CHECK(p.done);
+	CHECK(p.sessionsParsed == 5);
+	CHECK(p.bytesRead == p.totalBytes);
+	CHECK(p.error.empty());
+}
+
+TEST_CASE("Background load reports failures but keeps earlier sessions") {
+	CHECK_THROWS_AS(AsyncSessionLoad("missing_sessions.json"), runtime_error);
+
+	const string badFileName = "bad_async_sessions.json";
+	ofstream badFile(badFileName);
+	badFile << "[{\"type\": \"combat\", \"location\": \"Camp\", \"durationMinutes\": 30, \"difficulty\": \"Balanced\"},"
+		<< " {\"type\": \"dragon\"}]";
+	badFile.close();
+
+	SessionContainer manager;
+	{
+		AsyncSessionLoad load(badFileName);
+		CHECK_THROWS_AS(load.wait(), runtime_error);
+		CHECK(load.drainInto(manager) == 1);
+		CHECK_FALSE(load.progress().error.empty());
+	}
+	CHECK(manager.at(0)->getLocation() == "Camp");
+	std::remove(badFileName.c_str());
+}
+
+// ---------- P) Session Sources ----------
+TEST_CASE("Session generator yields JSON sessions lazily in order") {
+	vector<string> seen;
+	for (auto& s : SessionGenerator(openSessionSource("sessions.json")))
+		seen.push_back(s->getLocation());
+
+	REQUIRE(seen.size() == 5);
+	CHECK(seen[0] == "Nautiloid Crash Site");
+	CHECK(seen[4] == "Moonrise Towers");
+}
+
+TEST_CASE("JSON lines round trip through the streaming sinks") {
+	const string fileName = "sessions_test.jsonl";
+	{
+		SessionContainer manager;
+		loadSessionsFromJson("sessions.json", manager);
+		saveSessionsToJsonLines(fileName, manager);
+	}
+
+	auto source = openSessionSource(fileName);
+	SessionTotals totals = accumulate(*source);
+	CHECK(totals.sessions == 5);
+	CHECK(totals.minutes == 300);
+	CHECK(totals.gold == 326);
+	CHECK(totals.rareItems == 3);
+	CHECK(totals.value == 355.0);
+
+	SessionContainer manager;
+	auto again = openSessionSource(fileName);
+	CHECK(drainInto(*again, manager) == 5);
+	CHECK(dynamic_cast<ExplorationSession*>(manager.at(3)) != nullptr);
+	std::remove(fileName.c_str());
+}
+
+// ---------- Q) Column Kernels ----------
+TEST_CASE("Every kernel set matches the scalar kernels") {
+	// Odd length so every vector loop also runs its scalar tail
+	const size_t n = 1000 * 37 + 13;
+	vector<int32_t> values(n), counts(n);
+	vector<uint8_t> types(n), flags(n);
+	unsigned seed = 12345;
+	for (size_t i = 0; i < n; i++) {
+		seed = seed * 1103515245u + 12345u;
+		values[i] = static_cast<int32_t>(seed);
+		counts[i] = static_cast<int32_t>(seed >> 20);
+		types[i] = (seed >> 7) & 1;
+		flags[i] = (seed >> 9) % 3;
+	}
+	values[5] = numeric_limits<int32_t>::min();
+	values[n - 1] = numeric_limits<int32_t>::max();
+
+	const SessionKernels& ref = scalarSessionKernels();
+	int32_t refLo, refHi;
+	ref.minMaxInt32(values.data(), n, refLo, refHi);
+	CHECK(refLo == numeric_limits<int32_t>::min());
+	CHECK(refHi == numeric_limits<int32_t>::max());
+
+	for (const SessionKernels* k : { sse2SessionKernels(), avx2SessionKernels() }) {
+		if (!k) continue;
+		CAPTURE(k->name);
+		for (size_t len : { size_t(0), size_t(3), size_t(31), n }) {
+			CHECK(k->sumInt32(values.data(), len) == ref.sumInt32(values.data(), len));
+			CHECK(k->countEqualU8(flags.data(), len, 2) == ref.countEqualU8(flags.data(), len, 2));
+			CHECK(k->countGreaterInt32(values.data(), len, 1000) == ref.countGreaterInt32(values.data(), len, 1000));
+			CHECK(k->weightedValue(counts.data(), types.data(), len) == ref.weightedValue(counts.data(), types.data(), len));
+
+			int32_t lo, hi;
+			k->minMaxInt32(values.data(), len, lo, hi);
+			ref.minMaxInt32(values.data(), len, refLo, refHi);
+			CHECK(lo == refLo);
+			CHECK(hi == refHi);
+		}
+	}
+}
+
+TEST_CASE("Column totals match the per-session values") {
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+	SessionColumns columns = SessionColumns::from(manager);
+
+	ColumnTotals t = aggregateColumns(columns);
+	CHECK(t.sessions == 5);
+	CHECK(t.minutes == 300);
+	CHECK(t.gold == 326);
+	CHECK(t.shortest == 35);
+	CHECK(t.longest == 80);
+	CHECK(t.rareItems == 3);
+	CHECK(t.combatSessions == 3);
+	CHECK(t.longSessions == 3);
+	CHECK(t.value == 355.0);
+	CHECK(columns.locations.name(columns.locationId[2]) == "Goblin Camp");
+}
+
+// ---------- R) Session Registry ----------
+TEST_CASE("Registry dispatches on the stored type id") {
+	LootInfo loot(40, true);
+	CombatSession c("Camp", 30, BALANCED, 5, loot);
+	ExplorationSession e("Forest", 60, EXPLORER, 4, loot);
+	const PlaySession& pc = c;
+	const PlaySession& pe = e;
+
+	CHECK(pc.getType() == COMBAT_SESSION);
+	CHECK(pe.getType() == EXPLORATION_SESSION);
+	CHECK(sessionCount(pe) == 4);
+	CHECK(sessionLoot(pc).getGoldEarned() == 40);
+	CHECK(sessionValue(pc) == pc.calculateValue());
+	CHECK(sessionValue(pe) == pe.calculateValue());
+	CHECK(string(RegisteredSessions::tagOf(EXPLORATION_SESSION)) == "exploration");
+	CHECK(RegisteredSessions::valuePerCount(COMBAT_SESSION) == 10.0);
+
+	SessionType id;
+	CHECK(RegisteredSessions::findTag("combat", id));
+	CHECK(id == COMBAT_SESSION);
+	CHECK_FALSE(RegisteredSessions::findTag("dialogue", id));
+
+	PlaySession* made = makeSession(EXPLORATION_SESSION, "Underdark", 80, BALANCED, 5, loot);
+	CHECK(made->getType() == EXPLORATION_SESSION);
+	CHECK(made->calculateValue() == 25.0);
+	delete made;
+}
+
+TEST_CASE("Registry-generated JSON round trips every registered type") {
+	CombatSession c("Goblin Camp", 70, TACTICIAN, 14, LootInfo(95, true));
+	json j = sessionToJson(c);
+	CHECK(j["type"] == "combat");
+	CHECK(j["enemiesDefeated"] == 14);
+
+	unique_ptr<PlaySession> back(sessionFromJson(j));
+	CHECK(back->getType() == COMBAT_SESSION);
+	CHECK(sessionCount(*back) == 14);
+	CHECK(sessionLoot(*back).isRareItemFound());
+
+	j["type"] = "dialogue";
+	CHECK_THROWS_AS(sessionFromJson(j), runtime_error);
+}
+
+// ---------- S) Batch Recommendations ----------
+TEST_CASE("Batch recommendations match the scalar function exactly") {
+	vector<double> hourValues = { -1.0, 0.0, 1.0, nextafter(1.5, 0.0), 1.5, nextafter(1.5, 2.0), 2.0, 100.0,
+		numeric_limits<double>::infinity(), -numeric_limits<double>::infinity(), numeric_limits<double>::quiet_NaN() };
+	vector<int> levels;
+	vector<double> hours;
+	for (int level = -2; level <= 15; level++) {
+		for (double h : hourValues) {
+			levels.push_back(level);
+			hours.push_back(h);
+		}
+	}
+	levels.push_back(numeric_limits<int>::min());
+	hours.push_back(5.0);
+	levels.push_back(numeric_limits<int>::max());
+	hours.push_back(5.0);
+
+	vector<Difficulty> out(levels.size());
+	recommendDifficultyBatch(levels.data(), hours.data(), out.data(), out.size());
+
+	bool allMatch = true;
+	for (size_t i = 0; i < out.size(); i++)
+		if (out[i] != recommendDifficultyByStats(levels[i], hours[i])) allMatch = false;
+	CHECK(allMatch);
+}
+
+TEST_CASE("Batch recommendations from session stats follow menu case 4") {
+	int levels[] = { 5, 9, 9, 2 };
+	int minutes[] = { 300, 90, 200, 600 };
+	int counts[] = { 2, 1, 0, 3 };
+	Difficulty out[4];
+	recommendDifficultyBatch(levels, minutes, counts, out, 4);
+
+	CHECK(out[0] == BALANCED);      // 2.5 hours per session
+	CHECK(out[1] == TACTICIAN);     // exactly 1.5 hours
+	CHECK(out[2] == EXPLORER);      // no sessions
+	CHECK(out[3] == EXPLORER);      // level too low
+}
+
+TEST_CASE("Roster re-scores every character with sessions") {
+	CharacterRoster roster(2);
+	roster.addCharacter(1, Character{ "Wyll", 10, 0, EXPLORER });
+	roster.addCharacter(2, Character{ "Minsc", 6, 0, TACTICIAN });
+	roster.addCharacter(3, Character{ "Jaheira", 12, 0, BALANCED });
+	roster.withCharacter(1, [](RosterEntry& e) { e.sessions.add(new CombatSession("Camp", 120, BALANCED, 5, LootInfo())); });
+	roster.withCharacter(2, [](RosterEntry& e) { e.sessions.add(new CombatSession("Camp", 30, BALANCED, 5, LootInfo())); });
+
+	CHECK(roster.updateRecommendedDifficulties() == 2);
+	roster.withCharacter(1, [](RosterEntry& e) { CHECK(e.character.difficulty == TACTICIAN); });
+	roster.withCharacter(2, [](RosterEntry& e) { CHECK(e.character.difficulty == EXPLORER); });
+	roster.withCharacter(3, [](RosterEntry& e) { CHECK(e.character.difficulty == BALANCED); });
+}
+
+// ---------- T) Wire Format ----------
+TEST_CASE("Wire format round trips sessions and reads them in place") {
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+	manager.add(new CombatSession("Nautiloid Crash Site", 5, EXPLORER, 1, LootInfo(-3, false)));
+
+	SessionWireWriter writer;
+	for (const PlaySession& s : manager) writer.add(s);
+	string bytes = writer.finish();
+
+	// Header + six 24-byte records + the five distinct location names
+	CHECK(bytes.size() == 40 + 6 * 24 + string("Nautiloid Crash SiteEmerald GroveGoblin CampUnderdarkMoonrise Towers").size());
+	CHECK(bytes.compare(0, 4, "BGSW") == 0);
+	CHECK(static_cast<unsigned char>(bytes[4]) == 1);
+
+	SessionWireView view(bytes.data(), bytes.size());
+	REQUIRE(view.size() == 6);
+	WireRecordView r = view.record(2);
+	CHECK(r.getLocation() == "Goblin Camp");
+	CHECK(r.getType() == COMBAT_SESSION);
+	CHECK(r.getDifficulty() == TACTICIAN);
+	CHECK(r.getDuration() == 70);
+	CHECK(r.getCount() == 14);
+	CHECK(r.getGoldEarned() == 95);
+	CHECK(r.isRareItemFound());
+	CHECK(r.calculateValue() == 140.0);
+	CHECK(view.record(5).getGoldEarned() == -3);
+	CHECK(view.record(5).getLocation().data() == view.record(0).getLocation().data());
+
+	unique_ptr<PlaySession> back(view.record(1).toSession());
+	CHECK(back->getType() == EXPLORATION_SESSION);
+	CHECK(sessionCount(*back) == 4);
+}
+
+TEST_CASE("Wire reader rejects corrupt buffers") {
+	SessionWireWriter writer;
+	writer.add(CombatSession("Camp", 30, BALANCED, 5, LootInfo(10, true)));
+	string bytes = writer.finish();
+
+	string flipped = bytes;
+	flipped[40 + 8] ^= 1;
+	CHECK_THROWS_AS(SessionWireView(flipped.data(), flipped.size()), runtime_error);
+
+	string newer = bytes;
+	newer[4] = 2;
+	CHECK_THROWS_AS(SessionWireView(newer.data(), newer.size()), runtime_error);
+
+	CHECK_THROWS_AS(SessionWireView(bytes.data(), bytes.size() - 1), runtime_error);
+	CHECK_THROWS_AS(SessionWireView(bytes.data(), 10), runtime_error);
+	CHECK_NOTHROW(SessionWireView(bytes.data(), bytes.size()));
+
+	// A difficulty byte outside EXPLORER..TACTICIAN, with a checksum that matches it
+	auto resealed = [](string b) {
+		WireChecksum sum;
+		sum.update(b.data() + WIRE_HEADER_SIZE, b.size() - WIRE_HEADER_SIZE);
+		storeLE32(&b[32], sum.value());
+		return b;
+	};
+	for (char diff : { 0, 4 }) {
+		string badDifficulty = bytes;
+		badDifficulty[WIRE_HEADER_SIZE + 21] = diff;
+		badDifficulty = resealed(badDifficulty);
+		CHECK_THROWS_AS(SessionWireView(badDifficulty.data(), badDifficulty.size()), runtime_error);
+
+		const string fileName = "bad_difficulty.bgsw";
+		ofstream(fileName, ios::binary) << badDifficulty;
+		CHECK_THROWS_AS(openSessionSource(fileName)->next(), runtime_error);
+		std::remove(fileName.c_str());
+	}
+
+	// Section sizes are checked against the file before anything is allocated for them
+	string hugeStrings = bytes;
+	storeLE64(&hugeStrings[24], 1ull << 50);
+	const string fileName = "huge_strings.bgsw";
+	ofstream(fileName, ios::binary) << hugeStrings;
+	CHECK_THROWS_AS(openSessionSource(fileName), runtime_error);
+	CHECK_THROWS_AS(buildLocationIndex(fileName, "huge_strings.bgsi"), runtime_error);
+	CHECK_THROWS_AS(WireRecordFile{ fileName }, runtime_error);
+	std::remove(fileName.c_str());
+}
+
+TEST_CASE("Wire files load and stream through a session source") {
+	const string fileName = "sessions_test.bgsw";
+	{
+		SessionContainer manager;
+		loadSessionsFromJson("sessions.json", manager);
+		saveSessionsToWire(fileName, manager);
+	}
+
+	SessionContainer loaded;
+	CHECK(loadSessionsFromWire(fileName, loaded) == 5);
+	CHECK(loaded.at(4)->getLocation() == "Moonrise Towers");
+
+	auto source = openSessionSource(fileName);
+	SessionTotals totals = accumulate(*source);
+	CHECK(totals.sessions == 5);
+	CHECK(totals.gold == 326);
+	CHECK(totals.value == 355.0);
+	std::remove(fileName.c_str());
+}
+
+// ---------- U) Incremental Report ----------
+string readWholeFile(const string& fileName) {
+	ifstream in(fileName, ios::binary);
+	return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+TEST_CASE("Report saves rewrite only the sections that changed") {
+	const string path = "report_test.txt";
+	Character hero{ "Tav", 5, 100, BALANCED };
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+
+	ReportWriter report(path);
+	ReportSaveStats first = report.save(hero, manager);
+	CHECK(first.fullRewrite);
+	CHECK(first.sectionsWritten == 6);
+	CHECK(readWholeFile(path).find("Session #1:\nLocation: Emerald Grove\nDuration: 50\n") != string::npos);
+
+	CHECK(report.save(hero, manager).sectionsWritten == 0);
+
+	manager.add(new CombatSession("Camp", 30, BALANCED, 5, LootInfo()));
+	CHECK(report.save(hero, manager).sectionsWritten == 1);
+
+	hero.gold = 250;
+	CHECK(report.save(hero, manager).sectionsWritten == 1);
+	CHECK(readWholeFile(path).find("Gold: 250.00") != string::npos);
+
+	// Removing session 3 renumbers the two after it
+	manager.remove(3);
+	CHECK(report.save(hero, manager).sectionsWritten == 2);
+
+	// A long name outgrows the header slot, so every section moves
+	hero.name = string(300, 'x');
+	CHECK(report.save(hero, manager).sectionsWritten == 6);
+
+	// The incremental file is byte for byte what a fresh full save produces
+	const string freshPath = "report_fresh_test.txt";
+	SessionContainer again;
+	loadSessionsFromJson("sessions.json", again);
+	again.add(new CombatSession("Camp", 30, BALANCED, 5, LootInfo()));
+	again.remove(3);
+	ReportWriter(freshPath).save(hero, again);
+	CHECK(readWholeFile(path) == readWholeFile(freshPath));
+
+	for (const string& f : { path, path + ".idx", freshPath, freshPath + ".idx" }) std::remove(f.c_str());
+}
+
+TEST_CASE("Report writer reuses the sidecar index across runs") {
+	const string path = "report_reuse_test.txt";
+	Character hero{ "Karlach", 8, 10, TACTICIAN };
+	{
+		SessionContainer manager;
+		loadSessionsFromJson("sessions.json", manager);
+		ReportWriter(path).save(hero, manager);
+	}
+
+	SessionContainer reloaded;
+	loadSessionsFromJson("sessions.json", reloaded);
+	reloaded.add(new ExplorationSession("Forest", 60, EXPLORER, 3, LootInfo()));
+	ReportSaveStats stats = ReportWriter(path).save(hero, reloaded);
+	CHECK_FALSE(stats.fullRewrite);
+	CHECK(stats.sectionsWritten == 1);
+
+	// A report edited by hand no longer matches its index and is rebuilt
+	ofstream(path, ios::app) << "note\n";
+	CHECK(ReportWriter(path).save(hero, reloaded).fullRewrite);
+
+	for (const string& f : { path, path + ".idx" }) std::remove(f.c_str());
+}
+
+// ---------- V) Session Archive ----------
+TEST_CASE("Archive varints and zigzag cover the full int range") {
+	for (int32_t v : { 0, 1, -1, 63, -64, 64, 1000, -1000, numeric_limits<int32_t>::max(), numeric_limits<int32_t>::min() })
+		CHECK(zigzagDecode(zigzagEncode(v)) == v);
+	CHECK(zigzagEncode(-1) == 1u);
+	CHECK(zigzagEncode(1) == 2u);
+
+	string bytes;
+	putVarint(bytes, 127);
+	putVarint(bytes, 128);
+	putVarint(bytes, 0xFFFFFFFFu);
+	CHECK(bytes.size() == 1 + 2 + 5);
+	const char* p = bytes.data();
+	CHECK(getVarint(p, bytes.data() + bytes.size()) == 127u);
+	CHECK(getVarint(p, bytes.data() + bytes.size()) == 128u);
+	CHECK(getVarint(p, bytes.data() + bytes.size()) == 0xFFFFFFFFu);
+	CHECK_THROWS_AS(getVarint(p, bytes.data() + bytes.size()), runtime_error);
+}
+
+TEST_CASE("Archive round trips columns across several blocks") {
+	SessionColumns columns;
+	for (int i = 0; i < 1000; i++) {
+		columns.add(i % 3 ? COMBAT_SESSION : EXPLORATION_SESSION, "Zone " + to_string(i % 7), 30 + (i * 37) % 200,
+			static_cast<Difficulty>(EXPLORER + i % 3), i % 25, LootInfo(i % 11 ? i : -i, i % 13 == 0));
+	}
+	columns.add(COMBAT_SESSION, "Edge", numeric_limits<int32_t>::min(), BALANCED, numeric_limits<int32_t>::max(), LootInfo());
+	columns.add(COMBAT_SESSION, "Edge", numeric_limits<int32_t>::max(), BALANCED, 0, LootInfo());
+
+	stringstream archive;
+	writeSessionArchive(archive, columns, 128);
+
+	SessionArchiveReader reader(archive);
+	CHECK(reader.size() == 1002);
+	CHECK(reader.locationCount() == 8);
+
+	SessionColumns block;
+	size_t row = 0, blocks = 0;
+	while (reader.next(block)) {
+		blocks++;
+		CHECK(block.size() <= 128);
+		for (size_t i = 0; i < block.size(); i++, row++) {
+			CHECK(block.duration[i] == columns.duration[row]);
+			CHECK(block.count[i] == columns.count[row]);
+			CHECK(block.gold[i] == columns.gold[row]);
+			CHECK(block.type[i] == columns.type[row]);
+			CHECK(block.difficulty[i] == columns.difficulty[row]);
+			CHECK(block.rare[i] == columns.rare[row]);
+			CHECK(reader.location(block.locationId[i]) == columns.locations.name(columns.locationId[row]));
+		}
+	}
+	CHECK(row == 1002);
+	CHECK(blocks == 8);
+}
+
+TEST_CASE("Archive aggregates while streaming and stays small") {
+	SessionColumns columns;
+	for (int i = 0; i < 20000; i++) {
+		columns.add(i % 2 ? COMBAT_SESSION : EXPLORATION_SESSION, "Zone " + to_string(i % 50), 20 + i % 120,
+			BALANCED, i % 20, LootInfo(i % 200, i % 17 == 0));
+	}
+
+	stringstream archive;
+	writeSessionArchive(archive, columns);
+	// Well under the 12-byte CompactSession and the 24-byte wire record
+	CHECK(archive.str().size() < columns.size() * 6);
+
+	ColumnTotals streamed = aggregateArchive(archive);
+	ColumnTotals direct = aggregateColumns(columns);
+	CHECK(streamed.sessions == direct.sessions);
+	CHECK(streamed.minutes == direct.minutes);
+	CHECK(streamed.gold == direct.gold);
+	CHECK(streamed.shortest == direct.shortest);
+	CHECK(streamed.longest == direct.longest);
+	CHECK(streamed.rareItems == direct.rareItems);
+	CHECK(streamed.combatSessions == direct.combatSessions);
+	CHECK(streamed.longSessions == direct.longSessions);
+	CHECK(streamed.value == direct.value);
+}
+
+TEST_CASE("Archive files load all or nothing") {
+	const string fileName = "sessions_test.bgsa";
+	{
+		SessionContainer manager;
+		loadSessionsFromJson("sessions.json", manager);
+		saveSessionsToArchive(fileName, manager);
+	}
+
+	SessionContainer loaded;
+	CHECK(loadSessionsFromArchive(fileName, loaded) == 5);
+	CHECK(loaded.at(4)->getLocation() == "Moonrise Towers");
+	CHECK(sessionCount(*loaded.at(2)) == 14);
+	CHECK(sessionLoot(*loaded.at(2)).isRareItemFound());
+
+	string bytes = readWholeFile(fileName);
+	string flipped = bytes;
+	flipped[bytes.size() - 2] ^= 1;
+	stringstream corrupt(flipped);
+	CHECK_THROWS_AS(aggregateArchive(corrupt), runtime_error);
+
+	stringstream truncated(bytes.substr(0, bytes.size() - 1));
+	CHECK_THROWS_AS(aggregateArchive(truncated), runtime_error);
+
+	ofstream(fileName, ios::binary) << flipped;
+	CHECK_THROWS_AS(loadSessionsFromArchive(fileName, loaded), runtime_error);
+	CHECK(loaded.size() == 5);
+	std::remove(fileName.c_str());
+}
+
+TEST_CASE("Archive rejects records whose difficulty is not a real value") {
+	// A checksummed block whose flag bits carry difficulty 0
+	SessionColumns columns;
+	columns.add(COMBAT_SESSION, "Forest", 60, BALANCED, 3, LootInfo());
+	columns.add(COMBAT_SESSION, "Forest", 60, static_cast<Difficulty>(0), 3, LootInfo());
+	stringstream archive;
+	writeSessionArchive(archive, columns);
+
+	SessionArchiveReader reader(archive);
+	SessionColumns block;
+	CHECK_THROWS_WITH_AS(reader.next(block), "Session archive record is corrupt", runtime_error);
+}
+
+// ---------- W) Memory Accounting ----------
+TEST_CASE("Memory accounting charges nodes, sessions and locations to their subsystem") {
+	const string longName = "The Shadow-Cursed Lands of Reithwin";
+	MemoryStats nodes = memoryAccount(MEM_LIST_NODES).stats();
+	MemoryStats sessions = memoryAccount(MEM_SESSIONS).stats();
+	MemoryStats locations = memoryAccount(MEM_LOCATIONS).stats();
+	{
+		SessionContainer manager;
+		manager.add(new CombatSession(longName, 30, BALANCED, 5, LootInfo()));
+		manager.add(new ExplorationSession("Camp", 10, EXPLORER, 1, LootInfo()));
+
+		CHECK(memoryAccount(MEM_LIST_NODES).stats().liveBytes - nodes.liveBytes == 2 * static_cast<long long>(sizeof(SessionLinkedList::Node)));
+		CHECK(memoryAccount(MEM_LIST_NODES).stats().allocations - nodes.allocations == 2);
+		CHECK(memoryAccount(MEM_SESSIONS).stats().liveBytes - sessions.liveBytes
+			== static_cast<long long>(sizeof(CombatSession) + sizeof(ExplorationSession)));
+		CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBlocks - locations.liveBlocks == 1);
+		CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBytes - locations.liveBytes >= static_cast<long long>(longName.size() + 1));
+
+		manager.remove(0);
+		CHECK(memoryAccount(MEM_LIST_NODES).stats().liveBlocks - nodes.liveBlocks == 1);
+		CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBytes == locations.liveBytes);
+	}
+	CHECK(memoryAccount(MEM_LIST_NODES).stats().liveBytes == nodes.liveBytes);
+	CHECK(memoryAccount(MEM_SESSIONS).stats().liveBytes == sessions.liveBytes);
+
+	// Copies own their own location buffer
+	{
+		CombatSession original(longName, 30, BALANCED, 5, LootInfo());
+		CombatSession copy = original;
+		CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBlocks - locations.liveBlocks == 2);
+		// Assigning a short name keeps the buffer the copy already had
+		copy = CombatSession("Camp", 1, BALANCED, 1, LootInfo());
+		CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBlocks - locations.liveBlocks == 2);
+		CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBytes - locations.liveBytes
+			== static_cast<long long>(stringHeapBytes(original.getLocation()) * 2));
+	}
+	CHECK(memoryAccount(MEM_LOCATIONS).stats().liveBytes == locations.liveBytes);
+}
+
+TEST_CASE("Stack and queue nodes have their own accounts and track peaks") {
+	long long stackBase = memoryAccount(MEM_STACK).stats().liveBytes;
+	long long queueBase = memoryAccount(MEM_QUEUE).stats().liveBytes;
+	memoryAccount(MEM_STACK).resetPeak();
+
+	SessionStack stack;
+	SessionQueue queue;
+	for (int i = 0; i < 3; i++) stack.push(new CombatSession("Camp", 10, BALANCED, 1, LootInfo()));
+	queue.enqueue(new ExplorationSession("Forest", 60, EXPLORER, 3, LootInfo()));
+	stack.pop();
+	stack.pop();
+
+	const long long node = sizeof(SessionLinkedList::Node);
+	CHECK(memoryAccount(MEM_STACK).stats().liveBytes - stackBase == node);
+	CHECK(memoryAccount(MEM_STACK).stats().peakBytes - stackBase == 3 * node);
+	CHECK(memoryAccount(MEM_QUEUE).stats().liveBytes - queueBase == node);
+	queue.dequeue();
+	CHECK(memoryAccount(MEM_QUEUE).stats().liveBytes == queueBase);
+}
+
+TEST_CASE("Memory report dumps every subsystem as JSON") {
+	SessionContainer manager;
+	manager.add(new CombatSession("Camp", 10, BALANCED, 1, LootInfo()));
+
+	json report = memoryReportJson();
+	for (int m = 0; m < MEM_SUBSYSTEM_COUNT; m++) {
+		const json& entry = report["subsystems"][memorySubsystemName(static_cast<MemorySubsystem>(m))];
+		CHECK(entry.contains("liveBytes"));
+		CHECK(entry["peakBytes"].get<long long>() >= entry["liveBytes"].get<long long>());
+	}
+	CHECK(report["subsystems"]["sessions"]["liveBlocks"].get<long long>() >= 1);
+	CHECK(report["total"]["liveBytes"].get<long long>() > 0);
+
+	ostringstream table;
+	printMemoryReport(table);
+	CHECK(table.str().find("location_strings") != string::npos);
+}
+
+// ---------- X) Allocation Budgets ----------
+// The test build replaces the global operator new to count allocations per thread, so
+// hot paths can be held to an exact number of allocations. Aligned and array forms
+// fall through to these or to the library defaults.
+thread_local long long threadAllocations = 0;
+
+// Not inlined, so GCC does not pair the free() with a new-expression and warn
+TRACKER_NOINLINE void* operator new(size_t size) {
+	threadAllocations++;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw bad_alloc();
+}
+
+TRACKER_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+TRACKER_NOINLINE void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Debug MSVC builds give every string and container a heap-allocated iterator proxy
+#if defined(_MSC_VER) && defined(_DEBUG)
+const long long JSON_LOAD_ALLOCATIONS_PER_RECORD = 40;
+#else
+const long long JSON_LOAD_ALLOCATIONS_PER_RECORD = 16;
+#endif
+
+// Allocations fn makes on the calling thread
+template <typename Fn>
+long long allocationsDuring(Fn&& fn) {
+	long long before = threadAllocations;
+	fn();
+	return threadAllocations - before;
+}
+
+TEST_CASE("Container hot paths stay within their allocation budget") {
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+
+	PlaySession* s = new CombatSession("A location name longer than the inline buffer", 30, BALANCED, 5, LootInfo());
+	CHECK(allocationsDuring([&] { manager.add(s); }) == 1);     // the list node only
+
+	CHECK(allocationsDuring([&] { manager.at(3); }) == 0);
+	CHECK(allocationsDuring([&] { manager.size(); }) == 0);
+	CHECK(allocationsDuring([&] { manager.at(5)->getLocation(); }) == 0);
+	int found = -1;
+	CHECK(allocationsDuring([&] { found = manager.linearSearch("Moonrise Towers"); }) == 0);
+	CHECK(found == 4);
+
+	const string missing = "Nowhere at all, a name longer than the inline buffer";
+	CHECK(allocationsDuring([&] { found = manager.linearSearch(missing); }) == 0);
+	CHECK(found == -1);
+	CHECK(allocationsDuring([&] { sessionValue(*manager.at(2)); sessionLoot(*manager.at(2)); }) == 0);
+
+	CHECK(allocationsDuring([&] { manager.remove(5); }) == 0);
+}
+
+TEST_CASE("Readers stay within their allocation budget") {
+	SessionWireWriter writer;
+	for (int i = 0; i < 100; i++) writer.add(CombatSession("Location number " + to_string(i), i, BALANCED, i, LootInfo(i, false)));
+	string bytes = writer.finish();
+
+	SessionWireView view(bytes.data(), bytes.size());
+	double value = 0;
+	CHECK(allocationsDuring([&] {
+		for (size_t i = 0; i < view.size(); i++) value += view.record(i).calculateValue() + view.record(i).getLocation().size();
+	}) == 0);
+
+	// JSON load: each record may cost its parse tree, the session, its node and its
+	// location buffer, and nothing per record beyond that. Both loads are under
+	// JSON_LOAD_GRAIN records, so every allocation happens on this thread.
+	const string fileName = "alloc_budget_test.json";
+	auto loadCost = [&](int records) {
+		json doc = json::array();
+		for (int i = 0; i < records; i++)
+			doc.push_back(sessionToJson(CombatSession("Location number " + to_string(i), 30, BALANCED, 5, LootInfo(10, true))));
+		ofstream(fileName) << doc.dump();
+
+		SessionContainer manager;
+		return allocationsDuring([&] { loadSessionsFromJson(fileName, manager); });
+	};
+	long long small = loadCost(100);
+	long long large = loadCost(300);
+	long long perRecord = (large - small) / 200;
+	CHECK(perRecord <= JSON_LOAD_ALLOCATIONS_PER_RECORD);
+	std::remove(fileName.c_str());
+}
+
+// ---------- Y) Workload Generator ----------
+TEST_CASE("Generated sessions are deterministic and follow the configuration") {
+	WorkloadConfig c;
+	c.seed = 7;
+	c.locations = 50;
+	c.locationSkew = 3.0;
+	c.combatShare = 0.3;
+	c.minDuration = 20;
+	c.maxDuration = 40;
+	c.maxEnemies = 9;
+	c.maxAreas = 4;
+	c.maxGold = 100;
+	c.rareRate = 0.1;
+
+	const int n = 20000;
+	int combat = 0, rare = 0, lowLocations = 0;
+	bool inRange = true;
+	for (int i = 0; i < n; i++) {
+		GeneratedSession g = generateSession(c, i);
+		combat += g.type == COMBAT_SESSION;
+		rare += g.rare;
+		lowLocations += g.locationId < 10;
+		int maxCount = g.type == COMBAT_SESSION ? 9 : 4;
+		inRange = inRange && g.duration >= 20 && g.duration <= 40 && g.count >= 0 && g.count <= maxCount &&
+			g.gold >= 0 && g.gold <= 100 && g.locationId < 50 && g.difficulty >= EXPLORER && g.difficulty <= TACTICIAN;
+	}
+	CHECK(inRange);
+	CHECK(combat == doctest::Approx(0.3 * n).epsilon(0.05));
+	CHECK(rare == doctest::Approx(0.1 * n).epsilon(0.1));
+	// With skew 3 the first fifth of the ids gets (1/5)^(1/3), about 58%, of the sessions
+	CHECK(lowLocations == doctest::Approx(0.585 * n).epsilon(0.05));
+
+	GeneratedSession a = generateSession(c, 1234), b = generateSession(c, 1234);
+	CHECK(a.duration == b.duration);
+	CHECK(a.gold == b.gold);
+	CHECK(a.locationId == b.locationId);
+	c.seed = 8;
+	int same = 0;
+	for (int i = 0; i < 100; i++) {
+		WorkloadConfig other = c;
+		other.seed = 7;
+		same += generateSession(c, i).gold == generateSession(other, i).gold;
+	}
+	CHECK(same < 10);
+}
+
+TEST_CASE("Generated files load in every format and match the generator") {
+	WorkloadConfig c;
+	c.sessions = 3000;      // spans more than one render piece
+	c.locations = 40;
+
+	SessionTotals expected;
+	for (uint64_t i = 0; i < c.sessions; i++) {
+		GeneratedSession g = generateSession(c, i);
+		unique_ptr<PlaySession> s(makeSession(g.type, workloadLocation(g.locationId), g.duration, g.difficulty,
+			g.count, LootInfo(g.gold, g.rare)));
+		expected.add(*s);
+	}
+
+	for (const string& fileName : { string("workload_test.json"), string("workload_test.jsonl"), string("workload_test.bgsw") }) {
+		generateWorkload(c, fileName);
+		auto source = openSessionSource(fileName);
+		SessionTotals totals = accumulate(*source);
+		source.reset();
+		CHECK(totals.sessions == expected.sessions);
+		CHECK(totals.minutes == expected.minutes);
+		CHECK(totals.gold == expected.gold);
+		CHECK(totals.rareItems == expected.rareItems);
+		CHECK(totals.value == expected.value);
+	}
+
+	SessionContainer manager;
+	CHECK(loadSessionsFromJson("workload_test.json", manager) == 3000);
+	CHECK(loadSessionsFromWire("workload_test.bgsw", manager) == 3000);
+
+	// Record i does not depend on the total, so a longer run extends a shorter one
+	string full = readWholeFile("workload_test.jsonl");
+	c.sessions = 1000;
+	generateWorkload(c, "workload_test.jsonl");
+	string prefix = readWholeFile("workload_test.jsonl");
+	CHECK(full.compare(0, prefix.size(), prefix) == 0);
+
+	for (const char* f : { "workload_test.json", "workload_test.jsonl", "workload_test.bgsw" }) std::remove(f);
+}
+
+TEST_CASE("Generator arguments are parsed and checked") {
+	string fileName;
+	WorkloadConfig c = parseWorkloadArgs({ "500", "out.jsonl", "--seed", "18446744073709551615", "--duration", "5", "9",
+		"--rare-rate", "0.5", "--locations", "3" }, fileName);
+	CHECK(fileName == "out.jsonl");
+	CHECK(c.sessions == 500);
+	CHECK(c.seed == 18446744073709551615ull);
+	CHECK(c.minDuration == 5);
+	CHECK(c.maxDuration == 9);
+	CHECK(c.rareRate == 0.5);
+	CHECK(c.locations == 3);
+
+	CHECK_THROWS_AS(parseWorkloadArgs({ "500" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "-5", "out.json" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--seed" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--combat-share", "2" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--colour", "red" }, fileName), runtime_error);
+
+	// Integer settings are whole, non-negative and fit their field; fractions must be finite
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--locations", "-1" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--locations", "4294967296" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--locations", "4000000000" }, fileName), runtime_error);
+	CHECK(parseWorkloadArgs({ "5", "out.json", "--locations", "1048576" }, fileName).locations == MAX_WORKLOAD_LOCATIONS);
+	WorkloadConfig tooMany;
+	tooMany.locations = MAX_WORKLOAD_LOCATIONS + 1;
+	CHECK_THROWS_AS(generateWorkload(tooMany, "rejected_workload.jsonl"), runtime_error);
+	CHECK_FALSE(filesystem::exists("rejected_workload.jsonl"));
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--locations", "2.5" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--max-gold", "1e12" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--max-gold", "2147483648" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--max-enemies", "nan" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--duration", "-5", "9" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--duration", "5", "1e300" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--location-skew", "nan" }, fileName), runtime_error);
+	CHECK_THROWS_AS(parseWorkloadArgs({ "5", "out.json", "--rare-rate", "inf" }, fileName), runtime_error);
+	CHECK(parseWorkloadArgs({ "5", "out.json", "--max-gold", "2147483647" }, fileName).maxGold == numeric_limits<int>::max());
+
+	// Wire string offsets are 32-bit, so a huge --locations fails instead of wrapping
+	CHECK(nextWireStringOffset(UINT32_MAX - 10, 10) == UINT32_MAX - 10);
+	CHECK_THROWS_AS(nextWireStringOffset(UINT32_MAX - 10, 11), runtime_error);
+	CHECK_THROWS_AS(nextWireStringOffset(uint64_t(UINT32_MAX) + 1, 0), runtime_error);
+}
+
+// ---------- Z) Location Index ----------
+TEST_CASE("Location index finds every record of a location with at most one block read") {
+	const string dataFile = "index_test.bgsw", indexFile = "index_test.bgsi";
+	WorkloadConfig c;
+	c.sessions = 20000;
+	c.locations = 700;
+	c.locationSkew = 2.0;
+	generateWorkload(c, dataFile);
+	buildLocationIndex(dataFile, indexFile);
+
+	// Expected offsets by brute force over the whole file
+	vector<char> bytes;
+	{
+		ifstream in(dataFile, ios::binary);
+		bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	}
+	SessionWireView view(bytes.data(), bytes.size());
+	map<string, vector<uint64_t>> expected;
+	for (size_t i = 0; i < view.size(); i++)
+		expected[string(view.record(i).getLocation())].push_back(WIRE_HEADER_SIZE + i * WIRE_RECORD_SIZE);
+
+	LocationIndex index(indexFile);
+	CHECK(index.recordCount() == 20000);
+	CHECK(index.blockCount() > 10);
+
+	bool allMatch = true;
+	for (const auto& [loc, offsets] : expected) {
+		uint64_t before = index.blockReads();
+		allMatch = allMatch && index.find(loc) == offsets && index.blockReads() - before == 1;
+	}
+	CHECK(allMatch);
+
+	// Absent names mostly stop at the bloom filter
+	uint64_t before = index.blockReads();
+	for (int i = 0; i < 200; i++) CHECK(index.find("Nowhere " + to_string(i)).empty());
+	CHECK(index.find("").empty());
+	CHECK(index.find("zzz").empty());
+	CHECK(index.blockReads() - before < 10);
+
+	WireRecordFile data(dataFile);
+	auto found = findSessionsByLocation(index, data, "Goblin Camp 3");
+	REQUIRE(found.size() == expected["Goblin Camp 3"].size());
+	WireRecordView first = view.record(static_cast<size_t>((expected["Goblin Camp 3"][0] - WIRE_HEADER_SIZE) / WIRE_RECORD_SIZE));
+	CHECK(found[0]->getLocation() == "Goblin Camp 3");
+	CHECK(found[0]->getDuration() == first.getDuration());
+	CHECK(sessionCount(*found[0]) == first.getCount());
+	CHECK_THROWS_AS(data.readAt(WIRE_HEADER_SIZE + 1), runtime_error);
+
+	for (const char* f : { "index_test.bgsw", "index_test.bgsi" }) std::remove(f);
+}
+
+TEST_CASE("Location index rejects stale or damaged files") {
+	const string dataFile = "index_stale_test.bgsw", indexFile = "index_stale_test.bgsi";
+	WorkloadConfig c;
+	c.sessions = 500;
+	generateWorkload(c, dataFile);
+	buildLocationIndex(dataFile, indexFile);
+
+	c.seed = 99;
+	generateWorkload(c, dataFile);
+	{
+		LocationIndex index(indexFile);
+		WireRecordFile data(dataFile);
+		CHECK_THROWS_AS(findSessionsByLocation(index, data, "Camp 1"), runtime_error);
+	}
+
+	string bytes = readWholeFile(indexFile);
+	bytes[bytes.size() - 3] ^= 0x10;
+	ofstream(indexFile, ios::binary) << bytes;
+	CHECK_THROWS_AS(LocationIndex{ indexFile }, runtime_error);
+
+	// A directory size no checksum covers must not size an allocation
+	bytes[bytes.size() - 3] ^= 0x10;
+	for (uint64_t size : { uint64_t(1) << 62, ~uint64_t(0), uint64_t(bytes.size()) }) {
+		storeLE64(&bytes[40], size);
+		ofstream(indexFile, ios::binary) << bytes;
+		CHECK_THROWS_WITH_AS(LocationIndex{ indexFile }, "Location index is truncated", runtime_error);
+	}
+
+	for (const string& f : { dataFile, indexFile }) std::remove(f.c_str());
+}
+
+// ---------- AA) Filter Expressions ----------
+TEST_CASE("Filter expressions select sessions by any field") {
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+
+	auto matching = [&](const string& text) { return filterSessions(manager, SessionFilter(text)); };
+	CHECK(matching("type == combat && difficulty >= BALANCED && durationMinutes > 45 && rareItemFound") == vector<int>{ 2, 4 });
+	CHECK(matching("type == exploration") == vector<int>{ 1, 3 });
+	CHECK(matching("location == \"Goblin Camp\"") == vector<int>{ 2 });
+	CHECK(matching("location != \"Goblin Camp\"").size() == 4);
+	CHECK(matching("enemiesDefeated >= 0").size() == 3);       // implies combat
+	CHECK(matching("!(gold < 60)") == matching("goldEarned >= 60"));
+	CHECK(matching("rare == false || type == combat && duration < 0") == matching("!rareItemFound"));
+	CHECK(matching("(rare || difficulty == explorer) && count > 3").size() == matching("rare && count > 3 || difficulty == Explorer && count > 3").size());
+	CHECK(matching("duration > -1").size() == 5);
+}
+
+TEST_CASE("Column evaluation agrees with the compiled row predicate") {
+	WorkloadConfig c;
+	c.sessions = 5000;
+	c.locations = 30;
+	SessionColumns columns;
+	vector<unique_ptr<PlaySession>> rows;
+	for (uint64_t i = 0; i < c.sessions; i++) {
+		GeneratedSession g = generateSession(c, i);
+		rows.emplace_back(makeSession(g.type, workloadLocation(g.locationId), g.duration, g.difficulty, g.count, LootInfo(g.gold, g.rare)));
+		columns.add(*rows.back());
+	}
+
+	for (const char* text : { "type == combat && difficulty >= balanced && durationMinutes > 45 && rareItemFound",
+		"areasDiscovered < 3 || gold >= 400", "!(location == \"Camp 1\") && count != 7", "location == \"Nowhere\"",
+		"location != \"Nowhere\" && !rare", "difficulty < tactician && (duration <= 30 || duration >= 170)" }) {
+		SessionFilter filter(text);
+		vector<uint8_t> mask = filter.evaluate(columns);
+		size_t disagreements = 0, matches = 0;
+		for (size_t i = 0; i < rows.size(); i++) {
+			disagreements += mask[i] != filter.matches(*rows[i]);
+			matches += mask[i];
+		}
+		CHECK_MESSAGE(disagreements == 0, text);
+		CHECK(filter.count(columns) == matches);
+	}
+}
+
+TEST_CASE("Bad filter expressions report where they fail") {
+	auto errorFor = [](const string& text) {
+		try { SessionFilter f(text); }
+		catch (const runtime_error& e) { return string(e.what()); }
+		return string();
+	};
+	CHECK(errorFor("speed > 3") == "Filter error at column 1: unknown field 'speed'");
+	CHECK(errorFor("type > combat") == "Filter error at column 6: 'type' only supports == and !=");
+	CHECK(errorFor("duration >") == "Filter error at column 11: expected a value");
+	CHECK(errorFor("(rare") == "Filter error at column 6: expected ')'");
+	CHECK(errorFor("rare rare") == "Filter error at column 6: unexpected 'rare'");
+	CHECK(errorFor("location == \"Camp") == "Filter error at column 13: unterminated text");
+	CHECK(errorFor("difficulty == hard") == "Filter error at column 15: 'hard' is not a valid value here");
+	CHECK(errorFor("duration") == "Filter error at column 9: expected a comparison after 'duration'");
+	CHECK(errorFor("gold # 3") == "Filter error at column 6: unexpected '#'");
+	CHECK(errorFor("") == "Filter error at column 1: unexpected end");
+
+	// Depth is bounded before it can exhaust the stack
+	CHECK(errorFor(string(100000, '!') + "rare") == "Filter error at column 257: expression is nested too deeply");
+	CHECK(errorFor(string(100000, '(') + "rare") == "Filter error at column 257: expression is nested too deeply");
+	string chain = "rare";
+	for (int i = 0; i < 100000; i++) chain += " && rare";
+	CHECK(errorFor(chain).find("expression is nested too deeply") != string::npos);
+	CHECK(errorFor(string(200, '!') + "rare") == "");
+}
+
+// ---------- AB) CSV ----------
+TEST_CASE("CSV export writes every field and round trips awkward locations") {
+	const string fileName = "sessions_test.csv";
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+	manager.add(new CombatSession("Camp, \"The\" Grove\nNorth", 12, TACTICIAN, 3, LootInfo(-7, true)));
+	saveSessionsToCsv(fileName, manager);
+
+	string text = readWholeFile(fileName);
+	const string header = "type,location,durationMinutes,difficulty,goldEarned,rareItemFound,enemiesDefeated,areasDiscovered\n";
+	CHECK(text.compare(0, header.size(), header) == 0);
+	CHECK(text.find("\nexploration,Emerald Grove,50,Explorer,22,true,,4\n") != string::npos);
+	CHECK(text.find("\ncombat,\"Camp, \"\"The\"\" Grove\nNorth\",12,Tactician,-7,true,3,\n") != string::npos);
+
+	SessionContainer loaded;
+	CHECK(loadSessionsFromCsv(fileName, loaded) == 6);
+	auto original = manager.begin();
+	for (const PlaySession& s : loaded) {
+		const PlaySession& o = *original++;
+		CHECK(s.getLocation() == o.getLocation());
+		CHECK(s.getType() == o.getType());
+		CHECK(s.getDuration() == o.getDuration());
+		CHECK(s.getDifficulty() == o.getDifficulty());
+		CHECK(sessionCount(s) == sessionCount(o));
+		CHECK(sessionLoot(s).getGoldEarned() == sessionLoot(o).getGoldEarned());
+		CHECK(sessionLoot(s).isRareItemFound() == sessionLoot(o).isRareItemFound());
+	}
+	std::remove(fileName.c_str());
+}
+
+TEST_CASE("CSV rows cost no allocations to write") {
+	const string fileName = "alloc_test.csv";
+	CsvSessionWriter writer(fileName);
+	CombatSession session("A location name longer than the inline buffer", 30, BALANCED, 5, LootInfo(1234567, true));
+	writer.write(session);
+	CHECK(allocationsDuring([&] { for (int i = 0; i < 50000; i++) writer.write(session); }) == 0);
+	writer.flush();
+	std::remove(fileName.c_str());
+}
+
+TEST_CASE("CSV import gives the same result however the file is cut up") {
+	const string fileName = "workload_test.csv";
+	WorkloadConfig c;
+	c.sessions = 4000;
+	c.locations = 60;
+	{
+		CsvSessionWriter writer(fileName);
+		for (uint64_t i = 0; i < c.sessions; i++) {
+			GeneratedSession g = generateSession(c, i);
+			// Every tenth location has a quoted comma and line break to straddle the cuts
+			string loc = workloadLocation(g.locationId) + (g.locationId % 10 == 0 ? ", \"east\"\r\nwing" : "");
+			writer.write(g.type, loc, g.duration, g.difficulty, g.count, LootInfo(g.gold, g.rare));
+		}
+	}
+
+	SessionColumns whole = readSessionsCsv(fileName);
+	SessionColumns cut = readSessionsCsv(fileName, 1000, 300);
+	REQUIRE(whole.size() == 4000);
+	REQUIRE(cut.size() == 4000);
+	bool same = true;
+	for (size_t i = 0; i < whole.size(); i++) {
+		GeneratedSession g = generateSession(c, i);
+		same = same && whole.duration[i] == g.duration && whole.gold[i] == g.gold && whole.count[i] == g.count &&
+			whole.type[i] == g.type && whole.rare[i] == g.rare &&
+			cut.duration[i] == g.duration && cut.count[i] == g.count &&
+			cut.locations.name(cut.locationId[i]) == whole.locations.name(whole.locationId[i]);
+	}
+	CHECK(same);
+	std::remove(fileName.c_str());
+}
+
+TEST_CASE("CSV import rejects bad files without adding anything") {
+	const string fileName = "bad_test.csv";
+	const string header = csvHeader() + "\n";
+	auto errorFor = [&](const string& body) {
+		ofstream(fileName, ios::binary) << body;
+		SessionContainer manager;
+		try { loadSessionsFromCsv(fileName, manager); }
+		catch (const runtime_error& e) {
+			CHECK(manager.size() == 0);
+			return string(e.what());
+		}
+		return string();
+	};
+
+	CHECK(errorFor("type,location\n") == fileName + " does not have the session CSV header");
+	CHECK(errorFor(header + "combat,Camp,30,Balanced,5,false,3,\ncombat,Camp,x,Balanced,5,false,3,\n") ==
+		"Bad CSV file " + fileName + ": row 2: bad durationMinutes 'x'");
+	CHECK(errorFor(header + "combat,Camp,30,Balanced,5,false,,3\n") ==
+		"Bad CSV file " + fileName + ": row 1: areasDiscovered is only for exploration sessions");
+	CHECK(errorFor(header + "raid,Camp,30,Balanced,5,false,3,\n") ==
+		"Bad CSV file " + fileName + ": row 1: unknown session type 'raid'");
+	CHECK(errorFor(header + "combat,Camp,30,Balanced,5,false\n") ==
+		"Bad CSV file " + fileName + ": row 1: expected 8 fields, found 6");
+	CHECK(errorFor(header + "combat,\"Camp,30,Balanced,5,false,3,\n") ==
+		"Bad CSV file " + fileName + ": unterminated quoted field");
+
+	// CRLF line ends and a missing final newline are fine
+	CHECK(errorFor(csvHeader() + "\r\ncombat,Camp,30,Balanced,5,false,3,\r\nexploration,Camp,10,Explorer,0,true,,2").empty());
+	std::remove(fileName.c_str());
+}
+
+// ---------- AC) HTTP API ----------
+TEST_CASE("HTTP parser splits pipelined requests however the bytes arrive") {
+	const string wire =
+		"POST /sessions HTTP/1.1\r\nHost: x\r\ncontent-length: 5\r\n\r\nhello"
+		"GET /sessions?location=Emerald+Grove&limit=2 HTTP/1.1\r\nConnection: close\r\n\r\n"
+		"GET /health HTTP/1.0\r\n\r\n";
+
+	auto check = [](const vector<HttpRequest>& got) {
+		REQUIRE(got.size() == 3);
+		CHECK(got[0].method == "POST");
+		CHECK(got[0].path == "/sessions");
+		CHECK(got[0].body == "hello");
+		CHECK(got[0].keepAlive);
+		string location;
+		CHECK(got[1].param("location", location));
+		CHECK(location == "Emerald Grove");
+		CHECK_FALSE(got[1].param("filter", location));
+		CHECK_FALSE(got[1].keepAlive);
+		CHECK(got[2].path == "/health");
+		CHECK_FALSE(got[2].keepAlive);     // HTTP/1.0 closes unless asked not to
+	};
+
+	HttpRequestParser whole;
+	whole.feed(wire.data(), wire.size());
+	vector<HttpRequest> got;
+	HttpRequest request;
+	while (whole.next(request)) got.push_back(request);
+	check(got);
+	CHECK(whole.buffered() == 0);
+
+	HttpRequestParser trickle;
+	got.clear();
+	for (char c : wire) {
+		trickle.feed(&c, 1);
+		while (trickle.next(request)) got.push_back(request);
+	}
+	check(got);
+}
+
+TEST_CASE("HTTP parser rejects malformed requests with the right status") {
+	auto statusFor = [](const string& wire) {
+		HttpRequestParser parser;
+		parser.feed(wire.data(), wire.size());
+		HttpRequest request;
+		try { parser.next(request); }
+		catch (const HttpError& e) { return e.status; }
+		return 0;
+	};
+
+	CHECK(statusFor("GET /health\r\n\r\n") == 400);
+	CHECK(statusFor("GET health HTTP/1.1\r\n\r\n") == 400);
+	CHECK(statusFor("GET /health HTTP/2\r\n\r\n") == 505);
+	CHECK(statusFor("POST /sessions HTTP/1.1\r\nContent-Length: x1\r\n\r\n") == 400);
+	CHECK(statusFor("POST /sessions HTTP/1.1\r\nContent-Length: 999999999\r\n\r\n") == 413);
+	CHECK(statusFor("POST /sessions HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n") == 501);
+	CHECK(statusFor("GET /" + string(HTTP_MAX_HEAD_BYTES, 'a')) == 431);
+	CHECK(statusFor("GET /health HTTP/1.1\r\nHost: x\r\n") == 0);     // incomplete, not wrong
+	CHECK_THROWS_AS(urlDecode("50%2"), HttpError);
+	CHECK(urlDecode("a%2Cb%20c") == "a,b c");
+
+	string response = httpResponse(404, "application/json", "{}", true);
+	CHECK(response == "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\n{}");
+	CHECK(httpResponseLength(response + "HTTP/1.1") == response.size());
+	CHECK(httpResponseLength(response.substr(0, response.size() - 1)) == 0);
+	CHECK(httpStatusOf(response) == 404);
+}
+
+TEST_CASE("Session API routes add, search, aggregates and report") {
+	SnapshotSessionContainer sessions;
+	SessionApi api(sessions, Character{ "Tav", 7, 120, BALANCED });
+	auto call = [&](const string& method, const string& target, const string& body = "") {
+		HttpRequest request;
+		request.method = method;
+		size_t question = target.find('?');
+		request.path = target.substr(0, question);
+		request.query = question == string::npos ? "" : target.substr(question + 1);
+		request.body = body;
+		string response = api.respond(request);
+		size_t headEnd = response.find("\r\n\r\n");
+		return make_pair(httpStatusOf(response), response.substr(headEnd + 4));
+	};
+
+	auto added = call("POST", "/sessions", readWholeFile("sessions.json"));
+	CHECK(added.first == 201);
+	CHECK(json::parse(added.second)["added"] == 5);
+	added = call("POST", "/sessions", R"({"type":"combat","location":"Moonrise Towers","durationMinutes":30,"difficulty":"Tactician","goldEarned":40,"rareItemFound":true,"enemiesDefeated":9})");
+	CHECK(json::parse(added.second)["sessions"] == 6);
+
+	// A bad record in a batch adds nothing
+	auto rejected = call("POST", "/sessions", R"([{"type":"combat","location":"A","durationMinutes":1,"difficulty":"Explorer"},{"type":"raid"}])");
+	CHECK(rejected.first == 400);
+	CHECK(sessions.size() == 6);
+
+	json found = json::parse(call("GET", "/sessions?location=Moonrise%20Towers").second);
+	CHECK(found["matched"] == 2);
+	CHECK(found["sessions"][1]["enemiesDefeated"] == 9);
+	found = json::parse(call("GET", "/sessions?filter=type+%3D%3D+combat&limit=1").second);
+	CHECK(found["sessions"].size() == 1);
+
+	json totals = json::parse(call("GET", "/aggregates").second);
+	CHECK(totals["sessions"] == 6);
+	CHECK(totals["byType"]["combat"].get<int>() + totals["byType"]["exploration"].get<int>() == 6);
+	long long minutes = 0;
+	sessions.snapshot().forEach([&](const PlaySession& s) { minutes += s.getDuration(); });
+	CHECK(totals["totalMinutes"] == minutes);
+	CHECK(json::parse(call("GET", "/aggregates?filter=rareItemFound").second)["sessions"] == totals["rareItemsFound"]);
+
+	auto report = call("GET", "/report");
+	CHECK(report.second.find("Character: Tav") != string::npos);
+	CHECK(report.second.find("Session #0:") != string::npos);     // numbered like report.txt and the menu
+	CHECK(report.second.find("Session #5:") != string::npos);
+	CHECK(report.second.find("Session #6:") == string::npos);
+
+	CHECK(call("GET", "/aggregates?filter=gold+%3E").first == 400);
+	CHECK(call("DELETE", "/sessions").first == 405);
+	CHECK(call("GET", "/nowhere").first == 404);
+	CHECK(SessionApi::isHeavy([] { HttpRequest r; r.method = "GET"; r.path = "/aggregates"; return r; }()));
+}
+
+TEST_CASE("HTTP ports are range-checked before they are narrowed") {
+	CHECK(parseHttpPort("0") == 0);
+	CHECK(parseHttpPort("65535") == 65535);
+	CHECK_THROWS_WITH_AS(parseHttpPort("70000"), "Number out of range: 70000", runtime_error);
+	CHECK_THROWS_WITH_AS(parseHttpPort("99999999999999999999"), "Number out of range: 99999999999999999999", runtime_error);
+	CHECK_THROWS_WITH_AS(parseHttpPort("-1"), "Not a whole number: -1", runtime_error);
+	CHECK_THROWS_WITH_AS(parseHttpPort("80x"), "Not a whole number: 80x", runtime_error);
+}
+
+#ifdef __linux__
+TEST_CASE("HTTP server answers pipelined requests in order over kept-alive connections") {
+	SnapshotSessionContainer sessions;
+	SessionApi api(sessions);
+	HttpServer server(api, 0, 2);
+	thread loop([&] { server.run(); });
+
+	HttpLoadOptions adds;
+	adds.method = "POST";
+	adds.target = "/sessions";
+	adds.body = R"({"type":"exploration","location":"Grymforge","durationMinutes":20,"difficulty":"Explorer","areasDiscovered":2})";
+	adds.connections = 3;
+	adds.requestsPerConnection = 40;
+	adds.pipeline = 8;
+	HttpLoadResult result = runHttpLoad(server.port(), adds);
+	CHECK(result.requests == 120);
+	CHECK(result.failures == 0);
+	CHECK(sessions.size() == 120);
+
+	HttpLoadOptions queries;
+	queries.target = "/aggregates";
+	queries.requestsPerConnection = 25;
+	queries.pipeline = 5;
+	result = runHttpLoad(server.port(), queries);
+	CHECK(result.requests == 100);
+	CHECK(result.failures == 0);
+
+	// A slow worker reply, a quick inline reply and a bad request on one connection
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(server.port());
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0);
+	string wire = "GET /aggregates HTTP/1.1\r\n\r\nGET /health HTTP/1.1\r\n\r\nBROKEN\r\n\r\n";
+	REQUIRE(send(fd, wire.data(), wire.size(), 0) == static_cast<ssize_t>(wire.size()));
+	string in;
+	char buffer[4096];
+	ssize_t n;
+	while ((n = recv(fd, buffer, sizeof buffer, 0)) > 0) in.append(buffer, static_cast<size_t>(n));
+	close(fd);      // the server closed first, after the 400
+
+	vector<string> replies;
+	while (size_t length = httpResponseLength(in)) {
+		replies.push_back(in.substr(0, length));
+		in.erase(0, length);
+	}
+	REQUIRE(replies.size() == 3);
+	CHECK(replies[0].find("\"byType\"") != string::npos);
+	CHECK(replies[1].find("\"status\":\"ok\"") != string::npos);
+	CHECK(httpStatusOf(replies[2]) == 400);
+	CHECK(replies[2].find("Connection: close") != string::npos);
+
+	server.stop();
+	loop.join();
+}
+#endif
+
+// ---------- AD) Undo History ----------
+TEST_CASE("Stack and queue work at the head in constant time") {
+	SessionStack s;
+	s.push(new CombatSession("First", 10, BALANCED, 1, LootInfo()));
+	s.push(new CombatSession("Second", 10, BALANCED, 1, LootInfo()));
+	CHECK(s.top()->getLocation() == "Second");
+	s.pop();
+	CHECK(s.top()->getLocation() == "First");
+
+	SessionQueue q;
+	q.enqueue(new ExplorationSession("First", 10, EXPLORER, 1, LootInfo()));
+	q.enqueue(new ExplorationSession("Second", 10, EXPLORER, 1, LootInfo()));
+	q.dequeue();
+	CHECK(q.front()->getLocation() == "Second");
+	q.dequeue();
+	CHECK(q.front() == nullptr);
+	q.enqueue(new ExplorationSession("Third", 10, EXPLORER, 1, LootInfo()));    // tail was reset
+	CHECK(q.front()->getLocation() == "Third");
+}
+
+TEST_CASE("RingStack drops its oldest entry when full") {
+	RingStack<int> ring(3);
+	int evicted = 0;
+	for (int i = 1; i <= 3; i++) CHECK_FALSE(ring.push(i, evicted));
+	CHECK(ring.push(4, evicted));
+	CHECK(evicted == 1);
+	CHECK(ring.pop() == 4);
+	CHECK(ring.pop() == 3);
+	CHECK(ring.top() == 2);
+	CHECK(ring.size() == 1);
+	CHECK_FALSE(ring.push(5, evicted));
+	CHECK(ring.pop() == 5);
+	CHECK(ring.pop() == 2);
+	CHECK_THROWS_AS(ring.pop(), ContainerException);
+	CHECK_THROWS_AS(RingStack<int>(0), ContainerException);
+}
+
+TEST_CASE("Undo and redo restore adds, removes and replacements without copying") {
+	auto locations = [](SessionContainer& m) {
+		string all;
+		for (const PlaySession& s : m) all += s.getLocation() + ",";
+		return all;
+	};
+
+	SessionContainer manager;
+	SessionHistory history(manager);
+	for (const char* loc : { "A", "B", "C" }) history.add(new CombatSession(loc, 30, BALANCED, 2, LootInfo()));
+	PlaySession* b = manager.at(1);
+
+	history.remove(1);
+	CHECK(locations(manager) == "A,C,");
+	history.replace(1, new ExplorationSession("D", 40, EXPLORER, 1, LootInfo()));
+	CHECK(locations(manager) == "A,D,");
+	history.remove(0);
+	CHECK(locations(manager) == "D,");
+
+	CHECK(history.undo());
+	CHECK(history.undo());
+	CHECK(locations(manager) == "A,C,");
+	CHECK(history.undo());
+	CHECK(locations(manager) == "A,B,C,");
+	CHECK(manager.at(1) == b);      // the same object came back
+	CHECK(manager.size() == 3);
+
+	CHECK(history.redo());
+	CHECK(history.redo());
+	CHECK(locations(manager) == "A,D,");
+	CHECK(history.redoDepth() == 1);
+
+	// Undoing every add empties the container; a new change then drops the redo stack
+	while (history.undo()) {}
+	CHECK(manager.size() == 0);
+	CHECK(manager.getHead() == nullptr);
+	history.add(new CombatSession("E", 5, BALANCED, 1, LootInfo()));
+	CHECK_FALSE(history.redo());
+	CHECK(locations(manager) == "E,");
+
+	CHECK_THROWS_AS(history.remove(1), ContainerException);
+	CHECK_THROWS_AS(history.replace(-1, nullptr), ContainerException);
+}
+
+TEST_CASE("Undo history is bounded and frees what falls off it") {
+	long long sessionsBefore = memoryAccount(MEM_SESSIONS).stats().liveBlocks;
+	{
+		SessionContainer manager;
+		SessionHistory history(manager, 3);
+		for (int i = 0; i < 6; i++) history.add(new CombatSession("Camp " + to_string(i), 30, BALANCED, 2, LootInfo()));
+		for (int i = 0; i < 5; i++) history.remove(0);
+		CHECK(history.undoDepth() == 3);
+		CHECK(manager.size() == 1);
+		// Two of the removed sessions fell off the history and were freed
+		CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == sessionsBefore + 4);
+
+		int undone = 0;
+		while (history.undo()) undone++;
+		CHECK(undone == 3);
+		CHECK(manager.size() == 4);
+		CHECK(manager.at(0)->getLocation() == "Camp 2");
+	}
+	CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == sessionsBefore);
+}
+
+TEST_CASE("Background loads drained from the menu clear the undo history") {
+	SessionContainer manager;
+	SessionHistory history(manager);
+	history.add(new CombatSession("Camp", 30, BALANCED, 2, LootInfo()));
+
+	AsyncSessionLoad load("sessions.json");
+	load.wait();
+	CHECK(drainPendingLoad(load, manager, history) == 5);
+	CHECK(history.undoDepth() == 0);
+	CHECK_FALSE(history.undo());
+	CHECK(manager.size() == 6);
+
+	history.add(new CombatSession("Forest", 30, BALANCED, 2, LootInfo()));
+	CHECK(drainPendingLoad(load, manager, history) == 0);
+	CHECK(history.undoDepth() == 1);        // nothing arrived, so the history stands
+}
+
+TEST_CASE("Undo and redo keep change tracking and cost no allocations") {
+	SessionContainer manager;
+	SessionHistory history(manager);
+	for (int i = 0; i < 10; i++) history.add(new CombatSession("Camp", 30, BALANCED, 2, LootInfo()));
+	history.remove(6);
+	manager.clearChanges();
+
+	CHECK(allocationsDuring([&] { history.undo(); history.redo(); history.undo(); }) == 0);
+	CHECK(manager.firstChangedIndex() == 6);
+	CHECK(manager.size() == 10);
+
+	manager.clearChanges();
+	history.replace(2, new CombatSession("Moved", 30, BALANCED, 2, LootInfo()));
+	CHECK(manager.editedIndices() == vector<int>{ 2 });
+	manager.clearChanges();
+	history.undo();
+	CHECK(manager.editedIndices() == vector<int>{ 2 });
+	CHECK(manager.at(2)->getLocation() == "Camp");
+
+	PlaySession* old = manager.replace(3, new CombatSession("Direct", 30, BALANCED, 2, LootInfo()));
+	CHECK(old->getLocation() == "Camp");
+	delete old;
+	history.clear();
+	CHECK(history.undoDepth() == 0);
+}
+
+// ---------- AE) Priority Queue ----------
+TEST_CASE("Priority queue serves the most valuable session first, ties in arrival order") {
+	SessionPriorityQueue<> byValue;
+	byValue.push(new CombatSession("Low", 10, EXPLORER, 1, LootInfo(5, false)));
+	byValue.push(new CombatSession("High", 10, EXPLORER, 9, LootInfo(5, false)));
+	byValue.push(new CombatSession("Tie A", 10, EXPLORER, 4, LootInfo(5, false)));
+	byValue.push(new CombatSession("Tie B", 10, EXPLORER, 4, LootInfo(5, false)));
+	CHECK(byValue.frontKey() == doctest::Approx(sessionValue(*byValue.front())));
+
+	vector<string> order;
+	while (!byValue.isEmpty()) order.push_back(byValue.take()->getLocation());
+	CHECK(order == vector<string>{ "High", "Tie A", "Tie B", "Low" });
+	CHECK(byValue.front() == nullptr);
+	CHECK_THROWS_AS(byValue.dequeue(), ContainerException);
+
+	SessionPriorityQueue<> byGold(priorityByGold);
+	byGold.push(new ExplorationSession("Poor", 10, EXPLORER, 9, LootInfo(1, true)));
+	byGold.push(new ExplorationSession("Rich", 10, EXPLORER, 0, LootInfo(500, false)));
+	CHECK(byGold.front()->getLocation() == "Rich");
+	byGold.dequeue();
+	CHECK(byGold.front()->getLocation() == "Poor");
+
+	// A custom key and comparator: shortest session first
+	SessionPriorityQueue<int, less<int>> shortest([](const PlaySession& s) { return s.getDuration(); });
+	for (int d : { 40, 5, 90, 20 }) shortest.push(new CombatSession("Camp", d, BALANCED, 1, LootInfo()));
+	CHECK(shortest.frontKey() == 5);
+}
+
+TEST_CASE("Priority queue handles support update and removal anywhere") {
+	map<string, double> priority = { { "A", 1 }, { "B", 2 }, { "C", 3 }, { "D", 4 } };
+	SessionPriorityQueue<> q([&](const PlaySession& s) { return priority.at(s.getLocation()); });
+	map<string, SessionPriorityQueue<>::Handle> handles;
+	for (auto& p : priority) handles[p.first] = q.push(new CombatSession(p.first, 10, BALANCED, 1, LootInfo()));
+	CHECK(q.front()->getLocation() == "D");
+
+	priority["D"] = 0;                  // decrease-key
+	q.update(handles["D"]);
+	priority["A"] = 10;                 // increase-key
+	q.update(handles["A"]);
+	CHECK(q.front()->getLocation() == "A");
+	CHECK(q.key(handles["D"]) == 0);
+
+	unique_ptr<PlaySession> c = q.remove(handles["C"]);
+	CHECK(c->getLocation() == "C");
+	CHECK_FALSE(q.contains(handles["C"]));
+	CHECK_THROWS_AS(q.update(handles["C"]), ContainerException);
+
+	// A key function that throws leaves the queue as it was and the session with the caller
+	unique_ptr<PlaySession> unknown(new CombatSession("Z", 10, BALANCED, 1, LootInfo()));
+	CHECK_THROWS_AS(q.push(unknown.get()), out_of_range);
+	unique_ptr<PlaySession> known(new CombatSession("B", 10, BALANCED, 1, LootInfo()));
+	CHECK_THROWS_AS(q.pushBatch({ known.get(), unknown.get() }), out_of_range);
+	CHECK(q.size() == 3);
+	SessionPriorityQueue<>::Handle b2 = q.push(known.release());
+	CHECK(q.contains(b2));
+	CHECK(q.key(b2) == 2);
+
+	vector<string> order;
+	while (!q.isEmpty()) order.push_back(q.take()->getLocation());
+	CHECK(order == vector<string>{ "A", "B", "B", "D" });
+}
+
+TEST_CASE("Priority queue matches a sort under random pushes, batches, updates and removals") {
+	vector<double> priority;
+	SessionPriorityQueue<> q([&](const PlaySession& s) { return priority[s.getDuration()]; });
+	WorkloadRng rng(7, 0);
+	vector<SessionPriorityQueue<>::Handle> handles;
+	map<int, double> expected;      // id -> key of sessions still queued
+
+	auto make = [&](int id) {
+		priority.push_back(static_cast<double>(rng.between(0, 49)));
+		expected[id] = priority[id];
+		return new CombatSession("Camp", id, BALANCED, 1, LootInfo());
+	};
+
+	for (int id = 0; id < 300; id++) handles.push_back(q.push(make(id)));
+	vector<PlaySession*> batch;
+	for (int id = 300; id < 1000; id++) batch.push_back(make(id));
+	vector<SessionPriorityQueue<>::Handle> batchHandles = q.pushBatch(batch);
+	handles.insert(handles.end(), batchHandles.begin(), batchHandles.end());
+
+	for (int i = 0; i < 200; i++) {
+		int id = static_cast<int>(rng.between(0, 999));
+		if (!q.contains(handles[id])) continue;
+		if (i % 3 == 0) {
+			q.remove(handles[id]);
+			expected.erase(id);
+		}
+		else {
+			priority[id] = static_cast<double>(rng.between(0, 49));
+			expected[id] = priority[id];
+			q.update(handles[id]);
+		}
+	}
+	REQUIRE(q.size() == expected.size());
+
+	// Highest key first; equal keys by arrival, which is id order here
+	vector<pair<double, int>> sorted;
+	for (auto& e : expected) sorted.push_back({ -e.second, e.first });
+	sort(sorted.begin(), sorted.end());
+	bool same = true;
+	for (auto& e : sorted) same = same && q.take()->getDuration() == e.second;
+	CHECK(same);
+}
+
+TEST_CASE("Priority queue frees the sessions it still owns") {
+	long long before = memoryAccount(MEM_SESSIONS).stats().liveBlocks;
+	{
+		SessionPriorityQueue<> q;
+		for (int i = 0; i < 10; i++) q.push(new CombatSession("Camp", 10 + i, BALANCED, i, LootInfo()));
+		q.dequeue();
+		unique_ptr<PlaySession> taken = q.take();
+		CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == before + 9);
+	}
+	CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == before);
+}
+
+// ---------- AF) Task Scheduler ----------
+TEST_CASE("parallelFor covers every index exactly once") {
+	for (int workers : { 0, 1, 3 }) {
+		TaskScheduler pool(workers);
+		for (size_t n : { size_t(0), size_t(1), size_t(7), size_t(10000) }) {
+			vector<atomic<int>> hits(n);
+			pool.parallelFor(WORK_AGGREGATION, n, 16, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) hits[i]++;
+			});
+			bool once = true;
+			for (auto& h : hits) once = once && h.load() == 1;
+			CHECK(once);
+		}
+	}
+}
+
+TEST_CASE("parallelReduce gives the same bits for any worker count") {
+	vector<double> values;
+	WorkloadRng rng(3, 0);
+	for (int i = 0; i < 100000; i++) values.push_back(rng.unit() * 1e6);
+
+	auto sumWith = [&](int workers) {
+		TaskScheduler pool(workers);
+		return pool.parallelReduce(WORK_AGGREGATION, values.size(), 1000, 0.0,
+			[&](size_t begin, size_t end) { double s = 0; for (size_t i = begin; i < end; i++) s += values[i]; return s; },
+			[](double a, double b) { return a + b; });
+	};
+	double single = sumWith(0);
+	CHECK(sumWith(1) == single);
+	CHECK(sumWith(4) == single);
+}
+
+TEST_CASE("Nested parallel loops finish and idle workers steal") {
+	TaskScheduler pool(3);
+	atomic<int> inner{ 0 };
+	auto outer = [&] {
+		pool.parallelFor(WORK_AGGREGATION, 2, 1, [&](size_t, size_t) {
+			pool.parallelFor(WORK_AGGREGATION, 32, 1, [&](size_t b, size_t e) {
+				for (size_t j = b; j < e; j++) {
+					this_thread::sleep_for(chrono::microseconds(200));
+					inner++;
+				}
+			});
+		});
+	};
+
+	// Started on a worker, so the nested pieces land in its deque for the others to steal
+	TaskGroup group(pool);
+	group.run(WORK_AGGREGATION, outer);
+	this_thread::sleep_for(chrono::milliseconds(20));
+	group.wait();
+	CHECK(inner == 64);
+	CHECK(pool.stealCount() > 0);
+
+	// Started outside the pool, the waiting thread helps
+	outer();
+	CHECK(inner == 128);
+}
+
+TEST_CASE("Task errors reach the waiting thread after the other tasks finish") {
+	for (int workers : { 0, 2 }) {
+		TaskScheduler pool(workers);
+		atomic<int> done{ 0 };
+		TaskGroup group(pool);
+		for (int i = 0; i < 100; i++) {
+			group.run(WORK_LOADING, [&done, i] {
+				if (i == 50) throw runtime_error("bad task");
+				done++;
+			});
+		}
+		CHECK_THROWS_WITH_AS(group.wait(), "bad task", runtime_error);
+		CHECK(done == 99);
+
+		// The group and the pool are still usable
+		group.run(WORK_LOADING, [&done] { done++; });
+		group.wait();
+		CHECK(done == 100);
+	}
+}
+
+TEST_CASE("parallelSort matches std::sort and charges the sorting subsystem") {
+	long long spansBefore = spanAccount(WORK_SORTING).stats().spans;
+	WorkloadRng rng(11, 0);
+	vector<uint64_t> values;
+	for (int i = 0; i < 200000; i++) values.push_back(rng.between(0, 5000));
+	vector<uint64_t> expected(values);
+	sort(expected.begin(), expected.end());
+
+	setTaskWorkers(3);
+	parallelSort(WORK_SORTING, values.begin(), values.end());
+	CHECK(values == expected);
+
+	vector<uint64_t> descending(expected);
+	parallelSort(WORK_SORTING, descending.begin(), descending.end(), greater<uint64_t>());
+	CHECK(equal(descending.begin(), descending.end(), expected.rbegin()));
+	setTaskWorkers(defaultTaskWorkers());
+
+	CHECK(spanAccount(WORK_SORTING).stats().spans > spansBefore);
+	json report = taskReportJson();
+	CHECK(report["subsystems"]["sorting"]["spans"].get<long long>() > spansBefore);
+	CHECK(report["subsystems"]["sorting"]["busySeconds"].get<double>() > 0);
+}
+
+TEST_CASE("Loading and aggregation agree with and without workers") {
+	SessionColumns columns;
+	for (int i = 0; i < 300000; i++) {
+		columns.add(i % 3 ? COMBAT_SESSION : EXPLORATION_SESSION, "Zone " + to_string(i % 40), 10 + i % 150,
+			BALANCED, i % 9, LootInfo(i % 300, i % 23 == 0));
+	}
+
+	setTaskWorkers(0);
+	ColumnTotals serial = aggregateColumns(columns);
+	SessionContainer serialLoad;
+	loadSessionsFromJson("sessions.json", serialLoad);
+	setTaskWorkers(3);
+	ColumnTotals parallel = aggregateColumns(columns);
+	SessionContainer parallelLoad;
+	loadSessionsFromJson("sessions.json", parallelLoad);
+	setTaskWorkers(defaultTaskWorkers());
+
+	CHECK(parallel.sessions == 300000);
+	CHECK(parallel.minutes == serial.minutes);
+	CHECK(parallel.gold == serial.gold);
+	CHECK(parallel.shortest == serial.shortest);
+	CHECK(parallel.longest == serial.longest);
+	CHECK(parallel.rareItems == serial.rareItems);
+	CHECK(parallel.longSessions == serial.longSessions);
+	CHECK(parallel.value == serial.value);
+	REQUIRE(parallelLoad.size() == serialLoad.size());
+	CHECK(equal(parallelLoad.begin(), parallelLoad.end(), serialLoad.begin(),
+		[](const PlaySession& a, const PlaySession& b) { return a.getLocation() == b.getLocation(); }));
+}
+
+// ---------- AG) Session Iterators ----------
+static_assert(is_same<iterator_traits<SessionContainer::iterator>::iterator_category, forward_iterator_tag>::value,
+	"session iterators are forward iterators");
+static_assert(is_convertible<SessionContainer::iterator, SessionContainer::const_iterator>::value,
+	"iterator converts to const_iterator");
+static_assert(!is_convertible<SessionContainer::const_iterator, SessionContainer::iterator>::value,
+	"const_iterator does not convert back");
+static_assert(is_same<decltype(*declval<const SessionContainer&>().begin()), const PlaySession&>::value,
+	"a const container yields const sessions");
+
+#ifdef __cpp_lib_ranges
+static_assert(std::forward_iterator<SessionContainer::iterator>);
+static_assert(std::ranges::forward_range<SessionContainer>);
+static_assert(std::ranges::forward_range<const SessionContainer>);
+static_assert(std::ranges::forward_range<SessionStack>);
+static_assert(std::ranges::forward_range<SessionQueue>);
+#endif
+
+TEST_CASE("Containers iterate in container order") {
+	SessionContainer manager;
+	SessionStack stack;
+	SessionQueue queue;
+	CHECK(manager.begin() == manager.end());
+	CHECK(stack.begin() == stack.end());
+	CHECK(queue.begin() == queue.end());
+
+	for (const char* loc : { "A", "B", "C" }) {
+		manager.add(new CombatSession(loc, 10, BALANCED, 1, LootInfo()));
+		stack.push(new CombatSession(loc, 10, BALANCED, 1, LootInfo()));
+		queue.enqueue(new CombatSession(loc, 10, BALANCED, 1, LootInfo()));
+	}
+	auto joined = [](const auto& c) {
+		string all;
+		for (const PlaySession& s : c) all += s.getLocation();
+		return all;
+	};
+	CHECK(joined(manager) == "ABC");
+	CHECK(joined(stack) == "CBA");
+	CHECK(joined(queue) == "ABC");
+
+	stack.pop();
+	queue.dequeue();
+	CHECK(joined(stack) == "BA");
+	CHECK(joined(queue) == "BC");
+	CHECK(distance(manager.begin(), manager.end()) == manager.size());
+}
+
+TEST_CASE("Session iterators work with standard algorithms") {
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+
+	auto goblin = find_if(manager.begin(), manager.end(), [](const PlaySession& s) { return s.getLocation() == "Goblin Camp"; });
+	REQUIRE(goblin != manager.end());
+	CHECK(goblin->getLocation() == "Goblin Camp");
+	CHECK(distance(manager.begin(), goblin) == manager.linearSearch("Goblin Camp"));
+	CHECK(count_if(manager.cbegin(), manager.cend(), [](const PlaySession& s) { return s.getType() == COMBAT_SESSION; }) == 3);
+
+	SessionContainer::const_iterator c = goblin;
+	CHECK(c == goblin);
+	CHECK(++c != goblin);
+	SessionContainer::iterator post = goblin;
+	CHECK(post++ == goblin);
+	CHECK(post == c);
+
+	int total = accumulate(manager.begin(), manager.end(), 0, [](int sum, const PlaySession& s) { return sum + s.getDuration(); });
+	CHECK(total == 300);
+
+#ifdef __cpp_lib_ranges
+	auto longOnes = manager | std::views::filter([](const PlaySession& s) { return s.getDuration() > 60; });
+	CHECK(std::ranges::distance(longOnes) == 3);
 #endif
+}
+
+// ---------- AH) Deduplication ----------
+TEST_CASE("Content hash covers every field and is stable") {
+	LootInfo loot(40, true);
+	CombatSession base("Camp", 30, BALANCED, 5, loot);
+	CHECK(contentHash(base) == contentHash(CombatSession("Camp", 30, BALANCED, 5, LootInfo(40, true))));
+	CHECK(contentHash(LootInfo(40, true)) == contentHash(loot));
+	CHECK(contentHash(LootInfo(40, true)) != contentHash(LootInfo(40, false)));
+	CHECK(contentHash(LootInfo(40, true)) != contentHash(LootInfo(41, true)));
+
+	vector<unique_ptr<PlaySession>> variants;
+	variants.emplace_back(new ExplorationSession("Camp", 30, BALANCED, 5, loot));
+	variants.emplace_back(new CombatSession("Camp ", 30, BALANCED, 5, loot));
+	variants.emplace_back(new CombatSession("Camp", 31, BALANCED, 5, loot));
+	variants.emplace_back(new CombatSession("Camp", 30, TACTICIAN, 5, loot));
+	variants.emplace_back(new CombatSession("Camp", 30, BALANCED, 6, loot));
+	variants.emplace_back(new CombatSession("Camp", 30, BALANCED, 5, LootInfo(39, true)));
+	variants.emplace_back(new CombatSession("Camp", 30, BALANCED, 5, LootInfo(40, false)));
+	for (auto& v : variants) {
+		CHECK(contentHash(*v) != contentHash(base));
+		CHECK_FALSE(sameContent(*v, base));
+	}
+
+	// Canonical layout, so stored hashes stay valid across builds and platforms
+	CHECK(contentHash(base) == 0xcac9ed470598c6c8ull);
+}
+
+TEST_CASE("Unique ingest skips sessions already present or repeated in the source") {
+	SessionContainer manager;
+	loadSessionsFromJson("sessions.json", manager);
+	manager.remove(4);
+
+	unique_ptr<SessionSource> again = openSessionSource("sessions.json");
+	CHECK(drainUniqueInto(*again, manager) == 1);
+	CHECK(manager.size() == 5);
+
+	const string fileName = "dedupe_ingest.jsonl";
+	{
+		JsonLinesWriter writer(fileName);
+		for (const PlaySession& s : manager) writer.write(s);
+		writer.write(*manager.at(0));
+		writer.write(CombatSession("New Camp", 10, EXPLORER, 1, LootInfo()));
+		writer.write(CombatSession("New Camp", 10, EXPLORER, 1, LootInfo()));
+	}
+	unique_ptr<SessionSource> overlapping = openSessionSource(fileName);
+	CHECK(drainUniqueInto(*overlapping, manager) == 1);
+	CHECK(manager.size() == 6);
+	std::remove(fileName.c_str());
+
+	AsyncSessionLoad unique("sessions.json", INGEST_UNIQUE);
+	unique.wait();
+	CHECK(unique.drainInto(manager) == 0);
+	AsyncSessionLoad all("sessions.json");
+	all.wait();
+	CHECK(all.drainInto(manager) == 5);
+	CHECK(manager.size() == 11);
+
+	// A unique load keeps its set across drains only while the container just grows
+	long long changes = manager.changeCount();
+	manager.add(new CombatSession("Appended", 10, EXPLORER, 1, LootInfo()));
+	CHECK(manager.changeCount() == changes);
+	manager.remove(0);
+	CHECK(manager.changeCount() == changes + 1);
+}
+
+TEST_CASE("Unique background loads reuse their set across drains and rebuild it after a remove") {
+	const string fileName = "dedupe_async.json";
+	{
+		SessionContainer source;
+		for (int i = 0; i < 3; i++) source.add(new CombatSession("Camp " + to_string(i), 10, BALANCED, i, LootInfo()));
+		source.add(new CombatSession("Camp 0", 10, BALANCED, 0, LootInfo()));
+		source.add(new CombatSession("Camp 1", 10, BALANCED, 1, LootInfo()));
+		saveSessionsToJson(fileName, source);
+	}
+
+	SessionContainer manager;
+	AsyncSessionLoad load(fileName, INGEST_UNIQUE);
+	load.wait();
+	CHECK(load.drainInto(manager, 2) == 2);
+	// The set built on the first drain still holds Camp 0 after the appends
+	CHECK(load.drainInto(manager, 2) == 1);
+	CHECK(manager.size() == 3);
+
+	// Camp 1 is gone, so its copy is new content again
+	manager.remove(1);
+	CHECK(load.drainInto(manager) == 1);
+	CHECK(manager.size() == 3);
+	CHECK(manager.at(2)->getLocation() == "Camp 1");
+	CHECK(load.drainInto(manager) == 0);
+	std::remove(fileName.c_str());
+}
 
+TEST_CASE("Post-hoc dedupe keeps the first of each group in order") {
+	long long before = memoryAccount(MEM_SESSIONS).stats().liveBlocks;
+	{
+		SessionContainer manager;
+		for (int i = 0; i < 3000; i++)
+			manager.add(new CombatSession("Zone " + to_string(i % 1000), 30, BALANCED, i % 1000, LootInfo(i % 1000, false)));
+		manager.clearChanges();
+		manager.add(new ExplorationSession("Zone 0", 30, BALANCED, 0, LootInfo(0, false)));
+
+		CHECK(removeDuplicateSessions(manager) == 2000);
+		CHECK(manager.size() == 1001);
+		CHECK(manager.firstChangedIndex() == 1000);
+		int index = 0;
+		bool ordered = true;
+		for (const PlaySession& s : manager) {
+			ordered = ordered && s.getLocation() == "Zone " + to_string(index % 1000);
+			index++;
+		}
+		CHECK(ordered);
+		CHECK(manager.at(1000)->getType() == EXPLORATION_SESSION);
+		CHECK(removeDuplicateSessions(manager) == 0);
+		CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == before + 1001);
+	}
+	CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == before);
+}
+
+// ---------- AI) Merge ----------
+// Writes one JSON-lines file per input, with the given timestamps in order; each
+// session's duration is input * 1000 + position so the merged order can be checked
+vector<string> writeTimestampedInputs(const vector<vector<long long>>& stamps) {
+	vector<string> names;
+	for (size_t in = 0; in < stamps.size(); in++) {
+		names.push_back("merge_input_" + to_string(in) + ".jsonl");
+		ofstream out(names.back());
+		for (size_t p = 0; p < stamps[in].size(); p++) {
+			json j = sessionToJson(CombatSession("Camp", static_cast<int>(in * 1000 + p), BALANCED, 1, LootInfo()));
+			j["timestamp"] = stamps[in][p];
+			out << j.dump() << "\n";
+		}
+	}
+	return names;
+}
+
+TEST_CASE("Merge orders by timestamp with ties in input order") {
+	WorkloadRng rng(5, 0);
+	for (int round = 0; round < 20; round++) {
+		size_t k = static_cast<size_t>(rng.between(1, 9));
+		vector<vector<long long>> stamps(k);
+		vector<tuple<long long, size_t, int>> expected;     // (timestamp, input, duration)
+		for (size_t in = 0; in < k; in++) {
+			long long t = 0;
+			size_t count = static_cast<size_t>(rng.between(0, 40));
+			for (size_t p = 0; p < count; p++) {
+				t += static_cast<long long>(rng.between(0, 3));
+				stamps[in].push_back(t);
+				expected.emplace_back(t, in, static_cast<int>(in * 1000 + p));
+			}
+		}
+		sort(expected.begin(), expected.end());
+		vector<string> names = writeTimestampedInputs(stamps);
+
+		unique_ptr<SessionMerge> merge = openSessionMerge(names);
+		SessionContainer manager;
+		CHECK(drainInto(*merge, manager) == static_cast<int>(expected.size()));
+		bool ordered = true;
+		size_t i = 0;
+		for (const PlaySession& s : manager) ordered = ordered && s.getDuration() == get<2>(expected[i++]);
+		CHECK(ordered);
+		merge.reset();
+		for (const string& name : names) std::remove(name.c_str());
+	}
+}
+
+TEST_CASE("Merge interleaves untimed JSON, JSON-lines and wire files by position") {
+	SessionContainer a, b, c;
+	for (int i = 0; i < 3; i++) a.add(new CombatSession("A", i, BALANCED, 1, LootInfo()));
+	for (int i = 0; i < 1; i++) b.add(new ExplorationSession("B", i, EXPLORER, 2, LootInfo(5, true)));
+	for (int i = 0; i < 2; i++) c.add(new CombatSession("C", i, TACTICIAN, 3, LootInfo()));
+	saveSessionsToJson("merge_a.json", a);
+	saveSessionsToJsonLines("merge_b.jsonl", b);
+	saveSessionsToWire("merge_c.bgsw", c);
+	vector<string> names = { "merge_a.json", "merge_b.jsonl", "merge_c.bgsw" };
+
+	SessionContainer merged;
+	drainInto(*openSessionMerge(names), merged);
+	string order;
+	for (const PlaySession& s : merged) order += s.getLocation() + to_string(s.getDuration()) + " ";
+	CHECK(order == "A0 B0 C0 A1 C1 A2 ");
+
+	CHECK(mergeSessionFiles(names, "merged.json") == 6);
+	SessionContainer reloaded;
+	CHECK(loadSessionsFromJson("merged.json", reloaded) == 6);
+	CHECK(reloaded.at(1)->getType() == EXPLORATION_SESSION);
+	CHECK(sessionLoot(*reloaded.at(1)).isRareItemFound());
+	CHECK(readWholeFile("merged.json").find("timestamp") == string::npos);
+
+	CHECK(mergeSessionFiles(names, "merged.bgsw") == 6);
+	SessionContainer fromWire;
+	CHECK(loadSessionsFromWire("merged.bgsw", fromWire) == 6);
+	string wireOrder;
+	for (const PlaySession& s : fromWire) wireOrder += s.getLocation() + to_string(s.getDuration()) + " ";
+	CHECK(wireOrder == order);
+	CHECK(fromWire.at(5)->getDifficulty() == BALANCED);
+
+	// More records than one write block, so the header and checksum cover several
+	SessionContainer big;
+	for (int i = 0; i < 10000; i++) big.add(new CombatSession("Zone " + to_string(i % 7), i, TACTICIAN, i, LootInfo(i, i % 3 == 0)));
+	saveSessionsToWire("merge_big.bgsw", big);
+	CHECK(mergeSessionFiles({ "merge_big.bgsw" }, "merged_big.bgsw") == 10000);
+	CHECK(readWholeFile("merged_big.bgsw") == readWholeFile("merge_big.bgsw"));
+
+	CHECK_THROWS_AS(openSessionMerge({ "merge_a.json", "no_such_merge_input.json" }), runtime_error);
+	for (const char* name : { "merge_a.json", "merge_b.jsonl", "merge_c.bgsw", "merged.json", "merged.bgsw",
+		"merge_big.bgsw", "merged_big.bgsw" })
+		std::remove(name);
+}
+
+TEST_CASE("Merged JSON-lines output keeps timestamps and can be merged again") {
+	vector<string> names = writeTimestampedInputs({ { 10, 20, 30 }, { 5, 25 } });
+	CHECK(mergeSessionFiles(names, "merged_once.jsonl") == 5);
+
+	unique_ptr<SessionSource> source = openSessionSource("merged_once.jsonl");
+	vector<long long> keys;
+	while (source->next()) {
+		CHECK(source->lastTimestamped());
+		keys.push_back(source->lastKey());
+	}
+	CHECK(keys == vector<long long>{ 5, 10, 20, 25, 30 });
+
+	vector<string> twice = { "merged_once.jsonl", names[0] };
+	CHECK(mergeSessionFiles(twice, "merged_twice.csv") == 8);
+	SessionContainer fromCsv;
+	CHECK(loadSessionsFromCsv("merged_twice.csv", fromCsv) == 8);
+	for (const string& name : names) std::remove(name.c_str());
+	std::remove("merged_once.jsonl");
+	std::remove("merged_twice.csv");
+}
+
+TEST_CASE("Merge rejects an input that is out of order") {
+	vector<string> names = writeTimestampedInputs({ { 1, 2, 3 }, { 4, 2 } });
+	unique_ptr<SessionMerge> merge = openSessionMerge(names);
+	SessionContainer manager;
+	CHECK_THROWS_WITH_AS(drainInto(*merge, manager), "merge_input_1.jsonl is out of order at session 2", runtime_error);
+	merge.reset();
+	for (const string& name : names) std::remove(name.c_str());
+}
 
+TEST_CASE("Merge rejects timestamp and position keys on one axis") {
+	vector<string> names = writeTimestampedInputs({ { 1, 2 } });
+	SessionContainer untimed;
+	untimed.add(new CombatSession("Camp", 1, BALANCED, 1, LootInfo()));
+	saveSessionsToWire("merge_untimed.bgsw", untimed);
+	names.push_back("merge_untimed.bgsw");
+	{
+		unique_ptr<SessionMerge> merge = openSessionMerge(names);
+		SessionContainer manager;
+		CHECK_THROWS_WITH_AS(drainInto(*merge, manager),
+			"merge_untimed.bgsw is keyed by position but merge_input_0.jsonl by timestamp", runtime_error);
+	}
+
+	{
+		ofstream out("merge_mixed.jsonl");
+		json j = sessionToJson(CombatSession("Camp", 1, BALANCED, 1, LootInfo()));
+		j["timestamp"] = 5;
+		out << j.dump() << "\n";
+		j.erase("timestamp");
+		out << j.dump() << "\n";
+	}
+	{
+		unique_ptr<SessionMerge> merge = openSessionMerge({ "merge_mixed.jsonl" });
+		SessionContainer manager;
+		CHECK_THROWS_WITH_AS(drainInto(*merge, manager),
+			"merge_mixed.jsonl mixes timestamped and untimed sessions at session 2", runtime_error);
+	}
+	for (const string& name : names) std::remove(name.c_str());
+	std::remove("merge_mixed.jsonl");
+}
+
+TEST_CASE("Prefetching passes on errors and stops early without leaking") {
+	long long before = memoryAccount(MEM_SESSIONS).stats().liveBlocks;
+	{
+		ofstream out("prefetch_bad.jsonl");
+		out << sessionToJson(CombatSession("Camp", 1, BALANCED, 1, LootInfo())).dump() << "\n{ not json\n";
+	}
+	{
+		PrefetchSource source(openSessionSource("prefetch_bad.jsonl"), 4);
+		CHECK(source.next() != nullptr);
+		CHECK_THROWS_AS(source.next(), runtime_error);
+	}
+
+	vector<string> names = writeTimestampedInputs({ vector<long long>(2000, 7) });
+	{
+		PrefetchSource source(openSessionSource(names[0]), 16);
+		CHECK(source.next()->getDuration() == 0);
+		CHECK(source.lastKey() == 7);
+	}
+	CHECK(memoryAccount(MEM_SESSIONS).stats().liveBlocks == before);
+	std::remove(names[0].c_str());
+	std::remove("prefetch_bad.jsonl");
+}
+#endif